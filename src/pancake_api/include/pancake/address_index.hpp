@@ -0,0 +1,151 @@
+/**
+ * @file address_index.hpp
+ * @author jgcodes2020
+ * @brief Maps addresses back to globals and member paths
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ */
+#ifndef _PANCAKE_ADDRESS_INDEX_HPP_
+#define _PANCAKE_ADDRESS_INDEX_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <pancake/dl/pdl.hpp>
+#include <pancake/dwarf/type_info.hpp>
+#include <pancake/dwarf/types.hpp>
+#include <pancake/sm64.hpp>
+
+namespace pancake {
+  /**
+   * @brief Maps addresses in libsm64 to the globals and members they belong
+   * to.
+   * @details Every global's extent and every type's layout are read from
+   * DWARF once, on construction. Lookups are a binary search over the
+   * extents followed by a walk down the prebuilt layouts, and don't touch
+   * DWARF, so they're cheap and safe to run from several threads.
+   */
+  class address_index final {
+    friend class pointer_scan;
+
+  public:
+    /**
+     * @brief A global variable or function.
+     */
+    struct symbol {
+      std::string name;
+      uintptr_t begin;
+      /**
+       * @brief The size in bytes. Functions without a known size extend to
+       * the next symbol.
+       */
+      size_t size;
+      bool is_function;
+      // layout of the variable's type, or npos for functions
+      uint32_t type;
+    };
+
+    /**
+     * @brief Where an address was found.
+     */
+    struct location {
+      /**
+       * @brief The symbol containing the address.
+       */
+      const symbol* sym;
+      /**
+       * @brief The most specific accessor expression for the address, such
+       * as `gMarioStates[0].vel[1]`, or a function's name.
+       */
+      std::string path;
+      /**
+       * @brief The distance from the start of `path`, in bytes.
+       */
+      size_t offset;
+      /**
+       * @brief The type at `path`. Its encoding is `none` for functions
+       * and for bytes that aren't part of any member, like padding.
+       */
+      dwarf::base_type_info type;
+    };
+
+    static constexpr uint32_t npos = UINT32_MAX;
+
+  private:
+    struct member {
+      std::string name;
+      size_t offset;
+      size_t size;
+      uint32_t type;
+    };
+    struct type_node {
+      enum kind_t : uint8_t { scalar, array, record } kind;
+      bool is_union;
+      size_t size;
+      dwarf::base_type_info base;
+      // arrays
+      size_t count;
+      uint32_t elem;
+      // records, sorted by offset
+      std::vector<member> members;
+      // pointers, if the pointed-to type is known
+      uint32_t pointee;
+    };
+
+    std::vector<symbol> m_symbols;
+    std::vector<type_node> m_types;
+
+    struct builder;
+
+    // Walks down from a type to the scalar at an offset, appending each
+    // step to `path`. Leaves `offset` as the distance into the last type.
+    void descend(
+      uint32_t node, size_t& offset, std::string& path,
+      dwarf::base_type_info& type) const;
+
+  public:
+    /**
+     * @brief Indexes a game's globals.
+     */
+    explicit address_index(sm64& game) :
+      address_index(game.get_lib(), game.get_debug_info()) {}
+
+    /**
+     * @brief Indexes the globals of a library.
+     *
+     * @param lib the library, to find where each global was loaded
+     * @param dbg the library's debug info
+     */
+    address_index(const dl::library& lib, dwarf::debug& dbg);
+
+    /**
+     * @brief Returns every indexed symbol, sorted by address.
+     */
+    const std::vector<symbol>& symbols() const { return m_symbols; }
+
+    /**
+     * @brief Finds the symbol containing an address.
+     * @return the symbol, or `nullptr` if there's none
+     */
+    const symbol* find(const void* addr) const;
+
+    /**
+     * @brief Finds the symbol and most specific member containing an
+     * address.
+     * @return where the address is, or nothing if it's outside every symbol
+     */
+    std::optional<location> lookup(const void* addr) const;
+
+    /**
+     * @brief Describes an address as `path` or `path+0xN`, or in hex if
+     * it's outside every symbol.
+     */
+    std::string describe(const void* addr) const;
+  };
+}  // namespace pancake
+#endif
@@ -0,0 +1,94 @@
+/**
+ * @file batch.hpp
+ * @author jgcodes2020
+ * @brief Replays many movies, simulating shared prefixes once
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ */
+#ifndef _PANCAKE_BATCH_HPP_
+#define _PANCAKE_BATCH_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include <pancake/movie.hpp>
+#include <pancake/sm64.hpp>
+
+namespace pancake {
+  /**
+   * @brief Replays a batch of movies that share prefixes.
+   * @details Movies are inserted into a radix trie of inputs, which is then
+   * walked depth-first. The game is saved at each branch point and restored
+   * for each branch, so inputs shared by several movies are only simulated
+   * once.
+   */
+  class batch_executor final {
+  public:
+    /**
+     * @brief Called once a movie has been fully played, with the game in the
+     * state right after its last input. It should only read from the game.
+     */
+    using callback = std::function<void(size_t id, sm64& game)>;
+
+  private:
+    struct node {
+      // The edge into this node covers inputs [begin, depth) of movie `src`.
+      size_t src;
+      uint32_t begin;
+      uint32_t depth;
+      std::vector<size_t> children;
+      std::unordered_map<uint32_t, size_t> index;
+      std::vector<size_t> ids;
+    };
+
+    sm64& m_game;
+    std::vector<const m64*> m_movies;
+    std::vector<node> m_nodes;
+    std::vector<sm64::savestate> m_states;
+
+    static uint32_t key(const frame& f) {
+      return (uint32_t(f.buttons) << 16) | (uint32_t(uint8_t(f.stick_x)) << 8) |
+        uint32_t(uint8_t(f.stick_y));
+    }
+
+  public:
+    /**
+     * @brief Creates an empty batch.
+     *
+     * @param game the game to play movies on. Its state when `run()` is
+     * called is the starting state for every movie.
+     */
+    batch_executor(sm64& game);
+
+    /**
+     * @brief Adds a movie to the batch. The movie is not copied, and must
+     * outlive any call to `run()`.
+     *
+     * @param movie the movie to add
+     * @return an ID identifying the movie in callbacks, assigned in order
+     * from 0
+     */
+    size_t add(const m64& movie);
+
+    /**
+     * @brief Returns the number of movies in the batch.
+     */
+    size_t size() const { return m_movies.size(); }
+
+    /**
+     * @brief Plays every movie in the batch, invoking `cb` after each one.
+     * Movies are not played in ID order.
+     *
+     * @param cb the callback
+     * @return the number of frames simulated, which is at most the total
+     * length of all movies
+     */
+    uint64_t run(const callback& cb);
+  };
+}  // namespace pancake
+#endif
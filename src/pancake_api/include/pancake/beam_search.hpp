@@ -0,0 +1,137 @@
+/**
+ * @file beam_search.hpp
+ * @author jgcodes2020
+ * @brief Beam search over input frames with duplicate-state pruning
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ */
+#ifndef _PANCAKE_BEAM_SEARCH_HPP_
+#define _PANCAKE_BEAM_SEARCH_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <pancake/movie.hpp>
+#include <pancake/pool.hpp>
+#include <pancake/sm64.hpp>
+
+namespace pancake {
+  /**
+   * @brief Breadth-first search keeping the best `width` states per depth.
+   * @details Each state in the beam is expanded with every candidate frame.
+   * Resulting states are hashed, and states seen before (at any depth) are
+   * dropped through a shared transposition table. The top `width` new states
+   * by score are kept in pooled savestates for the next depth.
+   *
+   * Savestates can't move between instances, so a state is expanded on the
+   * instance that holds it. When survivors pile up on a few instances, the
+   * extras are rebuilt on idle ones by replaying their inputs.
+   */
+  class beam_search final {
+  public:
+    /**
+     * @brief Scores a state; higher is better. Called concurrently on
+     * different instances. Return NaN to drop the state.
+     */
+    using scorer = std::function<double(sm64& game)>;
+
+    struct options {
+      /**
+       * @brief The number of states kept per depth.
+       */
+      size_t width = 256;
+      /**
+       * @brief The frames each state is expanded with.
+       */
+      std::vector<frame> candidates;
+      /**
+       * @brief Accessor expressions to hash states by. If empty, all of
+       * libsm64's .data and .bss are hashed.
+       */
+      std::vector<std::string> watch;
+    };
+
+    struct result {
+      /**
+       * @brief The prefix followed by the best inputs found.
+       */
+      m64 movie;
+      /**
+       * @brief The score of the best state.
+       */
+      double score;
+      /**
+       * @brief The number of states expanded.
+       */
+      uint64_t expanded;
+      /**
+       * @brief The number of expansions dropped as duplicates.
+       */
+      uint64_t duplicates;
+    };
+
+    /**
+     * @brief Called after each depth with the depth reached and the best
+     * score so far; returning false stops the search.
+     */
+    using progress = std::function<bool(size_t depth, double best)>;
+
+  private:
+    struct hasher;
+
+    struct node {
+      size_t parent;
+      frame input;
+    };
+    struct entry {
+      size_t node;
+      size_t owner;
+      size_t slot;
+      double score;
+    };
+
+    sm64_pool& m_pool;
+    m64 m_prefix;
+    scorer m_score;
+    options m_opts;
+
+    std::vector<std::unique_ptr<hasher>> m_hashers;
+    sm64_pool::savestate m_root;
+    // per instance, double-buffered by depth
+    std::vector<std::vector<sm64::savestate>> m_slots[2];
+
+    std::vector<node> m_nodes;
+    std::vector<frame> path(size_t node) const;
+
+  public:
+    /**
+     * @brief Sets up a search. Every instance plays `prefix`, and the state
+     * after it becomes the root.
+     *
+     * @param pool the pool to run on
+     * @param prefix inputs leading to the root state
+     * @param score the scoring function
+     * @param opts search options
+     */
+    beam_search(
+      sm64_pool& pool, const m64& prefix, scorer score, options opts);
+    ~beam_search();
+
+    /**
+     * @brief Runs the search.
+     *
+     * @param depth the maximum number of frames to search
+     * @param cb called after each depth
+     * @return the best state found at any depth
+     */
+    result run(size_t depth, const progress& cb = nullptr);
+  };
+}  // namespace pancake
+#endif
@@ -0,0 +1,214 @@
+/**
+ * @file bruteforce.hpp
+ * @author jgcodes2020
+ * @brief Parallel brute-forcing of input windows
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ */
+#ifndef _PANCAKE_BRUTEFORCE_HPP_
+#define _PANCAKE_BRUTEFORCE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include <pancake/movie.hpp>
+#include <pancake/pool.hpp>
+#include <pancake/sm64.hpp>
+
+namespace pancake {
+  /**
+   * @brief Mutation operators, picked at random in proportion to their
+   * weights.
+   */
+  class mutator_set final {
+  public:
+    /**
+     * @brief Mutates a single frame.
+     */
+    using mutator = std::function<void(frame& f, std::mt19937_64& rng)>;
+
+  private:
+    struct weighted {
+      mutator fn;
+      double weight;
+    };
+
+    std::vector<weighted> m_mutators;
+    double m_total_weight = 0;
+
+  public:
+    /**
+     * @brief Adds an operator.
+     * @exception std::invalid_argument if `weight` isn't positive
+     */
+    void add(mutator fn, double weight = 1.0);
+
+    /**
+     * @brief Returns true if no operators were added.
+     */
+    bool empty() const { return m_mutators.empty(); }
+
+    /**
+     * @brief Applies one operator, picked by weight, to a frame.
+     */
+    void apply(frame& f, std::mt19937_64& rng) const;
+
+    /**
+     * @brief Mutates each frame of a window with probability `rate`.
+     *
+     * @param window the frames to mutate
+     * @param rate the chance of mutating each frame
+     * @param rng the random number generator
+     * @param force if true and no frame was picked, one is mutated anyway
+     */
+    void mutate(
+      std::vector<frame>& window, double rate, std::mt19937_64& rng,
+      bool force) const;
+  };
+
+  /**
+   * @brief Repeatedly perturbs a window of a movie, scores the results and
+   * keeps the best one.
+   * @details Each round derives a batch of candidates from the current best
+   * movie and evaluates them across a pool with work stealing. Candidate `c`
+   * of round `r` is always generated from the same seed, so results don't
+   * depend on scheduling.
+   */
+  class bruteforce final {
+  public:
+    /**
+     * @brief Mutates a single frame.
+     */
+    using mutator = mutator_set::mutator;
+    /**
+     * @brief Scores the game after a candidate has been played; higher is
+     * better. Called concurrently on different instances, so it must be
+     * thread-safe. Return NaN to reject a candidate; if the base movie is
+     * rejected, any accepted candidate improves on it.
+     */
+    using scorer = std::function<double(sm64& game)>;
+
+    struct options {
+      /**
+       * @brief The first input that may be changed.
+       */
+      uint32_t window_begin = 0;
+      /**
+       * @brief One past the last input that may be changed.
+       */
+      uint32_t window_end = 0;
+      /**
+       * @brief The number of inputs to play before scoring. 0 means up to
+       * `window_end`.
+       */
+      uint32_t eval_end = 0;
+      /**
+       * @brief Chance of mutating each frame in the window. At least one
+       * frame is always mutated.
+       */
+      double mutation_rate = 0.1;
+      /**
+       * @brief Candidates per round.
+       */
+      size_t batch = 1024;
+      /**
+       * @brief Seed for candidate generation.
+       */
+      uint64_t seed = 0;
+      /**
+       * @brief If not empty, the best movie is written here on every
+       * improvement.
+       */
+      std::filesystem::path output;
+    };
+
+    struct stats {
+      uint64_t rounds;
+      uint64_t candidates;
+      uint64_t improvements;
+      double best_score;
+      double candidates_per_second;
+    };
+
+    /**
+     * @brief Callback invoked after each round; returning false stops the
+     * search.
+     */
+    using progress = std::function<bool(const stats&)>;
+
+  private:
+    sm64_pool& m_pool;
+    m64 m_best;
+    scorer m_score;
+    options m_opts;
+    mutator_set m_mutators;
+    sm64_pool::savestate m_start;
+    stats m_stats;
+
+    double evaluate(sm64& game, size_t i, const std::vector<frame>& window);
+    void persist();
+
+  public:
+    /**
+     * @brief Sets up a brute-forcer. Every instance in the pool plays the
+     * base movie up to the window, and the base movie is scored.
+     *
+     * @param pool the pool to run on
+     * @param base the movie to start from
+     * @param score the scoring function
+     * @param opts search options
+     * @exception std::invalid_argument if the window is empty or lies past
+     * the end of the movie
+     */
+    bruteforce(sm64_pool& pool, const m64& base, scorer score, options opts);
+
+    /**
+     * @brief Adds a mutation operator. Operators are picked at random in
+     * proportion to their weights.
+     *
+     * @param fn the operator
+     * @param weight its relative weight
+     */
+    void add_mutator(mutator fn, double weight = 1.0);
+
+    /**
+     * @brief Runs rounds of the search. If no mutators were added, stick
+     * nudges and A/B/Z toggles are used.
+     *
+     * @param rounds the maximum number of rounds
+     * @param cb called after each round; returning false stops early
+     * @return statistics for the whole search so far
+     */
+    stats run(size_t rounds, const progress& cb = nullptr);
+
+    /**
+     * @brief Returns the best movie found.
+     */
+    const m64& best() const { return m_best; }
+
+    /**
+     * @brief Returns the statistics so far.
+     */
+    const stats& statistics() const { return m_stats; }
+
+    /**
+     * @brief Moves the stick by up to `radius` in each axis.
+     */
+    static mutator stick_nudge(int radius);
+    /**
+     * @brief Sets the stick to a uniformly random position.
+     */
+    static mutator stick_random();
+    /**
+     * @brief Toggles a random button from `mask`.
+     */
+    static mutator toggle_buttons(frame::button mask);
+  };
+}  // namespace pancake
+#endif
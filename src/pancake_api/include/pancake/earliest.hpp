@@ -0,0 +1,111 @@
+/**
+ * @file earliest.hpp
+ * @author jgcodes2020
+ * @brief Earliest-frame search over a movie
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ */
+#ifndef _PANCAKE_EARLIEST_HPP_
+#define _PANCAKE_EARLIEST_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include <pancake/movie.hpp>
+#include <pancake/pool.hpp>
+#include <pancake/sm64.hpp>
+#include <pancake/timeline.hpp>
+
+namespace pancake {
+  /**
+   * @brief A question of the form "what is the earliest frame at which this
+   * change still reaches the goal?"
+   */
+  struct earliest_query {
+    /**
+     * @brief Applies the change at frame `at`. `tail` holds the movie's
+     * inputs from `at` up to `horizon`; `tail[0]` is input `at`. Frames may
+     * also be inserted or removed.
+     */
+    using edit_fn = std::function<void(std::vector<frame>& tail, uint32_t at)>;
+    /**
+     * @brief Checks the goal condition. It is checked after every input of
+     * the edited tail, and the candidate succeeds the first time it holds.
+     */
+    using goal_fn = std::function<bool(sm64& game)>;
+
+    /**
+     * @brief The first frame to try.
+     */
+    uint32_t begin = 0;
+    /**
+     * @brief One past the last frame to try.
+     */
+    uint32_t end = 0;
+    /**
+     * @brief The input after which the goal is no longer checked. 0 means
+     * the end of the movie.
+     */
+    uint32_t horizon = 0;
+
+    edit_fn edit;
+    goal_fn goal;
+
+    /**
+     * @brief Whether success at a frame implies success at every later frame
+     * in the range. If so, the search gallops then bisects; otherwise every
+     * frame is tried in order.
+     */
+    bool monotone = true;
+  };
+
+  struct earliest_result {
+    /**
+     * @brief The earliest successful frame, if there is one.
+     */
+    std::optional<uint32_t> frame;
+    /**
+     * @brief The number of frames tried.
+     */
+    uint64_t tests;
+  };
+
+  /**
+   * @brief Finds the earliest frame in `[q.begin, q.end)` at which `q.edit`
+   * reaches `q.goal`, on a single instance.
+   * @details Each try seeks the timeline to the frame, so it restores the
+   * nearest checkpoint rather than replaying from the start. The timeline's
+   * movie is not modified.
+   *
+   * @param tl the timeline to search along
+   * @param q the query
+   * @return the result
+   * @exception std::invalid_argument if the range is empty or goes past the
+   * horizon
+   */
+  earliest_result find_earliest(timeline& tl, const earliest_query& q);
+
+  /**
+   * @brief Tries every frame in `[q.begin, q.end)` in parallel, ignoring
+   * `q.monotone`. Every instance must be at the state before the movie's
+   * first input, and gets its own timeline.
+   *
+   * @param pool the pool to run on
+   * @param movie the movie to search along
+   * @param q the query
+   * @param budget the checkpoint budget of each instance's timeline, in bytes
+   * @param interval the checkpoint spacing of each timeline
+   * @return the result
+   * @exception std::invalid_argument if the range is empty or goes past the
+   * horizon
+   */
+  earliest_result find_earliest(
+    sm64_pool& pool, const m64& movie, const earliest_query& q, size_t budget,
+    uint32_t interval = 60);
+}  // namespace pancake
+#endif
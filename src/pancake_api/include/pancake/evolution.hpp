@@ -0,0 +1,180 @@
+/**
+ * @file evolution.hpp
+ * @author jgcodes2020
+ * @brief Genetic optimisation of input windows
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ */
+#ifndef _PANCAKE_EVOLUTION_HPP_
+#define _PANCAKE_EVOLUTION_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include <pancake/bruteforce.hpp>
+#include <pancake/movie.hpp>
+#include <pancake/pool.hpp>
+#include <pancake/sm64.hpp>
+
+namespace pancake {
+  /**
+   * @brief Evolves a population of input windows with crossover, mutation
+   * and elitism.
+   * @details Each generation keeps the best `elites` windows as they are and
+   * breeds the rest from parents picked by tournament. Children take a
+   * random run of frames from one parent and the rest from the other
+   * (two-point crossover), then each frame may be mutated.
+   *
+   * New children are sorted so that windows sharing a prefix are
+   * neighbours, split across the pool, and replayed on each instance with a
+   * `batch_executor`, so shared prefixes are only simulated once.
+   *
+   * Children are generated from seeds derived from the generation and their
+   * index, so results don't depend on scheduling.
+   */
+  class evolution final {
+  public:
+    using mutator = bruteforce::mutator;
+    using scorer  = bruteforce::scorer;
+
+    struct options {
+      /**
+       * @brief The first input that may be changed.
+       */
+      uint32_t window_begin = 0;
+      /**
+       * @brief One past the last input that may be changed.
+       */
+      uint32_t window_end = 0;
+      /**
+       * @brief The number of inputs to play before scoring. 0 means up to
+       * `window_end`.
+       */
+      uint32_t eval_end = 0;
+      /**
+       * @brief The number of windows per generation.
+       */
+      size_t population = 256;
+      /**
+       * @brief The number of best windows carried over unchanged.
+       */
+      size_t elites = 8;
+      /**
+       * @brief The number of windows competing to be a parent.
+       */
+      size_t tournament = 4;
+      /**
+       * @brief Chance that a child is bred from two parents rather than
+       * copied from one.
+       */
+      double crossover_rate = 0.7;
+      /**
+       * @brief Chance of mutating each frame of a child.
+       */
+      double mutation_rate = 0.02;
+      /**
+       * @brief Seed for breeding.
+       */
+      uint64_t seed = 0;
+      /**
+       * @brief If not empty, the population is saved here after every
+       * generation, and a run resumes from it if it exists.
+       */
+      std::filesystem::path checkpoint;
+      /**
+       * @brief If not empty, the best movie is written here on every
+       * improvement.
+       */
+      std::filesystem::path output;
+    };
+
+    struct stats {
+      uint64_t generations;
+      uint64_t evaluations;
+      double best_score;
+      double mean_score;
+    };
+
+    /**
+     * @brief Callback invoked after each generation; returning false stops
+     * the search.
+     */
+    using progress = std::function<bool(const stats&)>;
+
+  private:
+    struct individual {
+      std::vector<frame> window;
+      double score;
+    };
+
+    sm64_pool& m_pool;
+    m64 m_best;
+    scorer m_score;
+    options m_opts;
+    mutator_set m_mutators;
+    sm64_pool::savestate m_start;
+    std::vector<individual> m_pop;
+    stats m_stats;
+
+    void evaluate(std::vector<individual*>& todo);
+    void breed(individual& child, std::mt19937_64& rng) const;
+    const individual& select(std::mt19937_64& rng) const;
+    void update();
+    void restore();
+    void save() const;
+
+  public:
+    /**
+     * @brief Sets up the optimiser. Every instance plays the base movie up
+     * to the window. If `opts.checkpoint` exists, the population is loaded
+     * from it; otherwise the first call to `run()` starts from the base
+     * window and mutated copies of it.
+     *
+     * @param pool the pool to run on
+     * @param base the movie to start from
+     * @param score the scoring function
+     * @param opts search options
+     * @exception std::invalid_argument if the window is empty or lies past
+     * the end of the movie, or the population is smaller than the elites
+     * @exception std::runtime_error if the checkpoint is for a different
+     * window, evaluation end or population size
+     */
+    evolution(sm64_pool& pool, const m64& base, scorer score, options opts);
+
+    /**
+     * @brief Adds a mutation operator. Operators are picked at random in
+     * proportion to their weights.
+     *
+     * @param fn the operator
+     * @param weight its relative weight
+     */
+    void add_mutator(mutator fn, double weight = 1.0);
+
+    /**
+     * @brief Runs generations. If no mutators were added, stick nudges and
+     * A/B/Z toggles are used.
+     *
+     * @param generations the maximum number of generations
+     * @param cb called after each generation; returning false stops early
+     * @return statistics for the whole search so far
+     */
+    stats run(size_t generations, const progress& cb = nullptr);
+
+    /**
+     * @brief Returns the best movie found.
+     */
+    const m64& best() const { return m_best; }
+
+    /**
+     * @brief Returns the statistics so far.
+     */
+    const stats& statistics() const { return m_stats; }
+  };
+}  // namespace pancake
+#endif
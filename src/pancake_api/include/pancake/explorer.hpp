@@ -0,0 +1,196 @@
+/**
+ * @file explorer.hpp
+ * @author jgcodes2020
+ * @brief Novelty search over coarse game-state cells
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ */
+#ifndef _PANCAKE_EXPLORER_HPP_
+#define _PANCAKE_EXPLORER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <pancake/movie.hpp>
+#include <pancake/sm64.hpp>
+
+namespace pancake {
+  /**
+   * @brief Explores the game by rewarding new states rather than a score
+   * (in the style of Go-Explore).
+   * @details Every state is mapped to a cell by a user-supplied function,
+   * usually a coarse quantisation of a few values such as Mario's action,
+   * position and speed. The archive keeps one savestate per cell, along with
+   * the shortest inputs found that reach it. Each iteration picks a cell,
+   * favouring ones that were rarely picked or reached, restores it, and
+   * plays random inputs from there, adding any new cells it passes through.
+   *
+   * @note Each cell holds a full savestate, so memory use grows with the
+   * number of cells.
+   */
+  class explorer final {
+  public:
+    /**
+     * @brief Maps the current game state to a cell.
+     */
+    using cell_fn = std::function<uint64_t(sm64& game)>;
+    /**
+     * @brief Generates a random input.
+     */
+    using generator = std::function<frame(std::mt19937_64& rng)>;
+
+    struct options {
+      /**
+       * @brief Frames of random input played from a cell per iteration.
+       */
+      size_t explore_frames = 50;
+      /**
+       * @brief Chance of repeating the previous input instead of generating
+       * a new one, which makes exploration less jittery.
+       */
+      double repeat_rate = 0.9;
+      /**
+       * @brief Seed for cell selection and input generation.
+       */
+      uint64_t seed = 0;
+    };
+
+    struct stats {
+      uint64_t iterations;
+      uint64_t frames;
+      uint64_t cells;
+      /**
+       * @brief The number of times a known cell was reached by shorter
+       * inputs.
+       */
+      uint64_t shortened;
+    };
+
+    /**
+     * @brief Public information about a cell in the archive.
+     */
+    struct cell_info {
+      uint64_t key;
+      /**
+       * @brief The number of inputs after the prefix needed to reach it.
+       */
+      size_t length;
+      /**
+       * @brief The number of times it was picked to explore from.
+       */
+      uint64_t chosen;
+      /**
+       * @brief The number of times exploration passed through it.
+       */
+      uint64_t seen;
+    };
+
+    /**
+     * @brief Callback invoked after each iteration; returning false stops
+     * the search.
+     */
+    using progress = std::function<bool(const stats&)>;
+
+  private:
+    struct cell {
+      cell_info info;
+      std::vector<frame> inputs;
+      sm64::savestate state;
+    };
+
+    sm64& m_game;
+    m64 m_prefix;
+    cell_fn m_cell;
+    generator m_gen;
+    options m_opts;
+    std::mt19937_64 m_rng;
+    std::vector<cell> m_cells;
+    std::unordered_map<uint64_t, size_t> m_index;
+    stats m_stats;
+
+    void visit(const std::vector<frame>& inputs);
+
+  public:
+    /**
+     * @brief Sets up a search. The game plays `prefix`, and the state after
+     * it becomes the first cell.
+     *
+     * @param game the game to explore
+     * @param prefix inputs leading to the starting state
+     * @param fn the cell function
+     * @param opts search options
+     */
+    explorer(sm64& game, const m64& prefix, cell_fn fn, options opts);
+
+    /**
+     * @brief Replaces the input generator. The default picks a uniformly
+     * random stick position and presses each of A, B and Z with a 1/4
+     * chance.
+     */
+    void set_generator(generator gen) { m_gen = std::move(gen); }
+
+    /**
+     * @brief Runs iterations of the search.
+     *
+     * @param iterations the maximum number of iterations
+     * @param cb called after each iteration; returning false stops early
+     * @return statistics for the whole search so far
+     */
+    stats run(size_t iterations, const progress& cb = nullptr);
+
+    /**
+     * @brief Returns the statistics so far.
+     */
+    const stats& statistics() const { return m_stats; }
+
+    /**
+     * @brief Returns every cell in the archive, in order of discovery.
+     */
+    std::vector<cell_info> cells() const;
+
+    /**
+     * @brief Checks if a cell is in the archive.
+     */
+    bool contains(uint64_t key) const { return m_index.count(key) != 0; }
+
+    /**
+     * @brief Returns the prefix followed by the shortest inputs found that
+     * reach a cell.
+     *
+     * @exception std::out_of_range if the cell isn't in the archive
+     */
+    m64 movie(uint64_t key) const;
+
+    /**
+     * @brief Restores the game to a cell's savestate.
+     *
+     * @exception std::out_of_range if the cell isn't in the archive
+     */
+    void load(uint64_t key) const;
+
+    /**
+     * @brief Builds a cell function from accessor expressions and bucket
+     * sizes. Each value is divided by its bucket size and floored (a size of
+     * 0 uses the value as is), and the results are hashed together. NaNs
+     * all fall in one cell.
+     *
+     * @param game the game the cell function will be used with
+     * @param watch pairs of an expression and its bucket size
+     * @return the cell function
+     * @exception std::invalid_argument if a bucket size is negative or NaN
+     * @exception pancake::type_error if an expression isn't a fundamental
+     * type
+     */
+    static cell_fn quantise(
+      sm64& game, const std::vector<std::pair<std::string, double>>& watch);
+  };
+}  // namespace pancake
+#endif
@@ -0,0 +1,47 @@
+/**
+ * @file formula.hpp
+ * @author jgcodes2020
+ * @brief Arithmetic and predicates over fields, compiled at runtime
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ */
+#ifndef _PANCAKE_FORMULA_HPP_
+#define _PANCAKE_FORMULA_HPP_
+
+#include <string>
+
+#include <pancake/expr/vm.hpp>
+#include <pancake/sm64.hpp>
+
+namespace pancake {
+  /**
+   * @brief A compiled formula, bound to one game instance.
+   * @details Evaluate it with `eval()`, `eval_int()` or `test()`. A formula
+   * is also a `bool()` callable, so it can be passed straight to
+   * `sm64::run_until()`:
+   * @code{.cpp}
+   * auto pred = pancake::compile_formula(game,
+   *   "hypot(gMarioStates[0].vel[0], gMarioStates[0].vel[2]) > 40 && "
+   *   "gMarioStates[0].action == ACT_LONG_JUMP");
+   * game.run_until(pred, inputs, 300);
+   * @endcode
+   * @note Evaluation reuses the formula's registers, so one formula can't be
+   * evaluated from several threads at once; copy it instead.
+   */
+  using formula = expr::program;
+
+  /**
+   * @brief Parses and compiles a formula against a game.
+   *
+   * @param game the game whose fields the formula reads
+   * @param text the formula
+   * @return the compiled formula
+   * @exception std::invalid_argument if the formula is malformed
+   * @exception pancake::type_error if an accessor expression isn't a
+   * fundamental type
+   */
+  formula compile_formula(sm64& game, const std::string& text);
+}  // namespace pancake
+#endif
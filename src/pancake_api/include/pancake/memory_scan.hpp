@@ -0,0 +1,134 @@
+/**
+ * @file memory_scan.hpp
+ * @author jgcodes2020
+ * @brief Scans the game's memory for unknown variables
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ */
+#ifndef _PANCAKE_MEMORY_SCAN_HPP_
+#define _PANCAKE_MEMORY_SCAN_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <pancake/address_index.hpp>
+#include <pancake/sm64.hpp>
+
+namespace pancake {
+  /**
+   * @brief The type of value a `memory_scan` looks for.
+   */
+  enum class scan_type : uint8_t { s8, s16, s32, s64, f32, f64 };
+
+  /**
+   * @brief A location that survived a scan.
+   */
+  struct scan_hit {
+    void* addr;
+    /**
+     * @brief The value at `addr` when the hit was listed.
+     */
+    double value;
+    /**
+     * @brief The address as an accessor expression, if an index was given.
+     */
+    std::string path;
+  };
+
+  /**
+   * @brief Finds locations in `.data` and `.bss` holding a value, narrowing
+   * the candidates over repeated scans.
+   * @details Every aligned location starts as a candidate. Each scan keeps
+   * the candidates that pass a test, tracked as one bit per location, and
+   * remembers the memory it saw for the next relative scan (`changed()`,
+   * `increased()`, ...). Scans skip 64 locations at a time where none are
+   * left, and otherwise test them in a loop the compiler can vectorise.
+   */
+  class memory_scan final {
+  private:
+    struct region {
+      const char* base;
+      size_t size;
+      // number of candidate locations the bitmap covers
+      size_t slots;
+      std::vector<uint64_t> bits;
+      std::vector<char> last;
+    };
+
+    scan_type m_type;
+    size_t m_align;
+    size_t m_count;
+    std::vector<region> m_regions;
+
+    template <typename F>
+    size_t narrow(F&& pred);
+
+  public:
+    /**
+     * @brief Starts a scan with every location as a candidate.
+     *
+     * @param game the game to scan
+     * @param type the type of value to look for
+     * @param align the distance between locations, in bytes; 0 uses the
+     * type's size
+     */
+    memory_scan(sm64& game, scan_type type, size_t align = 0);
+
+    /**
+     * @brief Makes every location a candidate again, and remembers the
+     * current memory.
+     */
+    void reset();
+
+    /**
+     * @brief Keeps locations holding `value`.
+     * @return the number of candidates left
+     */
+    size_t exact(double value);
+    /**
+     * @brief Keeps locations holding a value in `[lo, hi]`. Values are
+     * compared as doubles.
+     * @return the number of candidates left
+     */
+    size_t range(double lo, double hi);
+    /**
+     * @brief Keeps locations whose value changed since the last scan.
+     * @return the number of candidates left
+     */
+    size_t changed();
+    /**
+     * @brief Keeps locations whose value didn't change since the last scan.
+     * @return the number of candidates left
+     */
+    size_t unchanged();
+    /**
+     * @brief Keeps locations whose value increased since the last scan.
+     * @return the number of candidates left
+     */
+    size_t increased();
+    /**
+     * @brief Keeps locations whose value decreased since the last scan.
+     * @return the number of candidates left
+     */
+    size_t decreased();
+
+    /**
+     * @brief Returns the number of candidates left.
+     */
+    size_t count() const { return m_count; }
+
+    /**
+     * @brief Lists candidates in address order.
+     *
+     * @param limit the most candidates to list
+     * @param index if given, used to fill in each hit's path
+     */
+    std::vector<scan_hit> hits(
+      size_t limit = SIZE_MAX, const address_index* index = nullptr) const;
+  };
+}  // namespace pancake
+#endif
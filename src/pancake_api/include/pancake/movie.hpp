@@ -11,6 +11,7 @@
 #define _PANCAKE_MOVIE_HPP_
 
 #include <cstdint>
+#include <cstdio>
 #include <string.h>
 #include <array>
 #include <filesystem>
@@ -150,6 +151,13 @@ namespace pancake {
     :param game: the game to apply to
     */
     void apply(sm64& game) const;
+
+    bool operator==(const frame& other) const {
+      return buttons == other.buttons && stick_x == other.stick_x &&
+        stick_y == other.stick_y;
+    }
+
+    bool operator!=(const frame& other) const { return !(*this == other); }
   };
 
   /**
@@ -307,12 +315,13 @@ namespace pancake {
      * @param mdata the metadata
      */
     template <typename input_it>
-    m64(input_it begin, input_it end, metadata_s& mdata) : m_inputs(begin, end), metadata(mdata) {
+    m64(input_it begin, input_it end, const metadata_s& mdata) : m_inputs(begin, end), metadata(mdata) {
       size_t rsize = m_inputs.size();
       // if any of the upper 32 bits are set, it's too big
       if (rsize & 0xFFFFFFFF00000000) {
         throw std::domain_error("M64 files are limited to 2^32 - 1 inputs");
       }
+      metadata._num_input_frames = static_cast<uint32_t>(rsize);
     }
 
     /**
@@ -424,12 +433,148 @@ namespace pancake {
     void pop_back();
     
     /**
-     * @brief Serializes this M64 to an output stream.
+     * @brief Serializes this M64 to a file. The file is written through a
+     * temporary file and a rename, so it's never left half-written.
      * 
-     * @param out an output stream to write to
+     * @param path the file to write to
      */
     void dump(std::filesystem::path path);
   };
+
+  /**
+   * @brief Appends frames to an .m64 file on disk without rewriting it.
+   * @details Frames are buffered in memory and written on flush. The header's
+   * frame count is patched only after the frames themselves are written, so a
+   * crash leaves a valid file holding everything up to the last flush.
+   */
+  class m64_writer final {
+  public:
+    /**
+     * @brief Controls when written data is forced to stable storage.
+     */
+    enum class sync_policy {
+      /**
+       * @brief Never call fsync, leave it to the OS.
+       */
+      none,
+      /**
+       * @brief Sync checkpoint files before renaming them into place.
+       */
+      on_checkpoint,
+      /**
+       * @brief Sync on every flush, as well as on checkpoints. This is the
+       * only policy under which a crash loses at most the frames since the
+       * last flush; with the others, frames the OS hasn't written back yet
+       * can be lost too.
+       */
+      on_flush
+    };
+
+    /**
+     * @brief Options for an m64_writer.
+     */
+    struct options {
+      /**
+       * @brief Number of buffered frames that triggers an automatic flush.
+       * 0 means only flush when asked to.
+       */
+      uint32_t flush_interval = 1800;
+      /**
+       * @brief When to fsync.
+       */
+      sync_policy sync = sync_policy::on_flush;
+    };
+
+  private:
+    std::filesystem::path m_path;
+    std::FILE* m_file;
+    std::vector<char> m_buffer;
+    uint32_t m_size;
+    options m_opts;
+
+  public:
+    /**
+     * @brief Creates (or replaces) an .m64 file with the given metadata and
+     * no frames.
+     *
+     * @param path the path to write to
+     * @param mdata the metadata to write into the header
+     * @param opts writer options
+     */
+    m64_writer(
+      std::filesystem::path path, const m64::metadata_s& mdata,
+      options opts);
+    m64_writer(std::filesystem::path path, const m64::metadata_s& mdata);
+    /**
+     * @brief Creates (or replaces) an .m64 file, starting with the metadata
+     * and frames of an existing M64.
+     *
+     * @param path the path to write to
+     * @param base the M64 to start from
+     * @param opts writer options
+     */
+    m64_writer(std::filesystem::path path, const m64& base, options opts);
+    m64_writer(std::filesystem::path path, const m64& base);
+    /**
+     * @brief Reopens an .m64 file written earlier, appending after its last
+     * recorded frame. Anything past that frame (e.g. from a crash mid-flush)
+     * is overwritten.
+     *
+     * @param path the path to reopen
+     * @param opts writer options
+     */
+    m64_writer(std::filesystem::path path, options opts);
+
+    m64_writer(const m64_writer&) = delete;
+    m64_writer& operator=(const m64_writer&) = delete;
+
+    /**
+     * @brief Flushes and closes the file.
+     */
+    ~m64_writer();
+
+    /**
+     * @brief Appends a frame. May flush if the buffer is full.
+     *
+     * @param frame the frame to append
+     */
+    void push_back(const frame& frame);
+
+    /**
+     * @brief Appends a range of frames.
+     *
+     * @tparam input_it an input iterator of frame
+     * @param begin the beginning iterator
+     * @param end the ending iterator
+     */
+    template <typename input_it>
+    void append(input_it begin, input_it end) {
+      for (; begin != end; ++begin)
+        push_back(*begin);
+    }
+
+    /**
+     * @brief Returns the number of frames in the movie, including buffered
+     * frames.
+     */
+    uint32_t size() const {
+      return m_size + static_cast<uint32_t>(m_buffer.size() / 4);
+    }
+
+    /**
+     * @brief Writes buffered frames, then patches the header's frame count.
+     */
+    void flush();
+
+    /**
+     * @brief Flushes, then atomically replaces `dest` with a copy of the
+     * current file (via a temporary file and a rename).
+     *
+     * @param dest the checkpoint path
+     */
+    void checkpoint(const std::filesystem::path& dest);
+  };
+
   _PANCAKE_ENUM_BITFIELD_OPS(frame::button)
   _PANCAKE_ENUM_BITFIELD_OPS(m64::metadata_s::ctrler_flags)
 }  // namespace pancake
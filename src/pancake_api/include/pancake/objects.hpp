@@ -0,0 +1,158 @@
+/**
+ * @file objects.hpp
+ * @author jgcodes2020
+ * @brief Queries over the game's active objects
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ */
+#ifndef _PANCAKE_OBJECTS_HPP_
+#define _PANCAKE_OBJECTS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <pancake/dwarf/type_info.hpp>
+#include <pancake/sm64.hpp>
+
+namespace pancake {
+  /**
+   * @brief The requested fields of every matching object on one frame, one
+   * column per field.
+   */
+  struct object_snapshot {
+    /**
+     * @brief Each object's index in `gObjectPool`, in list order.
+     */
+    std::vector<uint16_t> slots;
+    /**
+     * @brief The field names, in the order they were requested.
+     */
+    std::vector<std::string> fields;
+    /**
+     * @brief `columns[f][i]` is field `f` of object `i`.
+     */
+    std::vector<std::vector<double>> columns;
+
+    /**
+     * @brief Returns the number of objects.
+     */
+    size_t size() const { return slots.size(); }
+
+    /**
+     * @brief Returns the column of a field.
+     * @exception std::out_of_range if the field wasn't requested
+     */
+    const std::vector<double>& column(const std::string& field) const;
+  };
+
+  /**
+   * @brief Finds active objects and reads their fields.
+   * @details The object pool, the object lists and every field are resolved
+   * once, on construction. Running the query follows the lists' `next`
+   * pointers directly, without evaluating any accessor expressions.
+   */
+  class object_query final {
+  public:
+    /**
+     * @brief A field's place within `struct Object`.
+     */
+    struct field {
+      size_t offset;
+      dwarf::base_type_info type;
+    };
+
+  private:
+    const char* m_pool;
+    size_t m_stride;
+    size_t m_capacity;
+    // sentinels of the object lists; each one's next is the first object
+    std::vector<const char*> m_lists;
+    size_t m_header;
+    size_t m_next;
+    size_t m_active_flags;
+    size_t m_behavior;
+
+    const void* m_filter;
+    std::vector<std::string> m_names;
+    std::vector<field> m_fields;
+
+    // points to an object, given the ObjectNode at its header
+    const char* object_of(const char* node) const { return node - m_header; }
+    const char* next_of(const char* node) const {
+      return *reinterpret_cast<const char* const*>(node + m_next);
+    }
+    bool matches(const char* obj) const {
+      // ACTIVE_FLAG_ACTIVE
+      int16_t flags = *reinterpret_cast<const int16_t*>(obj + m_active_flags);
+      if ((flags & 0x0001) == 0)
+        return false;
+      return m_filter == nullptr ||
+        *reinterpret_cast<const void* const*>(obj + m_behavior) == m_filter;
+    }
+
+  public:
+    /**
+     * @brief Resolves a query.
+     *
+     * @param game the game to query
+     * @param fields fields of `struct Object` to read, written as accessor
+     * expressions relative to an object (e.g. `oPosY` or `header.gfx.angle[1]`)
+     * @param behavior the symbol of a behaviour script (e.g. `bhvGoomba`) to
+     * filter by, or empty for every active object
+     * @exception pancake::type_error if a field isn't a fundamental type, or
+     * follows a pointer
+     * @exception pancake::dl::dl_error if the behaviour script doesn't exist
+     */
+    object_query(
+      sm64& game, const std::vector<std::string>& fields,
+      const std::string& behavior = "");
+
+    /**
+     * @brief Returns the number of objects `gObjectPool` holds.
+     */
+    size_t capacity() const { return m_capacity; }
+
+    /**
+     * @brief Returns the resolved fields, in the order they were requested.
+     */
+    const std::vector<field>& fields() const { return m_fields; }
+
+    /**
+     * @brief Calls `fn(slot, object)` for every active object the query
+     * matches, in list order. `object` points to the `struct Object`.
+     */
+    template <typename F>
+    void for_each(F&& fn) const {
+      for (const char* head : m_lists) {
+        // bounds the walk if a list is mid-update or corrupt
+        size_t left = m_capacity;
+        for (const char* node = next_of(head); node != head && left > 0;
+             node = next_of(node), left--) {
+          const char* obj = object_of(node);
+          if (matches(obj))
+            fn(size_t(obj - m_pool) / m_stride, obj);
+        }
+      }
+    }
+
+    /**
+     * @brief Snapshots the matching objects on the current frame.
+     */
+    object_snapshot run() const {
+      object_snapshot res;
+      run(res);
+      return res;
+    }
+
+    /**
+     * @brief Snapshots the matching objects on the current frame, reusing
+     * a snapshot's storage.
+     */
+    void run(object_snapshot& out) const;
+  };
+}  // namespace pancake
+#endif
@@ -0,0 +1,68 @@
+/**
+ * @file patch.hpp
+ * @author jgcodes2020
+ * @brief Compiled sets of field writes
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ */
+#ifndef _PANCAKE_PATCH_HPP_
+#define _PANCAKE_PATCH_HPP_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <pancake/sm64.hpp>
+
+namespace pancake {
+  /**
+   * @brief A set of fields to overwrite, resolved once.
+   * @details Applying the patch converts each value to its field's type and
+   * stores it, with no lookups or string work.
+   */
+  class write_patch final {
+  private:
+    std::vector<sm64::accessor> m_fields;
+
+  public:
+    /**
+     * @brief Resolves a list of fields.
+     *
+     * @param game the game to write to
+     * @param fields accessor expressions for each field
+     * @exception pancake::type_error if a field isn't a fundamental type
+     */
+    write_patch(sm64& game, const std::vector<std::string>& fields);
+
+    /**
+     * @brief Returns the number of fields.
+     */
+    size_t size() const { return m_fields.size(); }
+
+    /**
+     * @brief Writes `values[i]` to field `i`, for every field.
+     *
+     * @param values at least `size()` values
+     * @exception std::out_of_range if a value is NaN or doesn't fit in its
+     * field; earlier fields have already been written
+     */
+    void apply(const double* values) const {
+      for (size_t i = 0; i < m_fields.size(); i++)
+        m_fields[i].set(values[i]);
+    }
+
+    /**
+     * @brief Writes `values[i]` to field `i`, for every field.
+     *
+     * @param values at least `size()` values
+     * @exception std::out_of_range if a value is NaN or doesn't fit in its
+     * field
+     */
+    void apply(const std::vector<double>& values) const {
+      apply(values.data());
+    }
+  };
+}  // namespace pancake
+#endif
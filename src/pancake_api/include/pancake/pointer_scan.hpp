@@ -0,0 +1,81 @@
+/**
+ * @file pointer_scan.hpp
+ * @author jgcodes2020
+ * @brief Finds accessor expressions that reach an address
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ */
+#ifndef _PANCAKE_POINTER_SCAN_HPP_
+#define _PANCAKE_POINTER_SCAN_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <pancake/address_index.hpp>
+#include <pancake/sm64.hpp>
+
+namespace pancake {
+  /**
+   * @brief An accessor expression that reaches an address.
+   */
+  struct pointer_path {
+    /**
+     * @brief The expression, in the syntax `expr::parse()` accepts.
+     */
+    std::string path;
+    /**
+     * @brief The number of pointers the expression follows.
+     */
+    size_t depth;
+  };
+
+  /**
+   * @brief Finds accessor expressions that lead to an address, by following
+   * pointers out from every global.
+   * @details The search goes one pointer deeper per round. Every object
+   * reached in a round is walked with its type's layout, on several
+   * threads, and each pointer it holds becomes an object for the next
+   * round. An object already reached at the same address with the same
+   * type isn't walked again, so each piece of memory is visited once, by
+   * its shortest path. Only pointers into libsm64's `.data` and `.bss` are
+   * followed. Before being returned, every expression is resolved against
+   * the game, and any that doesn't lead back to the target is dropped.
+   */
+  class pointer_scan final {
+  private:
+    sm64& m_game;
+    const address_index& m_index;
+    std::vector<std::pair<uintptr_t, uintptr_t>> m_memory;
+    // whether each type node holds a pointer worth following
+    std::vector<bool> m_has_pointer;
+
+    bool readable(uintptr_t addr, size_t size) const;
+
+  public:
+    /**
+     * @brief Prepares a scanner.
+     *
+     * @param game the game to scan, which must outlive the scanner
+     * @param index an index of the same game, which must outlive the scanner
+     */
+    pointer_scan(sm64& game, const address_index& index);
+
+    /**
+     * @brief Finds expressions that reach an address in the game's current
+     * memory.
+     *
+     * @param target the address to reach
+     * @param max_depth the most pointers an expression may follow
+     * @param threads the number of threads to use; 0 uses one per core
+     * @return the expressions, fewest pointers first, then shortest first
+     */
+    std::vector<pointer_path> find(
+      const void* target, size_t max_depth = 3, size_t threads = 0) const;
+  };
+}  // namespace pancake
+#endif
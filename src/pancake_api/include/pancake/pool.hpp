@@ -0,0 +1,189 @@
+/**
+ * @file pool.hpp
+ * @author jgcodes2020
+ * @brief A pool of independent libsm64 instances
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ */
+#ifndef _PANCAKE_POOL_HPP_
+#define _PANCAKE_POOL_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <pancake/sm64.hpp>
+
+namespace pancake {
+  namespace details {
+    /**
+     * @brief Hands out indices in [0, n) to a fixed set of workers. Each
+     * worker starts with a contiguous share and steals half of the largest
+     * remaining share once its own runs out.
+     */
+    class work_stealer final {
+    private:
+      struct share {
+        std::mutex lock;
+        size_t begin;
+        size_t end;
+      };
+      std::unique_ptr<share[]> m_shares;
+      size_t m_workers;
+
+    public:
+      work_stealer(size_t n, size_t workers);
+
+      /**
+       * @brief Gets the next index for a worker.
+       *
+       * @param worker the worker's index
+       * @param item set to the next index
+       * @return false if there is no work left anywhere
+       */
+      bool next(size_t worker, size_t& item);
+    };
+  }  // namespace details
+
+  /**
+   * @brief A set of independent libsm64 instances for running work in
+   * parallel.
+   * @details Loading the same library path twice gives back the same module
+   * (and the same globals), so each instance is loaded from its own temporary
+   * copy of the library. Copies are deleted when the pool is destroyed.
+   *
+   * Savestates only work on the instance they were made from, since libsm64's
+   * globals contain pointers into its own image.
+   */
+  class sm64_pool final {
+  private:
+    std::vector<std::filesystem::path> m_paths;
+    std::vector<std::unique_ptr<sm64>> m_games;
+
+  public:
+    /**
+     * @brief One savestate per instance in a pool.
+     */
+    class savestate final {
+      friend class sm64_pool;
+
+    private:
+      std::vector<sm64::savestate> m_states;
+
+      savestate() = default;
+
+    public:
+      /**
+       * @brief Saves every instance's state.
+       */
+      void save();
+      /**
+       * @brief Loads every instance's state.
+       */
+      void load() const;
+
+      /**
+       * @brief Returns the savestate for the `i`th instance.
+       */
+      sm64::savestate& operator[](size_t i) { return m_states[i]; }
+      const sm64::savestate& operator[](size_t i) const { return m_states[i]; }
+    };
+
+    /**
+     * @brief Loads `count` instances of libsm64.
+     *
+     * @param path path to libsm64
+     * @param count the number of instances. 0 means one per hardware thread.
+     */
+    sm64_pool(const std::filesystem::path& path, size_t count = 0);
+
+    sm64_pool(const sm64_pool&) = delete;
+    sm64_pool& operator=(const sm64_pool&) = delete;
+
+    ~sm64_pool();
+
+    /**
+     * @brief Returns the number of instances.
+     */
+    size_t size() const { return m_games.size(); }
+
+    /**
+     * @brief Returns the `i`th instance.
+     */
+    sm64& operator[](size_t i) { return *m_games[i]; }
+
+    /**
+     * @brief Allocates a savestate for every instance.
+     */
+    [[nodiscard]] savestate alloc_svst() const;
+
+    /**
+     * @brief Runs `fn(i, game)` once on every instance, each on its own
+     * thread. If any call throws, the first exception is rethrown once all
+     * threads have finished.
+     *
+     * @tparam F callable as `void(size_t, sm64&)`
+     * @param fn the function to run
+     */
+    template <typename F>
+    void for_each(F&& fn) {
+      std::vector<std::thread> threads;
+      std::exception_ptr error;
+      std::mutex error_lock;
+
+      threads.reserve(m_games.size());
+      for (size_t i = 0; i < m_games.size(); i++) {
+        threads.emplace_back([&, i]() {
+          try {
+            fn(i, *m_games[i]);
+          }
+          catch (...) {
+            std::lock_guard<std::mutex> guard(error_lock);
+            if (!error)
+              error = std::current_exception();
+          }
+        });
+      }
+      for (auto& t : threads)
+        t.join();
+      if (error)
+        std::rethrow_exception(error);
+    }
+
+    /**
+     * @brief Runs `fn(i, game, item)` for every item in [0, n), spread over
+     * all instances with work stealing. If any call throws, remaining items
+     * are skipped and the first exception is rethrown.
+     *
+     * @tparam F callable as `void(size_t, sm64&, size_t)`
+     * @param n the number of items
+     * @param fn the function to run
+     */
+    template <typename F>
+    void parallel_for(size_t n, F&& fn) {
+      details::work_stealer queue(n, m_games.size());
+      std::atomic<bool> failed {false};
+      for_each([&](size_t i, sm64& game) {
+        size_t item;
+        while (!failed.load(std::memory_order_relaxed) && queue.next(i, item)) {
+          try {
+            fn(i, game, item);
+          }
+          catch (...) {
+            failed.store(true, std::memory_order_relaxed);
+            throw;
+          }
+        }
+      });
+    }
+  };
+}  // namespace pancake
+#endif
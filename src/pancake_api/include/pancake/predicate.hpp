@@ -0,0 +1,234 @@
+/**
+ * @file predicate.hpp
+ * @author jgcodes2020
+ * @brief Allocation-free stop conditions for sm64::run_until()
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ */
+#ifndef _PANCAKE_PREDICATE_HPP_
+#define _PANCAKE_PREDICATE_HPP_
+
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include <pancake/sm64.hpp>
+
+/**
+ * @brief Stop conditions built from resolved fields.
+ * @details Conditions are plain objects composed at compile time, so
+ * checking one each frame is a handful of loads and compares, with no
+ * allocation or string work:
+ * @code{.cpp}
+ * using namespace pancake::pred;
+ * auto action = watch<uint32_t>(game, "gMarioStates[0].action");
+ * auto timer  = watch<uint32_t>(game, "gGlobalTimer");
+ * game.run_until(changed(action) || timer >= 1000, inputs, 300);
+ * @endcode
+ *
+ * Every condition has `reset()`, called once before the first frame so
+ * edge-triggered conditions can take their starting values, and
+ * `operator()()`, called after every frame.
+ */
+namespace pancake::pred {
+  /**
+   * @brief Base of every condition, used to constrain the operators.
+   */
+  template <typename D>
+  struct condition {
+    const D& self() const { return static_cast<const D&>(*this); }
+    D& self() { return static_cast<D&>(*this); }
+  };
+
+  /**
+   * @brief A resolved field of type `T`.
+   */
+  template <typename T>
+  struct field {
+    const T* ptr;
+
+    T get() const { return *ptr; }
+  };
+
+  /**
+   * @brief Resolves a field, checking its type against `T`.
+   *
+   * @param game the game to read from
+   * @param expr an accessor expression
+   * @return the field
+   */
+  template <typename T>
+  field<T> watch(sm64& game, const std::string& expr) {
+    return field<T> {&game.get<T>(expr)};
+  }
+
+  /**
+   * @brief Compares a field against a constant.
+   */
+  template <typename T, typename Op>
+  struct compare : condition<compare<T, Op>> {
+    field<T> lhs;
+    T rhs;
+
+    compare(field<T> l, T r) : lhs(l), rhs(r) {}
+
+    void reset() {}
+    bool operator()() const { return Op {}(lhs.get(), rhs); }
+  };
+
+#define _PANCAKE_PRED_COMPARE(op, fn)                                      \
+  template <typename T, typename U>                                       \
+  compare<T, fn<T>> operator op(field<T> lhs, U rhs) {                     \
+    static_assert(std::is_arithmetic_v<U>, "Compare against a number");   \
+    return compare<T, fn<T>>(lhs, static_cast<T>(rhs));                   \
+  }
+  _PANCAKE_PRED_COMPARE(==, std::equal_to)
+  _PANCAKE_PRED_COMPARE(!=, std::not_equal_to)
+  _PANCAKE_PRED_COMPARE(<, std::less)
+  _PANCAKE_PRED_COMPARE(<=, std::less_equal)
+  _PANCAKE_PRED_COMPARE(>, std::greater)
+  _PANCAKE_PRED_COMPARE(>=, std::greater_equal)
+#undef _PANCAKE_PRED_COMPARE
+
+  /**
+   * @brief Holds when a field differs from its value on the previous frame
+   * (or, on the first frame, from its value before it).
+   */
+  template <typename T>
+  struct changed_t : condition<changed_t<T>> {
+    field<T> f;
+    T last;
+
+    changed_t(field<T> f_p) : f(f_p), last() {}
+
+    void reset() { last = f.get(); }
+    bool operator()() {
+      T now    = f.get();
+      bool hit = (now != last);
+      last     = now;
+      return hit;
+    }
+  };
+
+  /**
+   * @brief Holds when a field changes.
+   */
+  template <typename T>
+  changed_t<T> changed(field<T> f) {
+    return changed_t<T>(f);
+  }
+
+  /**
+   * @brief Holds on the frame a condition goes from false to true.
+   */
+  template <typename C>
+  struct rises_t : condition<rises_t<C>> {
+    C inner;
+    bool last;
+
+    rises_t(C c) : inner(std::move(c)), last(false) {}
+
+    void reset() {
+      inner.reset();
+      last = inner();
+    }
+    bool operator()() {
+      bool now = inner();
+      bool hit = now && !last;
+      last     = now;
+      return hit;
+    }
+  };
+
+  /**
+   * @brief Holds on the frame `c` becomes true.
+   */
+  template <typename C>
+  rises_t<C> rises(const condition<C>& c) {
+    return rises_t<C>(c.self());
+  }
+
+  template <typename A, typename B>
+  struct all_t : condition<all_t<A, B>> {
+    A a;
+    B b;
+
+    all_t(A a_p, B b_p) : a(std::move(a_p)), b(std::move(b_p)) {}
+
+    void reset() {
+      a.reset();
+      b.reset();
+    }
+    // Both sides are always evaluated so edge-triggered ones stay current.
+    bool operator()() {
+      bool x = a();
+      bool y = b();
+      return x && y;
+    }
+  };
+
+  template <typename A, typename B>
+  struct any_t : condition<any_t<A, B>> {
+    A a;
+    B b;
+
+    any_t(A a_p, B b_p) : a(std::move(a_p)), b(std::move(b_p)) {}
+
+    void reset() {
+      a.reset();
+      b.reset();
+    }
+    bool operator()() {
+      bool x = a();
+      bool y = b();
+      return x || y;
+    }
+  };
+
+  template <typename C>
+  struct negate_t : condition<negate_t<C>> {
+    C inner;
+
+    negate_t(C c) : inner(std::move(c)) {}
+
+    void reset() { inner.reset(); }
+    bool operator()() { return !inner(); }
+  };
+
+  template <typename A, typename B>
+  all_t<A, B> operator&&(const condition<A>& a, const condition<B>& b) {
+    return all_t<A, B>(a.self(), b.self());
+  }
+
+  template <typename A, typename B>
+  any_t<A, B> operator||(const condition<A>& a, const condition<B>& b) {
+    return any_t<A, B>(a.self(), b.self());
+  }
+
+  template <typename C>
+  negate_t<C> operator!(const condition<C>& c) {
+    return negate_t<C>(c.self());
+  }
+
+  /**
+   * @brief Wraps an arbitrary callable `bool()` as a condition.
+   */
+  template <typename F>
+  struct custom_t : condition<custom_t<F>> {
+    F fn;
+
+    custom_t(F f) : fn(std::move(f)) {}
+
+    void reset() {}
+    bool operator()() { return fn(); }
+  };
+
+  template <typename F>
+  custom_t<F> custom(F fn) {
+    return custom_t<F>(std::move(fn));
+  }
+}  // namespace pancake::pred
+#endif
@@ -11,27 +11,43 @@
 #define _PANCAKE_SM64_HPP_
 
 #include <any>
+#include <array>
+#include <cmath>
+#include <cstdint>
 #include <cstddef>
 #include <filesystem>
+#include <limits>
 #include <memory>
+#include <optional>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <type_traits>
+#include <typeinfo>
 #include <unordered_map>
+#include <utility>
 #include <variant>
+#include <vector>
 
 #include "pancake/dl/pdl.hpp"
 #include "pancake/dwarf/types.hpp"
 #include <pancake/dwarf/type_info.hpp>
 #include <pancake/exception.hpp>
 #include <pancake/movie.hpp>
+#include <pancake/struct_layout.hpp>
+#include <pancake/stx/strided_span.hpp>
 
 using std::nullptr_t;
 
 namespace pancake {
-  
-  
+  namespace details {
+    template <typename T, typename = void>
+    struct has_reset : std::false_type {};
+    template <typename T>
+    struct has_reset<T, std::void_t<decltype(std::declval<T&>().reset())>> :
+      std::true_type {};
+  }  // namespace details
+
 
   /**
    * @brief An instance of the SM64 DLL.
@@ -40,22 +56,168 @@ namespace pancake {
   class sm64 {
     friend struct frame;
 
+  public:
+    class input_sink;
+
   private:
     struct expr_info {
       void* ptr;
       pancake::dwarf::base_type_info type;
     };
     
+    std::filesystem::path m_path;
     dl::library lib;
     dwarf::debug dbg;
     std::unordered_map<std::string, expr_info> cache;
+    struct struct_info {
+      void* ptr;
+      // set if the mirror's fields cover every member its bytes overlap
+      bool complete;
+    };
+
+    std::unordered_map<std::string, struct_info> struct_cache;
+    std::unique_ptr<input_sink> m_input;
+    void (*m_update)();
 
     void* _impl_get(
       const std::string& expr,
       dwarf::base_type_info type = dwarf::base_type_info {
         dwarf::encoding::none, 0});
+    stx::strided_span<char> _impl_get_span(
+      const std::string& expr, dwarf::base_type_info type);
+    void* _impl_get_struct(
+      const std::string& expr, const char* key, size_t size, size_t align,
+      std::vector<struct_field> (*fields)(), bool writable);
 
   public:
+    /**
+     * @brief Writes input frames directly into libsm64's controller pads.
+     * @details The pad addresses for all 4 controllers are resolved once,
+     * when the owning sm64 is constructed, so applying a frame is just a few
+     * stores.
+     */
+    class input_sink final {
+      friend class sm64;
+
+    private:
+      struct pad {
+        uint16_t* button;
+        int8_t* stick_x;
+        int8_t* stick_y;
+      };
+      std::array<pad, 4> pads;
+
+      input_sink(sm64& game);
+
+    public:
+      /**
+       * @brief Applies a frame to one of the controllers.
+       *
+       * @param f the frame to apply
+       * @param controller the controller to apply it to, from 0 to 3
+       */
+      void apply(const frame& f, size_t controller = 0) const noexcept {
+        const pad& p = pads[controller];
+        *p.button    = static_cast<uint16_t>(f.buttons);
+        *p.stick_x   = f.stick_x;
+        *p.stick_y   = f.stick_y;
+      }
+    };
+
+    /**
+     * @brief An accessor expression resolved to an address and a base type.
+     * @note Pointers along the expression are followed when it is compiled,
+     * not on every read.
+     */
+    struct accessor {
+      void* ptr;
+      dwarf::base_type_info type;
+
+      /**
+       * @brief Returns a reference to the value. Does not check `T`.
+       */
+      template <typename T>
+      T& as() const {
+        return *static_cast<T*>(ptr);
+      }
+
+      /**
+       * @brief Reads the value, converted to a double.
+       */
+      double value() const {
+        switch (type.encoding) {
+          case dwarf::encoding::floating_point:
+            return (type.size == 4) ? double(as<float>()) : as<double>();
+          case dwarf::encoding::signed_int:
+          case dwarf::encoding::signed_char:
+            switch (type.size) {
+              case 1: return as<int8_t>();
+              case 2: return as<int16_t>();
+              case 4: return as<int32_t>();
+              default: return double(as<int64_t>());
+            }
+          default:
+            switch (type.size) {
+              case 1: return as<uint8_t>();
+              case 2: return as<uint16_t>();
+              case 4: return as<uint32_t>();
+              default: return double(as<uint64_t>());
+            }
+        }
+      }
+      /**
+       * @brief Writes a value, converted from a double to the field's type.
+       * Integers are truncated towards zero.
+       * @exception std::out_of_range if `v` is NaN, or the field's type
+       * can't hold it
+       */
+      void set(double v) const {
+        if (std::isnan(v)) {
+          throw std::out_of_range("Can't write NaN to a field");
+        }
+        const int bits = int(type.size * 8);
+        switch (type.encoding) {
+          case dwarf::encoding::floating_point:
+            if (type.size == 4) {
+              if (std::isfinite(v) &&
+                  std::fabs(v) > std::numeric_limits<float>::max())
+                throw std::out_of_range("Value doesn't fit in a float");
+              as<float>() = float(v);
+            }
+            else {
+              as<double>() = v;
+            }
+            break;
+          case dwarf::encoding::signed_int:
+          case dwarf::encoding::signed_char: {
+            const double t     = std::trunc(v);
+            const double limit = std::ldexp(1.0, bits - 1);
+            if (!(t >= -limit && t < limit))
+              throw std::out_of_range("Value doesn't fit in the field");
+            const int64_t i = int64_t(t);
+            switch (type.size) {
+              case 1: as<int8_t>() = int8_t(i); break;
+              case 2: as<int16_t>() = int16_t(i); break;
+              case 4: as<int32_t>() = int32_t(i); break;
+              default: as<int64_t>() = i; break;
+            }
+          } break;
+          default: {
+            const double t = std::trunc(v);
+            if (!(t >= 0 && t < std::ldexp(1.0, bits)))
+              throw std::out_of_range("Value doesn't fit in the field");
+            const uint64_t u = uint64_t(t);
+            switch (type.size) {
+              case 1: as<uint8_t>() = uint8_t(u); break;
+              case 2: as<uint16_t>() = uint16_t(u); break;
+              case 4: as<uint32_t>() = uint32_t(u); break;
+              default: as<uint64_t>() = u; break;
+            }
+          } break;
+        }
+      }
+    };
+
     class savestate final {
       friend class sm64;
 
@@ -65,8 +227,42 @@ namespace pancake {
       
       savestate(sm64 const& game);
     public:
+      savestate(savestate&&) noexcept;
+      savestate& operator=(savestate&&) noexcept;
+      ~savestate();
+
       void save();
       void load() const;
+      /**
+       * @brief Loads the savestate, only writing back blocks of memory that
+       * differ from it. Cheaper than `load()` when little has changed since
+       * the game was last at this state.
+       */
+      void load_changed() const;
+      /**
+       * @brief Returns the number of bytes held by this savestate.
+       */
+      size_t size() const;
+
+      /**
+       * @brief A block of the game's memory held by a savestate.
+       */
+      struct region {
+        /**
+         * @brief Where the block lives in the game.
+         */
+        char* live;
+        /**
+         * @brief The savestate's copy of the block.
+         */
+        const char* saved;
+        size_t size;
+      };
+      /**
+       * @brief Returns the blocks of memory held by this savestate: the
+       * game's `.data` and `.bss` sections.
+       */
+      std::array<region, 2> regions() const;
     };
     /**
      * @brief Loads libsm64.
@@ -98,6 +294,85 @@ namespace pancake {
       return *reinterpret_cast<T*>(_impl_get(expr, dwarf::get_type_info<T>()));
     }
 
+    /**
+     * @brief Returns a reference to a whole struct (or array) through a
+     * mirror type.
+     * @details `T` describes its fields with `PANCAKE_STRUCT_LAYOUT`, or is
+     * a `std::array` for an array such as `Vec3f`. On first use for an
+     * expression, each field's name, offset, size and encoding is checked
+     * against the debug info. After that, the result is a plain reference,
+     * so copying it out or assigning to it is a single `memcpy`.
+     *
+     * Assigning to the result replaces all `sizeof(T)` bytes, so the listed
+     * fields must cover every member of the game's struct that those bytes
+     * overlap; only the struct's own padding may be left out. Use
+     * `view_struct()` to read through a mirror that skips members.
+     *
+     * @tparam T a trivially copyable, standard-layout mirror type
+     * @param expr an accessor expression for a struct, union or array
+     * @return the struct, viewed as `T`
+     * @exception pancake::type_error if `T`'s layout doesn't match, or it
+     * leaves out a member
+     */
+    template <typename T>
+    [[nodiscard]] T& get_struct(const std::string& expr) {
+      static_assert(
+        std::is_trivially_copyable_v<T> && std::is_standard_layout_v<T>,
+        "T should be a plain struct");
+      return *static_cast<T*>(_impl_get_struct(
+        expr, typeid(T).name(), sizeof(T), alignof(T),
+        &struct_layout<T>::fields, true));
+    }
+
+    /**
+     * @brief Returns a read-only reference to a whole struct (or array)
+     * through a mirror type. Unlike `get_struct()`, the mirror may leave
+     * bytes unlisted, such as padding standing in for members it skips.
+     *
+     * @tparam T a trivially copyable, standard-layout mirror type
+     * @param expr an accessor expression for a struct, union or array
+     * @return the struct, viewed as `T`
+     * @exception pancake::type_error if `T`'s layout doesn't match
+     */
+    template <typename T>
+    [[nodiscard]] const T& view_struct(const std::string& expr) {
+      static_assert(
+        std::is_trivially_copyable_v<T> && std::is_standard_layout_v<T>,
+        "T should be a plain struct");
+      return *static_cast<const T*>(_impl_get_struct(
+        expr, typeid(T).name(), sizeof(T), alignof(T),
+        &struct_layout<T>::fields, false));
+    }
+
+    /**
+     * @brief Returns a view of a field across a slice of an array, such as
+     * `gObjectPool[*].oPosY` or `gMarioStates[0].pos[0:3]`.
+     * @details `[*]` selects every element and `[a:b]` elements `a` to
+     * `b - 1`; either bound of a slice may be left out. Bounds default to
+     * the array's length from the debug info. An expression can have one
+     * slice, and can't follow pointers after it.
+     *
+     * @tparam T Must be an integer or floating-point type that is not `long
+     * double`
+     * @param expr an accessor expression with a slice
+     * @return a view of the field in each selected element
+     * @exception std::invalid_argument if the expression has no slice, or
+     * follows a pointer after it
+     * @exception std::out_of_range if the slice is out of the array's bounds
+     * @exception pancake::type_error if the field does not match `T`
+     */
+    template <typename T>
+    [[nodiscard]] stx::strided_span<T> get_span(const std::string& expr) {
+      static_assert(
+        std::is_arithmetic_v<T> && !std::is_same_v<T, long double>,
+        "T should be any integer, or float or double");
+
+      stx::strided_span<char> raw =
+        _impl_get_span(expr, dwarf::get_type_info<T>());
+      return stx::strided_span<T>(
+        reinterpret_cast<T*>(raw.data()), raw.size(), raw.stride());
+    }
+
     /**
      * @brief Returns a pointer to a specific field.
      * @note This method does not do type checking. You can use
@@ -109,17 +384,168 @@ namespace pancake {
      * type
      */
     void* get_unsafe(const std::string& expr) { return _impl_get(expr); }
+
+    /**
+     * @brief Resolves an accessor expression once, for repeated reads.
+     *
+     * @param expr an accessor expression.
+     * @return the resolved accessor
+     * @exception pancake::type_error if the resulting field is not a
+     * fundamental type
+     */
+    accessor compile(const std::string& expr);
     
     template<typename T>
     decltype(auto) get_symbol(const std::string& name) {
       return lib.get_symbol<T>(name);
     }
 
+    /**
+     * @brief Returns the input sink for this game.
+     *
+     * @return the input sink
+     */
+    const input_sink& inputs() const { return *m_input; }
+
     /**
      * @brief Advances the game forward by 1 frame.
      *
      */
-    void advance();
+    void advance() { m_update(); }
+
+    /**
+     * @brief Advances the game forward by n frames without touching inputs.
+     *
+     * @param n the number of frames to advance
+     */
+    void advance(size_t n) {
+      auto update = m_update;
+      for (size_t i = 0; i < n; i++)
+        update();
+    }
+
+    /**
+     * @brief Advances the game forward by up to n frames, applying an input
+     * from a source before each one.
+     *
+     * @tparam source callable as `frame(size_t i)`, where `i` is the number of
+     * frames already run by this call
+     * @tparam callback callable as `bool(size_t done)`; returning false stops
+     * early
+     * @param n the maximum number of frames to advance
+     * @param src the input source
+     * @param cb a callback invoked after every `every` frames
+     * @param every the callback interval. 0 disables the callback.
+     * @return the number of frames actually advanced
+     */
+    template <typename source, typename callback>
+    size_t advance(size_t n, source&& src, callback&& cb, size_t every = 1) {
+      const input_sink& sink = *m_input;
+      auto update            = m_update;
+      if (every == 0) {
+        for (size_t i = 0; i < n; i++) {
+          sink.apply(src(i));
+          update();
+        }
+        return n;
+      }
+      size_t next = every;
+      for (size_t i = 0; i < n;) {
+        sink.apply(src(i));
+        update();
+        if (++i == next) {
+          next += every;
+          if (!cb(i))
+            return i;
+        }
+      }
+      return n;
+    }
+
+    /**
+     * @brief Advances the game forward by n frames, applying an input from a
+     * source before each one.
+     *
+     * @tparam source callable as `frame(size_t i)`
+     * @param n the number of frames to advance
+     * @param src the input source
+     */
+    template <typename source>
+    void advance(size_t n, source&& src) {
+      advance(n, std::forward<source>(src), [](size_t) { return true; }, 0);
+    }
+
+    /**
+     * @brief Advances until a condition holds, applying an input from a
+     * source before each frame.
+     * @details The condition is checked after every frame. If it has a
+     * `reset()` method (like the conditions in predicate.hpp), that is called
+     * once before the first frame.
+     *
+     * @tparam predicate callable as `bool()`
+     * @tparam source callable as `frame(size_t i)`
+     * @param pred the condition
+     * @param src the input source
+     * @param max_frames the maximum number of frames to advance
+     * @return the number of frames advanced when the condition held, or
+     * nothing if it didn't within `max_frames`
+     */
+    template <typename predicate, typename source>
+    std::optional<size_t> run_until(
+      predicate&& pred, source&& src, size_t max_frames) {
+      if constexpr (details::has_reset<std::remove_reference_t<predicate>>::value)
+        pred.reset();
+      bool hit = false;
+      size_t n = advance(max_frames, std::forward<source>(src), [&](size_t) {
+        hit = pred();
+        return !hit;
+      });
+      if (!hit)
+        return std::nullopt;
+      return n;
+    }
+
+    /**
+     * @brief Advances until a condition holds, holding the same input.
+     *
+     * @param pred the condition
+     * @param input the input to hold
+     * @param max_frames the maximum number of frames to advance
+     * @return the number of frames advanced when the condition held, or
+     * nothing if it didn't within `max_frames`
+     */
+    template <typename predicate>
+    std::optional<size_t> run_until(
+      predicate&& pred, const frame& input, size_t max_frames) {
+      return run_until(
+        std::forward<predicate>(pred), [&](size_t) { return input; },
+        max_frames);
+    }
+
+    /**
+     * @brief Plays a range of input frames on controller 1, advancing one
+     * frame per input.
+     *
+     * @tparam input_it an input iterator of frame
+     * @param begin the beginning iterator
+     * @param end the ending iterator
+     */
+    template <typename input_it>
+    void play(input_it begin, input_it end) {
+      const input_sink& sink = *m_input;
+      auto update            = m_update;
+      for (; begin != end; ++begin) {
+        sink.apply(*begin);
+        update();
+      }
+    }
+
+    /**
+     * @brief Plays every frame of an M64.
+     *
+     * @param movie the M64 to play
+     */
+    void play(const m64& movie) { play(movie.begin(), movie.end()); }
 
     /**
      * @brief Allocates a savestate buffer.
@@ -144,6 +570,14 @@ namespace pancake {
      * @return dl::library the library instance
      */
     dl::library& get_lib();
+    /**
+     * @brief Returns a hash of the library file's contents. Builds with the
+     * same ID behave identically, so it can key on-disk caches.
+     * @note This reads the whole file on every call.
+     *
+     * @return uint64_t the build ID
+     */
+    uint64_t build_id() const;
     /**
      * @brief Returns the debug info associated with this sm64.
      * 
@@ -0,0 +1,107 @@
+/**
+ * @file state_diff.hpp
+ * @author jgcodes2020
+ * @brief Field-level differences between savestates
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ */
+#ifndef _PANCAKE_STATE_DIFF_HPP_
+#define _PANCAKE_STATE_DIFF_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include <pancake/address_index.hpp>
+#include <pancake/dwarf/type_info.hpp>
+#include <pancake/sm64.hpp>
+
+namespace pancake {
+  /**
+   * @brief One changed field, or up to 8 changed bytes that don't belong to
+   * any field.
+   */
+  struct field_change {
+    /**
+     * @brief Index of the field's path in `state_diff::paths`.
+     */
+    uint32_t path;
+    /**
+     * @brief Which savestate region the field is in.
+     */
+    uint16_t region;
+    /**
+     * @brief The field's size in bytes, at most 8.
+     */
+    uint16_t size;
+    /**
+     * @brief The field's offset from the start of its region.
+     */
+    uint32_t offset;
+    /**
+     * @brief The field's type. Its encoding is `none` for bytes that
+     * aren't part of a known field.
+     */
+    dwarf::base_type_info type;
+    /**
+     * @brief The field's bytes in each savestate, zero-extended.
+     */
+    uint64_t before, after;
+
+    /**
+     * @brief Decodes a value as its type, converted to a double. Bytes
+     * without a type are read as an unsigned integer.
+     */
+    double decode(uint64_t bits) const;
+  };
+
+  /**
+   * @brief The fields that differ between two savestates, in address order.
+   */
+  struct state_diff {
+    /**
+     * @brief Accessor expressions for the changed fields, each listed once.
+     * Bytes outside any field are described as `path+0xN` or by address.
+     */
+    std::vector<std::string> paths;
+    std::vector<field_change> changes;
+
+    /**
+     * @brief Returns the path of a change.
+     */
+    const std::string& path_of(const field_change& change) const {
+      return paths[change.path];
+    }
+
+    /**
+     * @brief Writes the diff in a compact binary form.
+     */
+    void write(std::ostream& out) const;
+    /**
+     * @brief Reads a diff written by `write()`.
+     * @exception std::runtime_error if the data is malformed
+     */
+    static state_diff read(std::istream& in);
+  };
+
+  /**
+   * @brief Lists the fields that differ between two savestates of the same
+   * game.
+   *
+   * @param a the earlier savestate
+   * @param b the later savestate
+   * @param index an index of the game the savestates came from
+   * @return the changed fields, with values from `a` as `before` and from `b`
+   * as `after`
+   * @exception std::invalid_argument if the savestates are from different
+   * games
+   */
+  state_diff diff(
+    const sm64::savestate& a, const sm64::savestate& b,
+    const address_index& index);
+}  // namespace pancake
+#endif
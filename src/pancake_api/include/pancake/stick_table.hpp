@@ -0,0 +1,154 @@
+/**
+ * @file stick_table.hpp
+ * @author jgcodes2020
+ * @brief Equivalence classes of raw joystick inputs
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ */
+#ifndef _PANCAKE_STICK_TABLE_HPP_
+#define _PANCAKE_STICK_TABLE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <utility>
+#include <vector>
+
+#include <pancake/sm64.hpp>
+
+namespace pancake {
+  /**
+   * @brief Groups the 65536 raw stick positions by their effect on Mario.
+   * @details Each raw position is run through libsm64's own
+   * `adjust_analog_stick()`, which applies the deadzone and clamps the
+   * magnitude, and the intended yaw is computed with its `atan2s()`, exactly
+   * as Mario does. Positions with the same intended yaw and magnitude form a
+   * class. Inside the deadzone, the yaw is ignored.
+   *
+   * @note A few actions (e.g. swimming and flying) read the adjusted stick
+   * axes directly. Two positions in the same class can differ there, so only
+   * rely on the classes where Mario uses the intended yaw and magnitude.
+   */
+  class stick_table final {
+  public:
+    /**
+     * @brief A raw stick position, as in `frame`.
+     */
+    struct stick {
+      int8_t x;
+      int8_t y;
+    };
+
+    /**
+     * @brief The effect of a stick position.
+     */
+    struct effect {
+      /**
+       * @brief The intended yaw, before the camera's yaw is added. 0 if
+       * `mag` is 0.
+       */
+      int16_t yaw;
+      /**
+       * @brief The adjusted stick magnitude, from 0 to 64.
+       */
+      float mag;
+
+      bool operator==(const effect& rhs) const {
+        return yaw == rhs.yaw && mag == rhs.mag;
+      }
+      bool operator!=(const effect& rhs) const { return !(*this == rhs); }
+    };
+
+  private:
+    std::vector<effect> m_effects;
+    // raw index -> class
+    std::vector<uint32_t> m_class;
+    // class members, sorted by class; the first of each is its representative
+    std::vector<uint16_t> m_members;
+    std::vector<uint32_t> m_offsets;
+
+    explicit stick_table(std::vector<effect> effects);
+
+    static uint16_t index(int8_t x, int8_t y) {
+      return uint16_t(uint8_t(x) | (uint8_t(y) << 8));
+    }
+    static stick unindex(uint16_t i) {
+      return stick {int8_t(uint8_t(i)), int8_t(uint8_t(i >> 8))};
+    }
+
+  public:
+    /**
+     * @brief Builds the table by running libsm64's stick processing on every
+     * raw position. Controller 1's state is restored afterwards.
+     *
+     * @param game the game to use
+     * @exception dl::dl_error if libsm64 does not export
+     * `adjust_analog_stick` or `atan2s`
+     */
+    explicit stick_table(sm64& game);
+
+    /**
+     * @brief Loads the table for this build of libsm64 from `cache_dir`,
+     * building and saving it there if it isn't cached yet.
+     *
+     * @param game the game to use
+     * @param cache_dir the cache directory; created if it doesn't exist
+     * @return the table
+     */
+    static stick_table cached(
+      sm64& game, const std::filesystem::path& cache_dir);
+
+    /**
+     * @brief Returns the number of classes.
+     */
+    size_t size() const { return m_offsets.size() - 1; }
+
+    /**
+     * @brief Returns the class of a raw stick position.
+     */
+    size_t class_of(int8_t x, int8_t y) const { return m_class[index(x, y)]; }
+
+    /**
+     * @brief Returns the effect of a raw stick position.
+     */
+    const effect& effect_of(int8_t x, int8_t y) const {
+      return m_effects[index(x, y)];
+    }
+
+    /**
+     * @brief Returns the representative of a class: the member closest to
+     * the centre, ties going to the lowest `x`, then `y`.
+     */
+    stick representative(size_t cls) const {
+      return unindex(m_members[m_offsets[cls]]);
+    }
+
+    /**
+     * @brief Maps a raw stick position to its class's representative.
+     */
+    stick canonical(int8_t x, int8_t y) const {
+      return representative(class_of(x, y));
+    }
+
+    /**
+     * @brief Returns every member of a class.
+     */
+    std::vector<stick> members(size_t cls) const;
+
+    /**
+     * @brief Returns one representative per class, in class order. Searching
+     * over these instead of all 65536 positions covers every distinct
+     * intended yaw and magnitude.
+     */
+    std::vector<stick> representatives() const;
+
+    /**
+     * @brief Returns every raw stick position with the given effect, or
+     * nothing if none has it.
+     */
+    std::vector<stick> find(const effect& e) const;
+  };
+}  // namespace pancake
+#endif
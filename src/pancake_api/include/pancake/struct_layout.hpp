@@ -0,0 +1,115 @@
+/**
+ * @file struct_layout.hpp
+ * @author jgcodes2020
+ * @brief Field descriptions for mirror structs used with sm64::get_struct()
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ */
+#ifndef _PANCAKE_STRUCT_LAYOUT_HPP_
+#define _PANCAKE_STRUCT_LAYOUT_HPP_
+
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+#include <pancake/dwarf/enums.hpp>
+#include <pancake/dwarf/type_info.hpp>
+
+namespace pancake {
+  /**
+   * @brief Describes one field of a mirror struct.
+   */
+  struct struct_field {
+    /**
+     * @brief The name of the matching member in the game's struct. Empty
+     * when the mirror is a whole array (see `struct_layout<std::array>`).
+     */
+    const char* name;
+    /**
+     * @brief The field's offset within the mirror.
+     */
+    size_t offset;
+    /**
+     * @brief The field's type, or its element type if it's an array.
+     * Pointers have the `address` encoding.
+     */
+    dwarf::base_type_info type;
+    /**
+     * @brief The number of elements, with all array dimensions multiplied
+     * together.
+     */
+    size_t count;
+
+    /**
+     * @brief Describes a field from its member pointer.
+     */
+    template <typename S, typename M>
+    static struct_field of(const char* name, size_t offset, M S::*) {
+      using elem = std::remove_all_extents_t<M>;
+      static_assert(
+        std::is_arithmetic_v<elem> || std::is_pointer_v<elem>,
+        "Mirror fields should be numbers, pointers, or arrays of them");
+      dwarf::base_type_info type;
+      if constexpr (std::is_pointer_v<elem>)
+        type = dwarf::base_type_info {dwarf::encoding::address, sizeof(elem)};
+      else
+        type = dwarf::get_type_info<elem>();
+      return struct_field {name, offset, type, sizeof(M) / sizeof(elem)};
+    }
+  };
+
+  /**
+   * @brief Describes a mirror struct's fields. Specialise it with
+   * `PANCAKE_STRUCT_LAYOUT` rather than by hand.
+   */
+  template <typename T>
+  struct struct_layout;
+
+  /**
+   * @brief `std::array`s mirror arrays of the game, such as `Vec3f`.
+   */
+  template <typename E, size_t N>
+  struct struct_layout<std::array<E, N>> {
+    static std::vector<struct_field> fields() {
+      static_assert(std::is_arithmetic_v<E>, "Elements should be numbers");
+      return {struct_field {"", 0, dwarf::get_type_info<E>(), N}};
+    }
+  };
+}  // namespace pancake
+
+/**
+ * @brief Describes a mirror struct's fields for `sm64::get_struct()`. Use it
+ * at global scope, after the struct:
+ * @code{.cpp}
+ * struct mario_pos {
+ *   uint32_t action;
+ *   float pos[3];
+ * };
+ * PANCAKE_STRUCT_LAYOUT(mario_pos,
+ *   PANCAKE_FIELD(action),
+ *   PANCAKE_FIELD(pos))
+ * @endcode
+ * Each field must have the same name, offset and type as a member of the
+ * game's struct. Writing through a mirror replaces all of its bytes, so
+ * `sm64::get_struct()` needs the fields to cover the whole mirror. A mirror
+ * that skips members (with padding in their place) can only be read, with
+ * `sm64::view_struct()`.
+ */
+#define PANCAKE_STRUCT_LAYOUT(type, ...)                       \
+  template <>                                                  \
+  struct pancake::struct_layout<type> {                        \
+    using self = type;                                         \
+    static std::vector<pancake::struct_field> fields() {       \
+      return {__VA_ARGS__};                                    \
+    }                                                          \
+  };
+
+/**
+ * @brief Describes one field inside `PANCAKE_STRUCT_LAYOUT`.
+ */
+#define PANCAKE_FIELD(name) \
+  pancake::struct_field::of(#name, offsetof(self, name), &self::name)
+#endif
@@ -0,0 +1,195 @@
+/**
+ * @file sweep.hpp
+ * @author jgcodes2020
+ * @brief Exhaustive stick and parameter sweeps from a savestate
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ */
+#ifndef _PANCAKE_SWEEP_HPP_
+#define _PANCAKE_SWEEP_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <pancake/movie.hpp>
+#include <pancake/patch.hpp>
+#include <pancake/pool.hpp>
+#include <pancake/stick_table.hpp>
+
+namespace pancake {
+  /**
+   * @brief The result of a stick sweep: one column of 256×256 values per
+   * watched expression.
+   * @details Values are stored row by row, `y` from -128 to 127, and within
+   * each row `x` from -128 to 127.
+   */
+  struct stick_sweep {
+    /**
+     * @brief The number of stick positions per axis.
+     */
+    static constexpr size_t width = 256;
+
+    /**
+     * @brief The watched expressions, one per column.
+     */
+    std::vector<std::string> watch;
+    /**
+     * @brief `columns[i]` holds the values of `watch[i]` for every stick
+     * position.
+     */
+    std::vector<std::vector<double>> columns;
+
+    /**
+     * @brief Returns the position of a stick value within a column.
+     */
+    static size_t index(int8_t x, int8_t y) {
+      return (size_t(uint8_t(y) ^ 0x80) * width) | (uint8_t(x) ^ 0x80);
+    }
+
+    /**
+     * @brief Returns the value of column `col` for a stick position.
+     */
+    double at(size_t col, int8_t x, int8_t y) const {
+      return columns[col][index(x, y)];
+    }
+
+    /**
+     * @brief Writes the sweep to a file, in the same format as the streaming
+     * `sweep_stick()`.
+     *
+     * @param path the file to write
+     */
+    void dump(const std::filesystem::path& path) const;
+  };
+
+  /**
+   * @brief Tries every stick position from a state and records the watched
+   * expressions afterwards.
+   * @details For each position, every instance restores `state` (only
+   * writing back memory the last candidate changed), holds the stick with
+   * `buttons` for `frames` frames, and reads the watch list. Positions are
+   * spread across the pool with work stealing.
+   *
+   * @param pool the pool to run on
+   * @param state the starting state, saved on every instance
+   * @param buttons the buttons held on every frame
+   * @param frames the number of frames to hold the input for
+   * @param watch accessor expressions to record
+   * @param classes if not null, only one representative of each class is
+   * simulated and its results are copied to the rest of the class
+   * @return the results
+   * @exception pancake::type_error if a watched expression isn't a
+   * fundamental type
+   */
+  stick_sweep sweep_stick(
+    sm64_pool& pool, const sm64_pool::savestate& state, frame::button buttons,
+    size_t frames, const std::vector<std::string>& watch,
+    const stick_table* classes = nullptr);
+
+  /**
+   * @brief Like `sweep_stick()`, but streams each row to a file as soon as it
+   * is done rather than keeping the grid in memory.
+   * @details The file starts with the magic `PCSWEEP\x01`, then the number
+   * of columns and each expression (a u32 length and its bytes), all
+   * little-endian. Then come 256 row blocks, `y` from -128 to 127; each holds
+   * 256 native-endian doubles per column, column by column.
+   *
+   * @param output the file to write
+   */
+  void sweep_stick(
+    sm64_pool& pool, const sm64_pool::savestate& state, frame::button buttons,
+    size_t frames, const std::vector<std::string>& watch,
+    const std::filesystem::path& output);
+
+  /**
+   * @brief One axis of a parameter grid: a field and the values to try.
+   */
+  struct grid_axis {
+    /**
+     * @brief An accessor expression for the field.
+     */
+    std::string field;
+    std::vector<double> values;
+
+    /**
+     * @brief Makes an axis of `count` evenly spaced values from `lo` to `hi`
+     * inclusive.
+     */
+    static grid_axis linspace(
+      std::string field, double lo, double hi, size_t count);
+  };
+
+  /**
+   * @brief The result of a grid sweep: one dense array per watched
+   * expression, in row-major order (the last axis varies fastest).
+   */
+  struct grid_sweep {
+    /**
+     * @brief The number of values on each axis.
+     */
+    std::vector<size_t> shape;
+    /**
+     * @brief The watched expressions, one per column.
+     */
+    std::vector<std::string> watch;
+    /**
+     * @brief `columns[i]` holds the values of `watch[i]` for every grid
+     * point.
+     */
+    std::vector<std::vector<double>> columns;
+
+    /**
+     * @brief Returns the number of grid points.
+     */
+    size_t size() const;
+
+    /**
+     * @brief Returns the position of a grid point within a column.
+     *
+     * @param coords one index per axis
+     */
+    size_t index(const std::vector<size_t>& coords) const;
+
+    /**
+     * @brief Writes the sweep to a file. The file starts with the magic
+     * `PCGRID\0\x01`, then the number of axes and each axis' size, then
+     * the number of columns and each expression (a u32 length and its
+     * bytes), all as little-endian u32s. Then come the columns, one after
+     * another, as native-endian doubles.
+     *
+     * @param path the file to write
+     */
+    void dump(const std::filesystem::path& path) const;
+  };
+
+  /**
+   * @brief Tries every point of a parameter grid from a state and records
+   * the watched expressions afterwards.
+   * @details For each point, an instance restores `state` (only writing back
+   * memory the last point changed), writes the point's values through a
+   * `write_patch`, advances `frames` frames holding `input`, and reads the
+   * watch list. Points are spread across the pool with work stealing.
+   *
+   * @param pool the pool to run on
+   * @param state the starting state, saved on every instance
+   * @param axes the grid axes
+   * @param frames the number of frames to advance
+   * @param watch accessor expressions to record
+   * @param input the input held while advancing
+   * @return the results
+   * @exception std::invalid_argument if there are no axes or an axis has no
+   * values
+   * @exception pancake::type_error if a field or watched expression isn't a
+   * fundamental type
+   */
+  grid_sweep sweep_grid(
+    sm64_pool& pool, const sm64_pool::savestate& state,
+    const std::vector<grid_axis>& axes, size_t frames,
+    const std::vector<std::string>& watch, const frame& input = frame {});
+}  // namespace pancake
+#endif
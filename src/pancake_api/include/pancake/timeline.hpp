@@ -0,0 +1,130 @@
+/**
+ * @file timeline.hpp
+ * @author jgcodes2020
+ * @brief Checkpointed movie playback (a.k.a. "greenzone")
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ */
+#ifndef _PANCAKE_TIMELINE_HPP_
+#define _PANCAKE_TIMELINE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include <pancake/movie.hpp>
+#include <pancake/sm64.hpp>
+
+namespace pancake {
+  /**
+   * @brief Pairs an M64 with an sm64, keeping savestates along the movie so
+   * that any frame can be reached quickly.
+   * @details The checkpoint at frame `n` holds the game state after `n` inputs
+   * have been played, i.e. right before input `n` is applied. Checkpoints are
+   * taken every `interval` frames while replaying; once their total size goes
+   * over the memory budget, the ones far from the current position are thinned
+   * out first, so spacing grows with distance.
+   *
+   * The timeline assumes it is the only thing driving the game. If the game is
+   * advanced or loaded from elsewhere, call `detach()`, then `seek()` before
+   * relying on its state again.
+   */
+  class timeline final {
+  private:
+    sm64& m_game;
+    m64& m_movie;
+    size_t m_budget;
+    uint32_t m_interval;
+
+    std::map<uint32_t, sm64::savestate> m_states;
+    std::vector<sm64::savestate> m_spare;
+    size_t m_memory;
+
+    uint32_t m_pos;
+    bool m_synced;
+
+    void checkpoint(uint32_t frame);
+    void evict(uint32_t keep);
+
+  public:
+    /**
+     * @brief Creates a timeline. The game's current state is taken as the
+     * state before the movie's first frame.
+     *
+     * @param game the game to drive
+     * @param movie the movie to play
+     * @param budget the maximum number of bytes to spend on checkpoints. The
+     * checkpoint at frame 0 is always kept.
+     * @param interval the spacing of checkpoints near the current position
+     */
+    timeline(sm64& game, m64& movie, size_t budget, uint32_t interval = 60);
+
+    /**
+     * @brief Brings the game to the state after `frame` inputs, restoring the
+     * nearest earlier checkpoint and replaying from there.
+     *
+     * @param frame the frame to seek to, up to `movie().size()`
+     * @exception std::out_of_range if `frame` is past the end of the movie
+     */
+    void seek(uint32_t frame);
+
+    /**
+     * @brief Replaces the input at `index`. Only checkpoints after `index` are
+     * invalidated; nothing is re-simulated until the next `seek()`.
+     *
+     * @param index the index of the input to replace
+     * @param value the new input
+     */
+    void set(uint32_t index, const frame& value);
+
+    /**
+     * @brief Appends an input to the end of the movie.
+     *
+     * @param value the input to append
+     */
+    void push_back(const frame& value);
+
+    /**
+     * @brief Marks the inputs from `index` onwards as changed. Use this after
+     * editing the movie directly.
+     *
+     * @param index the first changed input
+     */
+    void invalidate(uint32_t index);
+
+    /**
+     * @brief Marks the game's state as unknown, e.g. after it was advanced or
+     * loaded from elsewhere. The next `seek()` restores a checkpoint.
+     */
+    void detach() { m_synced = false; }
+
+    /**
+     * @brief Returns the frame the game is currently at.
+     */
+    uint32_t position() const { return m_pos; }
+
+    /**
+     * @brief Returns the game being driven.
+     */
+    sm64& game() const { return m_game; }
+
+    /**
+     * @brief Returns the movie being played.
+     */
+    const m64& movie() const { return m_movie; }
+
+    /**
+     * @brief Returns the number of checkpoints held.
+     */
+    size_t checkpoints() const { return m_states.size(); }
+
+    /**
+     * @brief Returns the number of bytes held by checkpoints.
+     */
+    size_t memory() const { return m_memory; }
+  };
+}  // namespace pancake
+#endif
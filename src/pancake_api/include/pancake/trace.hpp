@@ -0,0 +1,180 @@
+/**
+ * @file trace.hpp
+ * @author jgcodes2020
+ * @brief Columnar per-frame traces of field values
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ */
+#ifndef _PANCAKE_TRACE_HPP_
+#define _PANCAKE_TRACE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <pancake/dwarf/type_info.hpp>
+#include <pancake/sm64.hpp>
+
+namespace pancake {
+  /**
+   * @brief How a column chunk's values are stored.
+   */
+  enum class trace_encoding : uint8_t {
+    /**
+     * @brief Each value in its own type, little-endian.
+     */
+    plain = 0,
+    /**
+     * @brief A 64-bit base, then each value minus the base, bit-packed.
+     */
+    bitpack = 1,
+    /**
+     * @brief The first value, then the zigzagged difference from each value
+     * to the next, bit-packed.
+     */
+    delta = 2,
+    /**
+     * @brief The first value's bits, then each value's bits XORed with the
+     * previous value's, bit-packed. Suits slowly changing floats.
+     */
+    xor_bits = 3
+  };
+
+  /**
+   * @brief A column of a trace: an accessor expression and its type.
+   */
+  struct trace_column {
+    std::string name;
+    dwarf::base_type_info type;
+  };
+
+  /**
+   * @brief Where one column of one chunk is stored, and what it holds.
+   */
+  struct trace_column_chunk {
+    uint64_t offset;
+    uint64_t length;
+    trace_encoding encoding;
+    /**
+     * @brief The number of bits per packed value.
+     */
+    uint8_t width;
+    /**
+     * @brief The smallest and largest values in the chunk, ignoring NaNs.
+     */
+    double min, max;
+  };
+
+  /**
+   * @brief A run of rows stored together, like a Parquet row group.
+   */
+  struct trace_chunk {
+    uint64_t first_row;
+    uint32_t rows;
+    std::vector<trace_column_chunk> columns;
+  };
+
+  /**
+   * @brief Records fields every frame into a columnar trace file.
+   * @details Rows are buffered per column and written a chunk at a time.
+   * Each column chunk is stored with whichever encoding is smallest, along
+   * with its minimum and maximum so readers can skip it. The file is laid
+   * out like Parquet: the chunks, then a footer with the schema and every
+   * chunk's location and statistics, then the footer's length and the magic
+   * bytes `PKTR`. Decoded columns are plain little-endian arrays, the same
+   * layout as Arrow's primitive arrays.
+   */
+  class trace_writer final {
+  private:
+    std::ofstream m_out;
+    std::vector<sm64::accessor> m_fields;
+    std::vector<trace_column> m_columns;
+    // each row's values, as canonical 64-bit words
+    std::vector<std::vector<uint64_t>> m_buffers;
+    std::vector<trace_chunk> m_chunks;
+    size_t m_chunk_rows;
+    uint64_t m_rows;
+    bool m_closed;
+
+    void flush();
+
+  public:
+    /**
+     * @brief Creates a trace file.
+     *
+     * @param game the game to record from
+     * @param fields accessor expressions for each column
+     * @param path the file to write
+     * @param chunk_rows the number of rows per chunk
+     * @exception std::invalid_argument if there are no fields
+     * @exception pancake::type_error if a field isn't a fundamental type
+     * @exception std::runtime_error if the file can't be created
+     */
+    trace_writer(
+      sm64& game, const std::vector<std::string>& fields,
+      const std::filesystem::path& path, size_t chunk_rows = 65536);
+
+    trace_writer(const trace_writer&)            = delete;
+    trace_writer& operator=(const trace_writer&) = delete;
+
+    /**
+     * @brief Closes the trace if `close()` wasn't called.
+     */
+    ~trace_writer();
+
+    /**
+     * @brief Appends the fields' current values as a row.
+     */
+    void record() {
+      for (size_t i = 0; i < m_fields.size(); i++) {
+        const sm64::accessor& field = m_fields[i];
+        uint64_t word               = 0;
+        switch (field.type.encoding) {
+          case dwarf::encoding::signed_int:
+          case dwarf::encoding::signed_char:
+            switch (field.type.size) {
+              case 1: word = uint64_t(int64_t(field.as<int8_t>())); break;
+              case 2: word = uint64_t(int64_t(field.as<int16_t>())); break;
+              case 4: word = uint64_t(int64_t(field.as<int32_t>())); break;
+              default: word = uint64_t(field.as<int64_t>()); break;
+            }
+            break;
+          default:
+            // unsigned integers and floats keep their bits
+            switch (field.type.size) {
+              case 1: word = field.as<uint8_t>(); break;
+              case 2: word = field.as<uint16_t>(); break;
+              case 4: word = field.as<uint32_t>(); break;
+              default: word = field.as<uint64_t>(); break;
+            }
+            break;
+        }
+        m_buffers[i].push_back(word);
+      }
+      if (m_buffers[0].size() >= m_chunk_rows)
+        flush();
+    }
+
+    /**
+     * @brief Returns the number of rows recorded.
+     */
+    uint64_t rows() const { return m_rows + m_buffers[0].size(); }
+
+    /**
+     * @brief Returns the columns.
+     */
+    const std::vector<trace_column>& columns() const { return m_columns; }
+
+    /**
+     * @brief Writes the last chunk and the footer, and closes the file.
+     * @exception std::runtime_error if writing fails
+     */
+    void close();
+  };
+}  // namespace pancake
+#endif
@@ -0,0 +1,153 @@
+/**
+ * @file trace_query.hpp
+ * @author jgcodes2020
+ * @brief Reading and querying traces written by trace_writer
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2021
+ */
+#ifndef _PANCAKE_TRACE_QUERY_HPP_
+#define _PANCAKE_TRACE_QUERY_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <pancake/trace.hpp>
+
+namespace pancake {
+  /**
+   * @brief Reads a trace file one column chunk at a time.
+   */
+  class trace_reader final {
+  private:
+    std::ifstream m_in;
+    std::vector<trace_column> m_columns;
+    std::vector<trace_chunk> m_chunks;
+    uint64_t m_rows;
+    std::vector<char> m_scratch;
+
+  public:
+    /**
+     * @brief Opens a trace and reads its footer.
+     * @exception std::runtime_error if the file can't be read or isn't a
+     * trace
+     */
+    explicit trace_reader(const std::filesystem::path& path);
+
+    /**
+     * @brief Returns the columns, in the order they were recorded.
+     */
+    const std::vector<trace_column>& columns() const { return m_columns; }
+    /**
+     * @brief Returns every chunk's location and statistics.
+     */
+    const std::vector<trace_chunk>& chunks() const { return m_chunks; }
+    /**
+     * @brief Returns the total number of rows.
+     */
+    uint64_t rows() const { return m_rows; }
+
+    /**
+     * @brief Returns the index of a column.
+     * @exception std::out_of_range if there's no column with that name
+     */
+    size_t column_index(const std::string& name) const;
+
+    /**
+     * @brief Decodes one column of one chunk as 64-bit words: signed
+     * integers sign-extended, unsigned integers zero-extended, and floats
+     * as their bits.
+     */
+    void read_words(size_t chunk, size_t column, std::vector<uint64_t>& out);
+    /**
+     * @brief Decodes one column of one chunk, converted to doubles.
+     */
+    void read_values(size_t chunk, size_t column, std::vector<double>& out);
+  };
+
+  /**
+   * @brief A comparison in a `trace_query`.
+   */
+  enum class trace_op : uint8_t { lt, le, gt, ge, eq, ne };
+
+  /**
+   * @brief Finds the rows of a trace that pass every one of a set of
+   * comparisons.
+   * @details Each chunk is first checked against its statistics: chunks no
+   * row of which can pass are skipped without being read, and comparisons
+   * every row passes aren't evaluated. The rest are decoded and compared 64
+   * rows at a time into a row bitmap, in loops the compiler can vectorise.
+   * Only the selected columns of chunks with matches are decoded for output.
+   */
+  class trace_query final {
+  public:
+    /**
+     * @brief Receives a matching row and the values of the selected
+     * columns, in order.
+     */
+    using row_fn = std::function<void(uint64_t row, const double* values)>;
+
+  private:
+    struct condition {
+      size_t column;
+      trace_op op;
+      double value;
+    };
+
+    trace_reader& m_reader;
+    std::vector<condition> m_where;
+    std::vector<size_t> m_select;
+    std::vector<double> m_values;
+
+  public:
+    /**
+     * @brief Starts a query that matches every row and selects no columns.
+     */
+    explicit trace_query(trace_reader& reader) : m_reader(reader) {}
+
+    /**
+     * @brief Adds a comparison that rows must pass, `column op value`.
+     * Values are compared as doubles.
+     * @exception std::out_of_range if there's no column with that name
+     */
+    trace_query& where(const std::string& column, trace_op op, double value);
+
+    /**
+     * @brief Sets the columns passed to `for_each()`.
+     * @exception std::out_of_range if there's no column with one of the names
+     */
+    trace_query& select(const std::vector<std::string>& columns);
+
+    /**
+     * @brief Computes the matching rows of a chunk.
+     *
+     * @param chunk the chunk's index
+     * @param bits receives one bit per row of the chunk, set if the row
+     * matches, least significant first
+     * @return false if no row of the chunk matches
+     */
+    bool match(size_t chunk, std::vector<uint64_t>& bits);
+
+    /**
+     * @brief Calls `fn` for every matching row, in order.
+     */
+    void for_each(const row_fn& fn);
+
+    /**
+     * @brief Counts the matching rows.
+     */
+    uint64_t count();
+
+    /**
+     * @brief Lists the matching rows.
+     */
+    std::vector<uint64_t> rows();
+  };
+}  // namespace pancake
+#endif
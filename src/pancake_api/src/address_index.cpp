@@ -0,0 +1,281 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#include <pancake/address_index.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <pancake/dwarf/layout.hpp>
+
+using std::string;
+
+namespace pancake {
+  struct address_index::builder {
+    address_index& self;
+    std::unordered_map<Dwarf_Off, uint32_t> done;
+
+    uint32_t add(type_node&& node) {
+      self.m_types.push_back(std::move(node));
+      return uint32_t(self.m_types.size() - 1);
+    }
+
+    uint32_t scalar(dwarf::die type) {
+      dwarf::die_tag tag;
+      dwarf::base_type_info info = dwarf::flatten_type(type, tag).first;
+      uint32_t pointee           = npos;
+      if (
+        tag == dwarf::die_tag::pointer_type &&
+        type.has_attr(dwarf::dw_attrs::type)) {
+        pointee = build(type.get_attr<dwarf::die>(dwarf::dw_attrs::type));
+      }
+      return add(type_node {
+        type_node::scalar, false, info.size, info, 0, npos, {}, pointee});
+    }
+
+    // Builds the layout of an array, one node per dimension.
+    uint32_t array(dwarf::die type) {
+      std::vector<size_t> dims;
+      for (auto sub = type.child(); sub; sub = sub->sibling()) {
+        if (sub->tag() != dwarf::die_tag::subrange_type)
+          continue;
+        if (sub->has_attr(dwarf::dw_attrs::upper_bound)) {
+          dims.push_back(
+            size_t(sub->get_attr<Dwarf_Unsigned>(dwarf::dw_attrs::upper_bound)) +
+            1);
+        }
+        else if (sub->has_attr(dwarf::dw_attrs::count)) {
+          dims.push_back(
+            size_t(sub->get_attr<Dwarf_Unsigned>(dwarf::dw_attrs::count)));
+        }
+        else {
+          dims.push_back(0);
+        }
+      }
+      uint32_t elem = build(type.get_attr<dwarf::die>(dwarf::dw_attrs::type));
+      for (auto it = dims.rbegin(); it != dims.rend(); it++) {
+        size_t size = self.m_types[elem].size * *it;
+        elem        = add(type_node {
+          type_node::array, false, size, {dwarf::encoding::none, 0}, *it,
+          elem, {}, npos});
+      }
+      return elem;
+    }
+
+    // Records are added before their members, so that pointers back to
+    // them can find them.
+    uint32_t record(dwarf::die type, Dwarf_Off id) {
+      dwarf::record_layout layout = dwarf::read_record(type);
+      uint32_t res                = add(type_node {
+        type_node::record, layout.is_union, layout.size,
+        {dwarf::encoding::none, 0}, 0, npos, {}, npos});
+      done.emplace(id, res);
+
+      std::vector<member> members;
+      members.reserve(layout.members.size());
+      for (auto& m : layout.members) {
+        uint32_t node;
+        if (
+          m.type.encoding == dwarf::encoding::none &&
+          m.tag == dwarf::die_tag::base_type) {
+          // bitfields are left as opaque bytes
+          node = add(type_node {
+            type_node::scalar, false, m.type.size, m.type, 0, npos, {}, npos});
+        }
+        else {
+          node = build(*m.type_die);
+        }
+        members.push_back(
+          member {m.name, m.offset, self.m_types[node].size, node});
+      }
+      std::stable_sort(
+        members.begin(), members.end(),
+        [](const member& a, const member& b) { return a.offset < b.offset; });
+      self.m_types[res].members = std::move(members);
+      return res;
+    }
+
+    uint32_t build(dwarf::die type) {
+      type         = dwarf::strip_typedefs(type);
+      Dwarf_Off id = type.offset();
+      if (auto it = done.find(id); it != done.end())
+        return it->second;
+
+      uint32_t res;
+      switch (type.tag()) {
+        case dwarf::die_tag::array_type: res = array(type); break;
+        case dwarf::die_tag::structure_type:
+        case dwarf::die_tag::union_type:
+          // declarations of incomplete types have no size
+          if (type.has_attr(dwarf::dw_attrs::byte_size))
+            return record(type, id);
+          [[fallthrough]];
+        default: res = scalar(type); break;
+      }
+      done.emplace(id, res);
+      return res;
+    }
+  };
+
+  address_index::address_index(const dl::library& lib, dwarf::debug& dbg) {
+    builder build {*this, {}};
+    auto globals = dbg.globals();
+
+    for (size_t i = 0; i < globals.count(); i++) {
+      dwarf::global global = globals[i];
+      dwarf::die die       = global.die();
+      dwarf::die_tag tag   = die.tag();
+      if (tag != dwarf::die_tag::variable && tag != dwarf::die_tag::subprogram)
+        continue;
+
+      symbol sym {global.name(), 0, 0, tag == dwarf::die_tag::subprogram, npos};
+      try {
+        sym.begin = reinterpret_cast<uintptr_t>(lib.get_symbol(sym.name));
+      }
+      catch (const dl::dl_error&) {
+        // not exported, so it can't be found
+        continue;
+      }
+
+      if (sym.is_function) {
+        // DWARF 4 and up store high_pc as a length
+        try {
+          if (die.has_attr(dwarf::dw_attrs::high_pc)) {
+            sym.size =
+              size_t(die.get_attr<Dwarf_Unsigned>(dwarf::dw_attrs::high_pc));
+          }
+        }
+        catch (const std::invalid_argument&) {}
+      }
+      else {
+        dwarf::die decl = die;
+        if (decl.has_attr(dwarf::dw_attrs::specification))
+          decl = decl.get_attr<dwarf::die>(dwarf::dw_attrs::specification);
+        if (!decl.has_attr(dwarf::dw_attrs::type))
+          continue;
+        sym.type = build.build(decl.get_attr<dwarf::die>(dwarf::dw_attrs::type));
+        sym.size = m_types[sym.type].size;
+      }
+      m_symbols.push_back(std::move(sym));
+    }
+
+    std::sort(
+      m_symbols.begin(), m_symbols.end(),
+      [](const symbol& a, const symbol& b) {
+        return a.begin < b.begin || (a.begin == b.begin && a.size > b.size);
+      });
+    // aliases share an address; keep the largest
+    m_symbols.erase(
+      std::unique(
+        m_symbols.begin(), m_symbols.end(),
+        [](const symbol& a, const symbol& b) { return a.begin == b.begin; }),
+      m_symbols.end());
+    for (size_t i = 0; i + 1 < m_symbols.size(); i++) {
+      symbol& sym = m_symbols[i];
+      if (sym.is_function && sym.size == 0)
+        sym.size = m_symbols[i + 1].begin - sym.begin;
+    }
+  }
+
+  const address_index::symbol* address_index::find(const void* addr) const {
+    uintptr_t at = reinterpret_cast<uintptr_t>(addr);
+    auto it      = std::upper_bound(
+      m_symbols.begin(), m_symbols.end(), at,
+      [](uintptr_t a, const symbol& sym) { return a < sym.begin; });
+    if (it == m_symbols.begin())
+      return nullptr;
+    --it;
+    if (at - it->begin >= it->size)
+      return nullptr;
+    return &*it;
+  }
+
+  void address_index::descend(
+    uint32_t node, size_t& offset, string& path,
+    dwarf::base_type_info& type) const {
+    while (node != npos) {
+      const type_node& t = m_types[node];
+      if (t.kind == type_node::scalar) {
+        type = t.base;
+        return;
+      }
+      if (t.kind == type_node::array) {
+        size_t elem_size = m_types[t.elem].size;
+        if (elem_size == 0)
+          return;
+        size_t i = offset / elem_size;
+        if (i >= t.count)
+          return;
+        path += '[' + std::to_string(i) + ']';
+        offset -= i * elem_size;
+        node = t.elem;
+        continue;
+      }
+
+      // records: unions take the first member that fits, structs the last
+      // member starting at or before the offset
+      const member* found = nullptr;
+      if (t.is_union) {
+        for (auto& m : t.members) {
+          if (offset < m.size) {
+            found = &m;
+            break;
+          }
+        }
+      }
+      else {
+        auto it = std::upper_bound(
+          t.members.begin(), t.members.end(), offset,
+          [](size_t off, const member& m) { return off < m.offset; });
+        if (it != t.members.begin()) {
+          const member& m = *(it - 1);
+          if (offset - m.offset < m.size)
+            found = &m;
+        }
+      }
+      if (!found)
+        return;
+      // members of anonymous structs and unions are named directly
+      if (!found->name.empty())
+        path += '.' + found->name;
+      offset -= found->offset;
+      node = found->type;
+    }
+  }
+
+  std::optional<address_index::location> address_index::lookup(
+    const void* addr) const {
+    const symbol* sym = find(addr);
+    if (!sym)
+      return std::nullopt;
+
+    location res {
+      sym, sym->name, reinterpret_cast<uintptr_t>(addr) - sym->begin,
+      {dwarf::encoding::none, 0}};
+    descend(sym->type, res.offset, res.path, res.type);
+    return res;
+  }
+
+  string address_index::describe(const void* addr) const {
+    std::ostringstream out;
+    out << std::hex;
+    if (auto loc = lookup(addr)) {
+      out << loc->path;
+      if (loc->offset != 0)
+        out << "+0x" << loc->offset;
+    }
+    else {
+      out << "0x" << reinterpret_cast<uintptr_t>(addr);
+    }
+    return out.str();
+  }
+}  // namespace pancake
@@ -0,0 +1,52 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#include "atomic_write.hpp"
+
+#if defined(_WIN32)
+  #include <io.h>
+#else
+  #include <unistd.h>
+#endif
+
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace pancake {
+  void atomic_write(
+    const fs::path& path, const std::vector<char>& bytes, bool sync) {
+    fs::path tmp = path;
+    tmp += ".tmp";
+
+    std::FILE* out = std::fopen(tmp.string().c_str(), "wb");
+    if (out == nullptr) {
+      throw std::runtime_error("Failed to open " + tmp.string());
+    }
+    bool ok = std::fwrite(bytes.data(), 1, bytes.size(), out) == bytes.size() &&
+      std::fflush(out) == 0;
+    if (ok && sync) {
+  #if defined(_WIN32)
+      ok = _commit(_fileno(out)) == 0;
+  #else
+      ok = fsync(fileno(out)) == 0;
+  #endif
+    }
+    ok = (std::fclose(out) == 0) && ok;
+    if (!ok) {
+      std::error_code ec;
+      fs::remove(tmp, ec);
+      throw std::runtime_error("Failed to write " + tmp.string());
+    }
+    // rename() replaces path atomically on POSIX; std::filesystem uses
+    // MoveFileEx with MOVEFILE_REPLACE_EXISTING on Windows
+    fs::rename(tmp, path);
+  }
+}  // namespace pancake
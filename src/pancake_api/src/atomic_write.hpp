@@ -0,0 +1,22 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#ifndef _PANCAKE_ATOMIC_WRITE_HPP_
+#define _PANCAKE_ATOMIC_WRITE_HPP_
+
+#include <filesystem>
+#include <vector>
+
+namespace pancake {
+  // Replaces a file's contents by writing them to `path` + ".tmp" and
+  // renaming that over `path`, so readers see either the old file or the
+  // new one. If `sync` is set, the data is forced to disk before the rename.
+  // Throws std::runtime_error if the file can't be written.
+  void atomic_write(
+    const std::filesystem::path& path, const std::vector<char>& bytes,
+    bool sync = false);
+}  // namespace pancake
+#endif
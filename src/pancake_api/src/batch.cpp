@@ -0,0 +1,128 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#include <pancake/batch.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <pancake/movie.hpp>
+#include <pancake/sm64.hpp>
+
+namespace pancake {
+  batch_executor::batch_executor(sm64& game) : m_game(game) {
+    // root node, with an empty edge
+    m_nodes.push_back(node {0, 0, 0, {}, {}, {}});
+  }
+
+  size_t batch_executor::add(const m64& movie) {
+    size_t id = m_movies.size();
+    m_movies.push_back(&movie);
+
+    const uint32_t len = movie.size();
+    size_t cur         = 0;
+    uint32_t pos       = 0;
+    while (true) {
+      if (pos == len) {
+        m_nodes[cur].ids.push_back(id);
+        break;
+      }
+
+      auto it = m_nodes[cur].index.find(key(movie[pos]));
+      if (it == m_nodes[cur].index.end()) {
+        // no shared prefix from here, add a leaf
+        size_t leaf = m_nodes.size();
+        m_nodes.push_back(node {id, pos, len, {}, {}, {id}});
+        m_nodes[cur].children.push_back(leaf);
+        m_nodes[cur].index.emplace(key(movie[pos]), leaf);
+        break;
+      }
+
+      // it is invalidated by the push_back() below
+      size_t child   = it->second;
+      const m64& src = *m_movies[m_nodes[child].src];
+      uint32_t end   = m_nodes[child].depth;
+      uint32_t i     = pos;
+      while (i < end && i < len && src[i] == movie[i])
+        i++;
+
+      if (i == end) {
+        // consumed the whole edge
+        cur = child;
+        pos = i;
+        continue;
+      }
+
+      // split the edge at i
+      size_t mid = m_nodes.size();
+      m_nodes.push_back(node {m_nodes[child].src, pos, i, {child}, {}, {}});
+      m_nodes[mid].index.emplace(key(src[i]), child);
+      m_nodes[child].begin = i;
+      for (size_t& c : m_nodes[cur].children) {
+        if (c == child)
+          c = mid;
+      }
+      m_nodes[cur].index[key(movie[pos])] = mid;
+
+      cur = mid;
+      pos = i;
+    }
+    return id;
+  }
+
+  uint64_t batch_executor::run(const callback& cb) {
+    struct visit {
+      size_t node;
+      size_t next;
+      bool saved;
+    };
+
+    const sm64::input_sink& sink = m_game.inputs();
+    uint64_t frames              = 0;
+
+    // Called with the game in the state at the end of `n`'s edge.
+    std::vector<visit> stack;
+    auto enter = [&](size_t n) {
+      node& nd   = m_nodes[n];
+      bool saved = nd.children.size() + (nd.ids.empty() ? 0 : 1) > 1;
+      if (saved) {
+        size_t level = stack.size();
+        while (m_states.size() <= level)
+          m_states.push_back(m_game.alloc_svst());
+        m_states[level].save();
+      }
+      for (size_t id : nd.ids) {
+        cb(id, m_game);
+      }
+      stack.push_back(visit {n, 0, saved});
+    };
+
+    enter(0);
+    while (!stack.empty()) {
+      visit& top = stack.back();
+      node& nd   = m_nodes[top.node];
+      if (top.next == nd.children.size()) {
+        stack.pop_back();
+        continue;
+      }
+      // restore unless this is the first thing done since saving
+      if (top.saved && (top.next > 0 || !nd.ids.empty()))
+        m_states[stack.size() - 1].load();
+
+      size_t child = nd.children[top.next++];
+      node& cn     = m_nodes[child];
+      const m64& src = *m_movies[cn.src];
+      for (uint32_t i = cn.begin; i < cn.depth; i++) {
+        sink.apply(src[i]);
+        m_game.advance();
+      }
+      frames += cn.depth - cn.begin;
+      enter(child);
+    }
+    return frames;
+  }
+}  // namespace pancake
@@ -0,0 +1,293 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#include <pancake/beam_search.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <pancake/dl/pdl.hpp>
+#include <pancake/movie.hpp>
+#include <pancake/pool.hpp>
+#include <pancake/sm64.hpp>
+#include <pancake/stx/hash_bytes.hpp>
+
+namespace {
+  // A set of state hashes, sharded so that threads rarely contend.
+  class transposition_table {
+  private:
+    static constexpr size_t num_shards = 64;
+    struct shard {
+      std::mutex lock;
+      std::unordered_set<uint64_t> seen;
+    };
+    shard m_shards[num_shards];
+
+  public:
+    // Returns true if the hash wasn't seen before.
+    bool insert(uint64_t hash) {
+      shard& s = m_shards[hash % num_shards];
+      std::lock_guard<std::mutex> guard(s.lock);
+      return s.seen.insert(hash).second;
+    }
+  };
+
+  constexpr size_t root_slot = std::numeric_limits<size_t>::max();
+}  // namespace
+
+namespace pancake {
+  // Hashes the state of one instance, either from a watch list or from all
+  // of .data and .bss.
+  struct beam_search::hasher {
+    std::vector<sm64::accessor> watch;
+    std::vector<dl::section> regions;
+    uintptr_t lo, hi;
+
+    hasher(sm64& game, const std::vector<std::string>& exprs) {
+      for (auto& e : exprs) {
+        watch.push_back(game.compile(e));
+      }
+      if (!watch.empty())
+        return;
+
+      dl::library& lib = game.get_lib();
+      regions          = {lib.get_section(".data"), lib.get_section(".bss")};
+      dl::section text = lib.get_section(".text");
+
+      lo = hi = reinterpret_cast<uintptr_t>(text.ptr);
+      for (auto& sect : {text, regions[0], regions[1]}) {
+        uintptr_t begin = reinterpret_cast<uintptr_t>(sect.ptr);
+        lo              = std::min(lo, begin);
+        hi              = std::max(hi, begin + sect.size);
+      }
+    }
+
+    uint64_t operator()() const {
+      if (!watch.empty()) {
+        uint64_t h = 0;
+        for (auto& acc : watch) {
+          h = stx::hash_bytes(acc.ptr, acc.type.size, h);
+        }
+        return h;
+      }
+
+      // Pointers into libsm64's own image differ between instances, so hash
+      // them relative to the image base. That way equal states hash equally
+      // on every instance in the pool.
+      uint64_t h[4] = {1, 2, 3, 4};
+      for (auto& sect : regions) {
+        const unsigned char* p = static_cast<const unsigned char*>(sect.ptr);
+        size_t words           = sect.size / 8;
+        size_t i               = 0;
+        for (; i + 4 <= words; i += 4) {
+          for (size_t j = 0; j < 4; j++) {
+            uint64_t w;
+            std::memcpy(&w, p + (i + j) * 8, 8);
+            if (w >= lo && w < hi)
+              w -= lo;
+            h[j] = (h[j] ^ w) * 0x9FB21C651E98DF25ULL;
+            h[j] ^= h[j] >> 29;
+          }
+        }
+        h[0] ^= stx::hash_bytes(p + i * 8, sect.size - i * 8, h[1]);
+      }
+      return stx::mix64(
+        h[0] ^ stx::mix64(h[1] ^ stx::mix64(h[2] ^ stx::mix64(h[3]))));
+    }
+  };
+
+  beam_search::beam_search(
+    sm64_pool& pool, const m64& prefix, scorer score, options opts) :
+    m_pool(pool),
+    m_prefix(prefix),
+    m_score(std::move(score)),
+    m_opts(std::move(opts)),
+    m_root(pool.alloc_svst()) {
+    if (m_opts.width == 0 || m_opts.candidates.empty()) {
+      throw std::invalid_argument(
+        "Beam search needs a non-zero width and at least one candidate");
+    }
+    for (size_t i = 0; i < m_pool.size(); i++) {
+      m_hashers.emplace_back(new hasher(m_pool[i], m_opts.watch));
+    }
+    m_slots[0].resize(m_pool.size());
+    m_slots[1].resize(m_pool.size());
+
+    m_pool.for_each([&](size_t i, sm64& game) {
+      game.play(prefix);
+      m_root[i].save();
+    });
+  }
+
+  beam_search::~beam_search() = default;
+
+  std::vector<frame> beam_search::path(size_t n) const {
+    std::vector<frame> result;
+    for (; n != 0; n = m_nodes[n].parent) {
+      result.push_back(m_nodes[n].input);
+    }
+    std::reverse(result.begin(), result.end());
+    return result;
+  }
+
+  beam_search::result beam_search::run(size_t depth, const progress& cb) {
+    const size_t workers = m_pool.size();
+    const auto& cands    = m_opts.candidates;
+
+    transposition_table seen;
+    std::atomic<uint64_t> expanded {0}, duplicates {0};
+
+    m_nodes.assign(1, node {0, frame {}});
+    std::vector<entry> beam {entry {0, 0, root_slot, 0}};
+    size_t cur = 0;
+
+    m_root[0].load();
+    seen.insert((*m_hashers[0])());
+    size_t best_node  = 0;
+    double best_score = m_score(m_pool[0]);
+    beam[0].score     = best_score;
+
+    auto load = [&](const entry& e) {
+      if (e.slot == root_slot)
+        m_root[e.owner].load();
+      else
+        m_slots[cur][e.owner][e.slot].load();
+    };
+
+    struct child {
+      size_t parent;
+      size_t cand;
+      double score;
+    };
+
+    for (size_t d = 0; d < depth && !beam.empty(); d++) {
+      // Expand every state on the instance holding it
+      std::vector<std::vector<size_t>> owned(workers);
+      for (size_t k = 0; k < beam.size(); k++) {
+        owned[beam[k].owner].push_back(k);
+      }
+      std::vector<std::vector<child>> kids(workers);
+      m_pool.for_each([&](size_t i, sm64& game) {
+        const sm64::input_sink& sink = game.inputs();
+        for (size_t k : owned[i]) {
+          for (size_t c = 0; c < cands.size(); c++) {
+            load(beam[k]);
+            sink.apply(cands[c]);
+            game.advance();
+            if (!seen.insert((*m_hashers[i])())) {
+              duplicates++;
+              continue;
+            }
+            expanded++;
+            double score = m_score(game);
+            if (!std::isnan(score))
+              kids[i].push_back(child {k, c, score});
+          }
+        }
+      });
+
+      // Keep the best `width`, breaking ties by expansion order
+      std::vector<child> all;
+      for (auto& list : kids) {
+        all.insert(all.end(), list.begin(), list.end());
+      }
+      if (all.empty())
+        break;
+      auto better = [](const child& a, const child& b) {
+        if (a.score != b.score)
+          return a.score > b.score;
+        return (a.parent != b.parent) ? a.parent < b.parent : a.cand < b.cand;
+      };
+      if (all.size() > m_opts.width) {
+        std::nth_element(
+          all.begin(), all.begin() + m_opts.width, all.end(), better);
+        all.resize(m_opts.width);
+      }
+      std::sort(all.begin(), all.end(), better);
+
+      // Survivors stay on their parent's instance, unless that instance has
+      // more than twice its share; the extras are replayed elsewhere.
+      const size_t share = (all.size() + workers - 1) / workers;
+      std::vector<std::vector<std::pair<size_t, bool>>> assigned(workers);
+      std::vector<size_t> overflow;
+      for (size_t s = 0; s < all.size(); s++) {
+        size_t owner = beam[all[s].parent].owner;
+        if (assigned[owner].size() < 2 * share)
+          assigned[owner].emplace_back(s, false);
+        else
+          overflow.push_back(s);
+      }
+      for (size_t s : overflow) {
+        size_t target = 0;
+        for (size_t i = 1; i < workers; i++) {
+          if (assigned[i].size() < assigned[target].size())
+            target = i;
+        }
+        assigned[target].emplace_back(s, true);
+      }
+
+      // Create nodes and the next beam
+      const size_t next = cur ^ 1;
+      std::vector<entry> new_beam(all.size());
+      for (size_t i = 0; i < workers; i++) {
+        for (size_t j = 0; j < assigned[i].size(); j++) {
+          const child& ch = all[assigned[i][j].first];
+          m_nodes.push_back(node {beam[ch.parent].node, cands[ch.cand]});
+          new_beam[assigned[i][j].first] =
+            entry {m_nodes.size() - 1, i, j, ch.score};
+        }
+      }
+
+      m_pool.for_each([&](size_t i, sm64& game) {
+        auto& slots = m_slots[next][i];
+        while (slots.size() < assigned[i].size())
+          slots.push_back(game.alloc_svst());
+
+        for (size_t j = 0; j < assigned[i].size(); j++) {
+          const child& ch = all[assigned[i][j].first];
+          if (assigned[i][j].second) {
+            m_root[i].load();
+            std::vector<frame> inputs = path(beam[ch.parent].node);
+            game.play(inputs.begin(), inputs.end());
+          }
+          else {
+            load(beam[ch.parent]);
+          }
+          game.inputs().apply(cands[ch.cand]);
+          game.advance();
+          slots[j].save();
+        }
+      });
+
+      beam = std::move(new_beam);
+      cur  = next;
+      if (beam.front().score > best_score) {
+        best_score = beam.front().score;
+        best_node  = beam.front().node;
+      }
+
+      if (cb && !cb(d + 1, best_score))
+        break;
+    }
+
+    std::vector<frame> inputs(m_prefix.begin(), m_prefix.end());
+    std::vector<frame> tail = path(best_node);
+    inputs.insert(inputs.end(), tail.begin(), tail.end());
+    return result {
+      m64(inputs.begin(), inputs.end(), m_prefix.metadata), best_score,
+      expanded.load(), duplicates.load()};
+  }
+}  // namespace pancake
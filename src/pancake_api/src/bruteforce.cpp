@@ -0,0 +1,221 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#include <pancake/bruteforce.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <pancake/movie.hpp>
+#include <pancake/pool.hpp>
+#include <pancake/sm64.hpp>
+
+namespace fs = std::filesystem;
+
+namespace pancake {
+  bruteforce::bruteforce(
+    sm64_pool& pool, const m64& base, scorer score, options opts) :
+    m_pool(pool),
+    m_best(base),
+    m_score(std::move(score)),
+    m_opts(std::move(opts)),
+    m_start(pool.alloc_svst()),
+    m_stats {0, 0, 0, 0, 0} {
+    if (m_opts.eval_end == 0)
+      m_opts.eval_end = m_opts.window_end;
+    if (
+      m_opts.window_begin >= m_opts.window_end ||
+      m_opts.window_end > m_opts.eval_end || m_opts.eval_end > base.size()) {
+      throw std::invalid_argument(
+        "Brute-force window must be non-empty and lie within the movie");
+    }
+
+    m_pool.for_each([&](size_t i, sm64& game) {
+      game.play(base.begin(), base.begin() + m_opts.window_begin);
+      m_start[i].save();
+    });
+
+    std::vector<frame> window(
+      base.begin() + m_opts.window_begin, base.begin() + m_opts.window_end);
+    m_stats.best_score = evaluate(m_pool[0], 0, window);
+    // a rejected base must still be beatable
+    if (std::isnan(m_stats.best_score))
+      m_stats.best_score = -std::numeric_limits<double>::infinity();
+  }
+
+  void mutator_set::add(mutator fn, double weight) {
+    if (!(weight > 0)) {
+      throw std::invalid_argument("Mutator weights must be positive");
+    }
+    m_mutators.push_back(weighted {std::move(fn), weight});
+    m_total_weight += weight;
+  }
+
+  void mutator_set::apply(frame& f, std::mt19937_64& rng) const {
+    std::uniform_real_distribution<double> pick(0, m_total_weight);
+    double x = pick(rng);
+    for (auto& m : m_mutators) {
+      if (x < m.weight) {
+        m.fn(f, rng);
+        return;
+      }
+      x -= m.weight;
+    }
+    m_mutators.back().fn(f, rng);
+  }
+
+  void mutator_set::mutate(
+    std::vector<frame>& window, double rate, std::mt19937_64& rng,
+    bool force) const {
+    std::bernoulli_distribution hit(rate);
+    bool any = false;
+    for (frame& f : window) {
+      if (hit(rng)) {
+        apply(f, rng);
+        any = true;
+      }
+    }
+    if (force && !any) {
+      std::uniform_int_distribution<size_t> idx(0, window.size() - 1);
+      apply(window[idx(rng)], rng);
+    }
+  }
+
+  void bruteforce::add_mutator(mutator fn, double weight) {
+    m_mutators.add(std::move(fn), weight);
+  }
+
+  double bruteforce::evaluate(
+    sm64& game, size_t i, const std::vector<frame>& window) {
+    m_start[i].load();
+    game.play(window.begin(), window.end());
+    game.play(
+      m_best.begin() + m_opts.window_end, m_best.begin() + m_opts.eval_end);
+    return m_score(game);
+  }
+
+  void bruteforce::persist() {
+    if (m_opts.output.empty())
+      return;
+    m_best.dump(m_opts.output);
+  }
+
+  bruteforce::stats bruteforce::run(size_t rounds, const progress& cb) {
+    if (m_mutators.empty()) {
+      add_mutator(stick_nudge(16), 4.0);
+      add_mutator(
+        toggle_buttons(frame::button::A | frame::button::B | frame::button::Z));
+    }
+
+    struct result {
+      double score;
+      size_t cand;
+      std::vector<frame> window;
+    };
+    const size_t workers = m_pool.size();
+    std::vector<std::vector<frame>> scratch(workers);
+
+    using clock = std::chrono::steady_clock;
+    clock::time_point start = clock::now();
+    double prev_secs =
+      (m_stats.candidates_per_second > 0)
+      ? double(m_stats.candidates) / m_stats.candidates_per_second
+      : 0;
+
+    for (size_t r = 0; r < rounds; r++) {
+      const std::vector<frame> base(
+        m_best.begin() + m_opts.window_begin, m_best.begin() + m_opts.window_end);
+      std::vector<result> best(
+        workers, result {-std::numeric_limits<double>::infinity(),
+                         std::numeric_limits<size_t>::max(), {}});
+
+      m_pool.parallel_for(m_opts.batch, [&](size_t w, sm64& game, size_t c) {
+        std::seed_seq seq {
+          uint32_t(m_opts.seed), uint32_t(m_opts.seed >> 32),
+          uint32_t(m_stats.rounds), uint32_t(m_stats.rounds >> 32),
+          uint32_t(c)};
+        std::mt19937_64 rng(seq);
+
+        std::vector<frame>& win = scratch[w];
+        win.assign(base.begin(), base.end());
+        m_mutators.mutate(win, m_opts.mutation_rate, rng, true);
+
+        double score = evaluate(game, w, win);
+        result& b    = best[w];
+        if (score > b.score || (score == b.score && c < b.cand)) {
+          b.score = score;
+          b.cand  = c;
+          b.window.assign(win.begin(), win.end());
+        }
+      });
+
+      // ties go to the lowest candidate so results don't depend on scheduling
+      auto top = std::max_element(
+        best.begin(), best.end(), [](const result& a, const result& b) {
+          return a.score < b.score || (a.score == b.score && a.cand > b.cand);
+        });
+      if (top->score > m_stats.best_score) {
+        std::copy(
+          top->window.begin(), top->window.end(),
+          m_best.begin() + m_opts.window_begin);
+        m_stats.best_score = top->score;
+        m_stats.improvements++;
+        persist();
+      }
+
+      m_stats.rounds++;
+      m_stats.candidates += m_opts.batch;
+      double secs =
+        prev_secs +
+        std::chrono::duration<double>(clock::now() - start).count();
+      m_stats.candidates_per_second =
+        (secs > 0) ? double(m_stats.candidates) / secs : 0;
+
+      if (cb && !cb(m_stats))
+        break;
+    }
+    return m_stats;
+  }
+
+  bruteforce::mutator bruteforce::stick_nudge(int radius) {
+    return [radius](frame& f, std::mt19937_64& rng) {
+      std::uniform_int_distribution<int> d(-radius, radius);
+      f.stick_x = int8_t(std::clamp(f.stick_x + d(rng), -128, 127));
+      f.stick_y = int8_t(std::clamp(f.stick_y + d(rng), -128, 127));
+    };
+  }
+
+  bruteforce::mutator bruteforce::stick_random() {
+    return [](frame& f, std::mt19937_64& rng) {
+      std::uniform_int_distribution<int> d(-128, 127);
+      f.stick_x = int8_t(d(rng));
+      f.stick_y = int8_t(d(rng));
+    };
+  }
+
+  bruteforce::mutator bruteforce::toggle_buttons(frame::button mask) {
+    std::vector<frame::button> bits;
+    for (uint16_t b = 1; b != 0; b <<= 1) {
+      if (static_cast<uint16_t>(mask) & b)
+        bits.push_back(static_cast<frame::button>(b));
+    }
+    if (bits.empty()) {
+      throw std::invalid_argument("Button mask is empty");
+    }
+    return [bits](frame& f, std::mt19937_64& rng) {
+      std::uniform_int_distribution<size_t> d(0, bits.size() - 1);
+      f.buttons ^= bits[d(rng)];
+    };
+  }
+}  // namespace pancake
@@ -0,0 +1,134 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#include <pancake/earliest.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <pancake/movie.hpp>
+#include <pancake/pool.hpp>
+#include <pancake/sm64.hpp>
+#include <pancake/timeline.hpp>
+
+namespace {
+  uint32_t horizon_of(const pancake::earliest_query& q, const pancake::m64& movie) {
+    uint32_t horizon = (q.horizon == 0) ? uint32_t(movie.size()) : q.horizon;
+    if (q.begin >= q.end || q.end > horizon || horizon > movie.size()) {
+      throw std::invalid_argument(
+        "Search range must be non-empty and end before the horizon");
+    }
+    return horizon;
+  }
+
+  // Plays the edited tail from frame `at` and checks the goal after each
+  // input.
+  bool try_frame(
+    pancake::timeline& tl, const pancake::earliest_query& q, uint32_t horizon,
+    uint32_t at, std::vector<pancake::frame>& tail) {
+    pancake::sm64& game = tl.game();
+    tl.seek(at);
+    tail.assign(tl.movie().begin() + at, tl.movie().begin() + horizon);
+    q.edit(tail, at);
+
+    bool hit = false;
+    game.advance(
+      tail.size(), [&](size_t i) { return tail[i]; },
+      [&](size_t) {
+        hit = q.goal(game);
+        return !hit;
+      });
+    tl.detach();
+    return hit;
+  }
+}  // namespace
+
+namespace pancake {
+  earliest_result find_earliest(timeline& tl, const earliest_query& q) {
+    const uint32_t horizon = horizon_of(q, tl.movie());
+    earliest_result result {std::nullopt, 0};
+    std::vector<frame> tail;
+    auto test = [&](uint32_t at) {
+      result.tests++;
+      return try_frame(tl, q, horizon, at, tail);
+    };
+
+    if (!q.monotone) {
+      for (uint32_t at = q.begin; at < q.end; at++) {
+        if (test(at)) {
+          result.frame = at;
+          break;
+        }
+      }
+      return result;
+    }
+
+    // Gallop forward until the goal is reached...
+    if (test(q.begin)) {
+      result.frame = q.begin;
+      return result;
+    }
+    uint32_t lo = q.begin, hi = q.end;
+    for (uint32_t step = 1;; step *= 2) {
+      uint32_t at = (q.end - lo > step) ? lo + step : q.end - 1;
+      if (at == lo)
+        return result;
+      if (test(at)) {
+        hi = at;
+        break;
+      }
+      lo = at;
+      if (at == q.end - 1)
+        return result;
+    }
+    // ...then bisect (lo, hi], where lo fails and hi succeeds.
+    while (hi - lo > 1) {
+      uint32_t mid = lo + (hi - lo) / 2;
+      if (test(mid))
+        hi = mid;
+      else
+        lo = mid;
+    }
+    result.frame = hi;
+    return result;
+  }
+
+  earliest_result find_earliest(
+    sm64_pool& pool, const m64& movie, const earliest_query& q, size_t budget,
+    uint32_t interval) {
+    const uint32_t horizon = horizon_of(q, movie);
+
+    std::vector<m64> movies(pool.size(), movie);
+    std::vector<std::unique_ptr<timeline>> timelines;
+    for (size_t i = 0; i < pool.size(); i++) {
+      timelines.emplace_back(new timeline(pool[i], movies[i], budget, interval));
+    }
+
+    std::atomic<uint32_t> best {std::numeric_limits<uint32_t>::max()};
+    std::atomic<uint64_t> tests {0};
+    std::vector<std::vector<frame>> tails(pool.size());
+    pool.parallel_for(q.end - q.begin, [&](size_t i, sm64&, size_t item) {
+      uint32_t at = q.begin + uint32_t(item);
+      if (at >= best.load(std::memory_order_relaxed))
+        return;
+      tests++;
+      if (!try_frame(*timelines[i], q, horizon, at, tails[i]))
+        return;
+      uint32_t cur = best.load();
+      while (at < cur && !best.compare_exchange_weak(cur, at)) {
+      }
+    });
+
+    earliest_result result {std::nullopt, tests.load()};
+    if (best.load() != std::numeric_limits<uint32_t>::max())
+      result.frame = best.load();
+    return result;
+  }
+}  // namespace pancake
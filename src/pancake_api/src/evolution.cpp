@@ -0,0 +1,367 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#include <pancake/evolution.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <pancake/batch.hpp>
+#include <pancake/bruteforce.hpp>
+#include <pancake/movie.hpp>
+#include <pancake/pool.hpp>
+#include <pancake/sm64.hpp>
+#include "atomic_write.hpp"
+
+namespace fs = std::filesystem;
+using pancake::frame;
+
+namespace {
+  constexpr char evo_magic[8] = {'P', 'C', 'E', 'V', 'O', 'L', 0, 2};
+  constexpr double worst      = -std::numeric_limits<double>::infinity();
+
+  // Orders windows so that ones sharing a prefix end up next to each other.
+  bool window_less(const std::vector<frame>& a, const std::vector<frame>& b) {
+    return std::lexicographical_compare(
+      a.begin(), a.end(), b.begin(), b.end(),
+      [](const frame& x, const frame& y) {
+        if (x.buttons != y.buttons)
+          return uint16_t(x.buttons) < uint16_t(y.buttons);
+        if (x.stick_x != y.stick_x)
+          return x.stick_x < y.stick_x;
+        return x.stick_y < y.stick_y;
+      });
+  }
+
+  // Little-endian checkpoint fields; frames use the M64 layout.
+  void put_u64(std::vector<char>& buf, uint64_t x) {
+    for (size_t i = 0; i < 8; i++)
+      buf.push_back(char(x >> (8 * i)));
+  }
+  void put_f64(std::vector<char>& buf, double x) {
+    uint64_t bits;
+    std::memcpy(&bits, &x, 8);
+    put_u64(buf, bits);
+  }
+  void put_frames(std::vector<char>& buf, const std::vector<frame>& window) {
+    for (const frame& f : window) {
+      buf.push_back(char(uint16_t(f.buttons) >> 8));
+      buf.push_back(char(uint16_t(f.buttons)));
+      buf.push_back(char(f.stick_x));
+      buf.push_back(char(f.stick_y));
+    }
+  }
+
+  class reader {
+  private:
+    const std::vector<char>& m_buf;
+    size_t m_pos = 0;
+
+    const char* take(size_t n) {
+      if (m_pos + n > m_buf.size())
+        throw std::runtime_error("Evolution checkpoint is truncated");
+      const char* p = &m_buf[m_pos];
+      m_pos += n;
+      return p;
+    }
+
+  public:
+    reader(const std::vector<char>& buf) : m_buf(buf) {}
+
+    void skip(size_t n) { take(n); }
+
+    uint64_t u64() {
+      const char* p = take(8);
+      uint64_t x    = 0;
+      for (size_t i = 0; i < 8; i++)
+        x |= uint64_t(uint8_t(p[i])) << (8 * i);
+      return x;
+    }
+    double f64() {
+      uint64_t bits = u64();
+      double x;
+      std::memcpy(&x, &bits, 8);
+      return x;
+    }
+    std::vector<frame> frames(size_t n) {
+      const char* p = take(n * 4);
+      std::vector<frame> result(n);
+      for (size_t i = 0; i < n; i++, p += 4) {
+        result[i].buttons = static_cast<frame::button>(
+          (uint16_t(uint8_t(p[0])) << 8) | uint8_t(p[1]));
+        result[i].stick_x = int8_t(p[2]);
+        result[i].stick_y = int8_t(p[3]);
+      }
+      return result;
+    }
+  };
+}  // namespace
+
+namespace pancake {
+  evolution::evolution(
+    sm64_pool& pool, const m64& base, scorer score, options opts) :
+    m_pool(pool),
+    m_best(base),
+    m_score(std::move(score)),
+    m_opts(std::move(opts)),
+    m_start(pool.alloc_svst()),
+    m_stats {0, 0, worst, worst} {
+    if (m_opts.eval_end == 0)
+      m_opts.eval_end = m_opts.window_end;
+    if (
+      m_opts.window_begin >= m_opts.window_end ||
+      m_opts.window_end > m_opts.eval_end || m_opts.eval_end > base.size()) {
+      throw std::invalid_argument(
+        "Evolution window must be non-empty and lie within the movie");
+    }
+    if (m_opts.population <= m_opts.elites || m_opts.tournament == 0) {
+      throw std::invalid_argument(
+        "Population must be larger than the elites, and tournaments non-empty");
+    }
+
+    m_pool.for_each([&](size_t i, sm64& game) {
+      game.play(base.begin(), base.begin() + m_opts.window_begin);
+      m_start[i].save();
+    });
+
+    if (!m_opts.checkpoint.empty() && fs::exists(m_opts.checkpoint))
+      restore();
+  }
+
+  void evolution::add_mutator(mutator fn, double weight) {
+    m_mutators.add(std::move(fn), weight);
+  }
+
+  void evolution::evaluate(std::vector<individual*>& todo) {
+    std::sort(todo.begin(), todo.end(), [](individual* a, individual* b) {
+      return window_less(a->window, b->window);
+    });
+
+    const size_t workers = m_pool.size();
+    m_pool.for_each([&](size_t i, sm64& game) {
+      const size_t begin = todo.size() * i / workers;
+      const size_t end   = todo.size() * (i + 1) / workers;
+      if (begin == end)
+        return;
+
+      std::vector<m64> movies;
+      movies.reserve(end - begin);
+      for (size_t k = begin; k < end; k++) {
+        std::vector<frame> inputs(todo[k]->window);
+        inputs.insert(
+          inputs.end(), m_best.begin() + m_opts.window_end,
+          m_best.begin() + m_opts.eval_end);
+        movies.emplace_back(inputs.begin(), inputs.end(), m_best.metadata);
+      }
+
+      m_start[i].load();
+      batch_executor batch(game);
+      for (auto& movie : movies)
+        batch.add(movie);
+      batch.run([&](size_t id, sm64& g) {
+        double score            = m_score(g);
+        todo[begin + id]->score = std::isnan(score) ? worst : score;
+      });
+    });
+    m_stats.evaluations += todo.size();
+  }
+
+  const evolution::individual& evolution::select(std::mt19937_64& rng) const {
+    std::uniform_int_distribution<size_t> pick(0, m_pop.size() - 1);
+    const individual* best = &m_pop[pick(rng)];
+    for (size_t i = 1; i < m_opts.tournament; i++) {
+      const individual* other = &m_pop[pick(rng)];
+      if (other->score > best->score)
+        best = other;
+    }
+    return *best;
+  }
+
+  void evolution::breed(individual& child, std::mt19937_64& rng) const {
+    const individual& a = select(rng);
+    child.window        = a.window;
+    child.score         = worst;
+
+    std::bernoulli_distribution cross(m_opts.crossover_rate);
+    if (cross(rng)) {
+      const individual& b = select(rng);
+      std::uniform_int_distribution<size_t> cut(0, child.window.size());
+      size_t lo = cut(rng), hi = cut(rng);
+      if (lo > hi)
+        std::swap(lo, hi);
+      std::copy(
+        b.window.begin() + lo, b.window.begin() + hi,
+        child.window.begin() + lo);
+    }
+
+    m_mutators.mutate(child.window, m_opts.mutation_rate, rng, false);
+  }
+
+  void evolution::update() {
+    // Population is sorted best first
+    std::stable_sort(
+      m_pop.begin(), m_pop.end(),
+      [](const individual& a, const individual& b) {
+        return a.score > b.score;
+      });
+
+    double sum   = 0;
+    size_t count = 0;
+    for (auto& ind : m_pop) {
+      if (std::isfinite(ind.score)) {
+        sum += ind.score;
+        count++;
+      }
+    }
+    m_stats.mean_score = (count > 0) ? sum / count : worst;
+
+    if (m_pop.front().score > m_stats.best_score) {
+      m_stats.best_score = m_pop.front().score;
+      std::copy(
+        m_pop.front().window.begin(), m_pop.front().window.end(),
+        m_best.begin() + m_opts.window_begin);
+      if (!m_opts.output.empty())
+        m_best.dump(m_opts.output);
+    }
+  }
+
+  void evolution::save() const {
+    if (m_opts.checkpoint.empty())
+      return;
+
+    std::vector<char> buf(evo_magic, evo_magic + sizeof(evo_magic));
+    put_u64(buf, m_stats.generations);
+    put_u64(buf, m_stats.evaluations);
+    put_u64(buf, m_opts.window_begin);
+    put_u64(buf, m_opts.window_end);
+    put_u64(buf, m_opts.eval_end);
+    put_u64(buf, m_pop.size());
+    put_f64(buf, m_stats.best_score);
+    put_frames(
+      buf,
+      std::vector<frame>(
+        m_best.begin() + m_opts.window_begin,
+        m_best.begin() + m_opts.window_end));
+    for (auto& ind : m_pop) {
+      put_f64(buf, ind.score);
+      put_frames(buf, ind.window);
+    }
+
+    atomic_write(m_opts.checkpoint, buf);
+  }
+
+  void evolution::restore() {
+    std::ifstream in(m_opts.checkpoint, std::ios::in | std::ios::binary);
+    std::vector<char> buf(
+      (std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (
+      buf.size() < sizeof(evo_magic) ||
+      !std::equal(evo_magic, evo_magic + sizeof(evo_magic), buf.begin())) {
+      throw std::runtime_error(
+        m_opts.checkpoint.string() + " is not an evolution checkpoint");
+    }
+
+    reader rd(buf);
+    rd.skip(sizeof(evo_magic));
+    m_stats.generations = rd.u64();
+    m_stats.evaluations = rd.u64();
+    const size_t begin  = rd.u64();
+    const size_t end    = rd.u64();
+    const size_t eval   = rd.u64();
+    const size_t count  = rd.u64();
+    if (
+      begin != m_opts.window_begin || end != m_opts.window_end ||
+      eval != m_opts.eval_end) {
+      throw std::runtime_error(
+        "Evolution checkpoint is for a different window");
+    }
+    if (count != m_opts.population) {
+      throw std::runtime_error(
+        "Evolution checkpoint is for a population of a different size");
+    }
+    const size_t len      = end - begin;
+    m_stats.best_score    = rd.f64();
+    std::vector<frame> bw = rd.frames(len);
+    std::copy(bw.begin(), bw.end(), m_best.begin() + m_opts.window_begin);
+
+    m_pop.clear();
+    for (size_t i = 0; i < count; i++) {
+      double score = rd.f64();
+      m_pop.push_back(individual {rd.frames(len), score});
+    }
+    update();
+  }
+
+  evolution::stats evolution::run(size_t generations, const progress& cb) {
+    if (m_mutators.empty()) {
+      add_mutator(bruteforce::stick_nudge(16), 4.0);
+      add_mutator(bruteforce::toggle_buttons(
+        frame::button::A | frame::button::B | frame::button::Z));
+    }
+
+    auto rng_for = [&](uint64_t gen, size_t child) {
+      std::seed_seq seq {
+        uint32_t(m_opts.seed), uint32_t(m_opts.seed >> 32), uint32_t(gen),
+        uint32_t(gen >> 32), uint32_t(child)};
+      return std::mt19937_64(seq);
+    };
+
+    if (m_pop.empty()) {
+      // First generation: the base window and mutated copies of it
+      individual base {
+        std::vector<frame>(
+          m_best.begin() + m_opts.window_begin,
+          m_best.begin() + m_opts.window_end),
+        worst};
+      m_pop.assign(m_opts.population, base);
+      std::vector<individual*> todo;
+      for (size_t c = 0; c < m_pop.size(); c++) {
+        std::mt19937_64 rng = rng_for(0, c);
+        if (c > 0)
+          m_mutators.mutate(
+            m_pop[c].window, m_opts.mutation_rate, rng, true);
+        todo.push_back(&m_pop[c]);
+      }
+      evaluate(todo);
+      update();
+      save();
+    }
+
+    for (size_t g = 0; g < generations; g++) {
+      const uint64_t gen = m_stats.generations + 1;
+      std::vector<individual> next(
+        m_pop.begin(), m_pop.begin() + m_opts.elites);
+      next.resize(m_opts.population);
+
+      std::vector<individual*> todo;
+      for (size_t c = m_opts.elites; c < next.size(); c++) {
+        std::mt19937_64 rng = rng_for(gen, c);
+        breed(next[c], rng);
+        todo.push_back(&next[c]);
+      }
+      evaluate(todo);
+
+      m_pop = std::move(next);
+      m_stats.generations = gen;
+      update();
+      save();
+
+      if (cb && !cb(m_stats))
+        break;
+    }
+    return m_stats;
+  }
+}  // namespace pancake
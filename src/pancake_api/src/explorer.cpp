@@ -0,0 +1,163 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#include <pancake/explorer.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <pancake/movie.hpp>
+#include <pancake/sm64.hpp>
+#include <pancake/stx/hash_bytes.hpp>
+
+namespace pancake {
+  explorer::explorer(sm64& game, const m64& prefix, cell_fn fn, options opts) :
+    m_game(game),
+    m_prefix(prefix),
+    m_cell(std::move(fn)),
+    m_opts(opts),
+    m_rng(opts.seed),
+    m_stats {0, 0, 0, 0} {
+    m_gen = [](std::mt19937_64& rng) {
+      std::uniform_int_distribution<int> stick(-128, 127);
+      std::bernoulli_distribution press(0.25);
+      frame f {frame::button::none, 0, 0};
+      f.stick_x = int8_t(stick(rng));
+      f.stick_y = int8_t(stick(rng));
+      if (press(rng))
+        f.buttons |= frame::button::A;
+      if (press(rng))
+        f.buttons |= frame::button::B;
+      if (press(rng))
+        f.buttons |= frame::button::Z;
+      return f;
+    };
+
+    m_game.play(prefix);
+    visit({});
+  }
+
+  void explorer::visit(const std::vector<frame>& inputs) {
+    uint64_t key = m_cell(m_game);
+    auto it      = m_index.find(key);
+    if (it == m_index.end()) {
+      m_index.emplace(key, m_cells.size());
+      m_cells.push_back(
+        cell {cell_info {key, inputs.size(), 0, 1}, inputs, m_game.alloc_svst()});
+      m_cells.back().state.save();
+      m_stats.cells++;
+      return;
+    }
+
+    cell& c = m_cells[it->second];
+    c.info.seen++;
+    if (inputs.size() < c.inputs.size()) {
+      c.inputs      = inputs;
+      c.info.length = inputs.size();
+      c.state.save();
+      m_stats.shortened++;
+    }
+  }
+
+  explorer::stats explorer::run(size_t iterations, const progress& cb) {
+    std::bernoulli_distribution repeat(m_opts.repeat_rate);
+    std::vector<double> weights;
+
+    for (size_t it = 0; it < iterations; it++) {
+      // Favour cells that were rarely picked or reached
+      weights.resize(m_cells.size());
+      for (size_t i = 0; i < m_cells.size(); i++) {
+        const cell_info& info = m_cells[i].info;
+        weights[i]            = 1.0 / std::sqrt(1.0 + double(info.chosen)) +
+          1.0 / std::sqrt(1.0 + double(info.seen));
+      }
+      std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+      size_t from = pick(m_rng);
+
+      // visit() may reallocate the archive, so copy what's needed first
+      m_cells[from].info.chosen++;
+      std::vector<frame> inputs = m_cells[from].inputs;
+      m_cells[from].state.load();
+
+      const sm64::input_sink& sink = m_game.inputs();
+      frame input                  = m_gen(m_rng);
+      for (size_t k = 0; k < m_opts.explore_frames; k++) {
+        if (k > 0 && !repeat(m_rng))
+          input = m_gen(m_rng);
+        sink.apply(input);
+        m_game.advance();
+        inputs.push_back(input);
+        visit(inputs);
+      }
+
+      m_stats.iterations++;
+      m_stats.frames += m_opts.explore_frames;
+      if (cb && !cb(m_stats))
+        break;
+    }
+    return m_stats;
+  }
+
+  std::vector<explorer::cell_info> explorer::cells() const {
+    std::vector<cell_info> result;
+    result.reserve(m_cells.size());
+    for (auto& c : m_cells)
+      result.push_back(c.info);
+    return result;
+  }
+
+  m64 explorer::movie(uint64_t key) const {
+    const cell& c = m_cells[m_index.at(key)];
+    std::vector<frame> inputs(m_prefix.begin(), m_prefix.end());
+    inputs.insert(inputs.end(), c.inputs.begin(), c.inputs.end());
+    return m64(inputs.begin(), inputs.end(), m_prefix.metadata);
+  }
+
+  void explorer::load(uint64_t key) const {
+    m_cells[m_index.at(key)].state.load();
+  }
+
+  explorer::cell_fn explorer::quantise(
+    sm64& game, const std::vector<std::pair<std::string, double>>& watch) {
+    std::vector<std::pair<sm64::accessor, double>> accs;
+    for (auto& [expr, bucket] : watch) {
+      if (!(bucket >= 0)) {
+        throw std::invalid_argument("Bucket sizes can't be negative");
+      }
+      accs.emplace_back(game.compile(expr), bucket);
+    }
+    return [accs = std::move(accs)](sm64&) {
+      // every NaN lands in the same cell, whatever its payload
+      constexpr uint64_t nan_cell = 0x7FF8000000000000ULL;
+      uint64_t h = 0;
+      for (auto& [acc, bucket] : accs) {
+        double v = acc.value();
+        double q = (bucket > 0) ? std::floor(v / bucket) : v;
+        uint64_t bits;
+        if (std::isnan(q)) {
+          bits = nan_cell;
+        }
+        else if (bucket > 0 && q >= -0x1p63 && q < 0x1p63) {
+          int64_t i = int64_t(q);
+          std::memcpy(&bits, &i, 8);
+        }
+        else {
+          // infinities and buckets past the range of int64_t are hashed as
+          // doubles; floor() already made them whole
+          std::memcpy(&bits, &q, 8);
+        }
+        h = stx::mix64(h ^ bits) + 0x9E3779B97F4A7C15ULL;
+      }
+      return h;
+    };
+  }
+}  // namespace pancake
@@ -0,0 +1,22 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#include <pancake/formula.hpp>
+
+#include <string>
+
+#include <pancake/expr/vm.hpp>
+#include <pancake/sm64.hpp>
+
+namespace pancake {
+  formula compile_formula(sm64& game, const std::string& text) {
+    return expr::compile_formula(
+      expr::parse_formula(text), [&](const std::string& path) {
+        sm64::accessor acc = game.compile(path);
+        return formula::operand {acc.ptr, acc.type};
+      });
+  }
+}  // namespace pancake
@@ -0,0 +1,173 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#include <pancake/memory_scan.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <pancake/dl/pdl.hpp>
+#include <pancake/stx/bits.hpp>
+
+namespace {
+  template <typename T>
+  T load(const char* ptr) {
+    T res;
+    std::memcpy(&res, ptr, sizeof(T));
+    return res;
+  }
+
+  size_t type_size(pancake::scan_type type) {
+    switch (type) {
+      case pancake::scan_type::s8: return 1;
+      case pancake::scan_type::s16: return 2;
+      case pancake::scan_type::s32: return 4;
+      case pancake::scan_type::s64: return 8;
+      case pancake::scan_type::f32: return 4;
+      case pancake::scan_type::f64: return 8;
+    }
+    throw std::invalid_argument("Invalid scan type");
+  }
+
+  // Calls fn with a value of the C++ type matching a scan type.
+  template <typename F>
+  decltype(auto) visit_type(pancake::scan_type type, F&& fn) {
+    switch (type) {
+      case pancake::scan_type::s8: return fn(int8_t());
+      case pancake::scan_type::s16: return fn(int16_t());
+      case pancake::scan_type::s32: return fn(int32_t());
+      case pancake::scan_type::s64: return fn(int64_t());
+      case pancake::scan_type::f32: return fn(float());
+      case pancake::scan_type::f64: return fn(double());
+    }
+    throw std::invalid_argument("Invalid scan type");
+  }
+}  // namespace
+
+namespace pancake {
+  memory_scan::memory_scan(sm64& game, scan_type type, size_t align) :
+    m_type(type), m_align(align ? align : type_size(type)), m_count(0) {
+    dl::library& lib = game.get_lib();
+    for (const char* name : {".data", ".bss"}) {
+      dl::section sect = lib.get_section(name);
+      m_regions.push_back(region {
+        static_cast<const char*>(sect.ptr), sect.size, 0, {}, {}});
+    }
+    reset();
+  }
+
+  void memory_scan::reset() {
+    size_t size = type_size(m_type);
+    m_count     = 0;
+    for (auto& r : m_regions) {
+      r.slots = (r.size >= size) ? (r.size - size) / m_align + 1 : 0;
+      r.bits.assign((r.slots + 63) / 64, ~uint64_t(0));
+      if (r.slots % 64 != 0)
+        r.bits.back() = (uint64_t(1) << (r.slots % 64)) - 1;
+      r.last.assign(r.base, r.base + r.size);
+      m_count += r.slots;
+    }
+  }
+
+  // Keeps the candidates for which pred(current, last) holds, then
+  // remembers the current memory.
+  template <typename F>
+  size_t memory_scan::narrow(F&& pred) {
+    m_count = 0;
+    visit_type(m_type, [&](auto tag) {
+      using T = decltype(tag);
+      for (auto& r : m_regions) {
+        for (size_t w = 0; w < r.bits.size(); w++) {
+          uint64_t word = r.bits[w];
+          if (word == 0)
+            continue;
+          size_t first    = w * 64;
+          size_t n        = std::min<size_t>(64, r.slots - first);
+          const char* cur = r.base + first * m_align;
+          const char* old = r.last.data() + first * m_align;
+
+          uint64_t keep = 0;
+          for (size_t k = 0; k < n; k++) {
+            T a = load<T>(cur + k * m_align);
+            T b = load<T>(old + k * m_align);
+            keep |= uint64_t(pred(a, b)) << k;
+          }
+          word &= keep;
+          r.bits[w] = word;
+          m_count += stx::popcount(word);
+        }
+        std::memcpy(r.last.data(), r.base, r.size);
+      }
+    });
+    return m_count;
+  }
+
+  size_t memory_scan::exact(double value) {
+    return narrow([value](auto cur, auto) {
+      using T = decltype(cur);
+      // out-of-range values can't be converted to an integer type
+      if constexpr (std::is_floating_point_v<T>)
+        return cur == T(value);
+      else
+        return double(cur) == value;
+    });
+  }
+
+  size_t memory_scan::range(double lo, double hi) {
+    return narrow([lo, hi](auto cur, auto) {
+      return lo <= double(cur) && double(cur) <= hi;
+    });
+  }
+
+  size_t memory_scan::changed() {
+    // compares bits, so floats that are NaN both times count as unchanged
+    return narrow([](auto cur, auto old) {
+      return std::memcmp(&cur, &old, sizeof(cur)) != 0;
+    });
+  }
+
+  size_t memory_scan::unchanged() {
+    return narrow([](auto cur, auto old) {
+      return std::memcmp(&cur, &old, sizeof(cur)) == 0;
+    });
+  }
+
+  size_t memory_scan::increased() {
+    return narrow([](auto cur, auto old) { return cur > old; });
+  }
+
+  size_t memory_scan::decreased() {
+    return narrow([](auto cur, auto old) { return cur < old; });
+  }
+
+  std::vector<scan_hit> memory_scan::hits(
+    size_t limit, const address_index* index) const {
+    std::vector<scan_hit> res;
+    visit_type(m_type, [&](auto tag) {
+      using T = decltype(tag);
+      for (auto& r : m_regions) {
+        for (size_t w = 0; w < r.bits.size(); w++) {
+          for (uint64_t word = r.bits[w]; word != 0; word &= word - 1) {
+            if (res.size() >= limit)
+              return;
+            size_t slot = w * 64 + stx::ctz(word);
+            const char* addr = r.base + slot * m_align;
+            void* ptr        = const_cast<char*>(addr);
+            res.push_back(scan_hit {
+              ptr, double(load<T>(addr)),
+              index ? index->describe(ptr) : std::string()});
+          }
+        }
+      }
+    });
+    return res;
+  }
+}  // namespace pancake
@@ -7,6 +7,13 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 #include <pancake/movie.hpp>
 
+#if defined(_WIN32)
+  #include <io.h>
+#else
+  #include <unistd.h>
+#endif
+
+#include <cstdio>
 #include <cstring>
 #include <stdint.h>
 #include <algorithm>
@@ -21,9 +28,11 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <pancake/sm64.hpp>
+#include "atomic_write.hpp"
 
 using std::ios, std::stringstream, std::fstream;
 using std::numeric_limits;
@@ -63,6 +72,101 @@ namespace {
 
     static const uint16_t start_of_data = 0x0400;
   };
+
+  uint32_t read_u32(const char* p) {
+    return uint32_t(uint8_t(p[0])) | (uint32_t(uint8_t(p[1])) << 8) |
+      (uint32_t(uint8_t(p[2])) << 16) | (uint32_t(uint8_t(p[3])) << 24);
+  }
+  
+  void dump_u32(uint32_t x, char* p) {
+    // Narrowing conversion takes the lowest byte
+    p[0] = x;
+    x >>= 8;
+    p[1] = x;
+    x >>= 8;
+    p[2] = x;
+    x >>= 8;
+    p[3] = x;
+  }
+  
+  void dump_u16(uint16_t x, char* p) {
+    // Narrowing conversion takes the lowest byte
+    p[0] = x;
+    x >>= 8;
+    p[1] = x;
+  }
+  
+  void dump_str(string x, char* p, unsigned bytes) {
+    // Truncate if needed
+    if (x.length() + 1 > bytes)
+      x.resize(bytes - 1);
+    for (size_t i = 0; i < x.length(); i++) {
+      p[i] = x[i];
+    }
+    p[x.length()] = '\0';
+  }
+  
+  // Serializes M64 metadata into a 1024-byte header.
+  void dump_header(
+    const pancake::m64::metadata_s& metadata, uint32_t num_input_frames,
+    char* buffer) {
+    std::fill(buffer, buffer + m64_offs::start_of_data, '\0');
+    std::copy(M64_SIG.begin(), M64_SIG.end(), &buffer[m64_offs::signature]);
+
+    dump_u32(metadata.version, &buffer[m64_offs::version]);
+    dump_u32(metadata.timestamp, &buffer[m64_offs::timestamp]);
+    dump_u32(metadata.num_vis, &buffer[m64_offs::num_vis]);
+    dump_u32(metadata.rerecords, &buffer[m64_offs::rerecords]);
+    buffer[m64_offs::vis_per_s]       = metadata.vis_per_s;
+    buffer[m64_offs::num_controllers] = metadata.num_controllers;
+    dump_u32(num_input_frames, &buffer[m64_offs::num_input_frames]);
+    
+    dump_u16(
+      static_cast<uint16_t>(metadata.start_type), &buffer[m64_offs::start_type]);
+    dump_u32(static_cast<uint32_t>(metadata.controllers), &buffer[m64_offs::controllers]);
+    
+    dump_str(metadata.rom_name, &buffer[m64_offs::rom_name], 32);
+    dump_u32(metadata.crc, &buffer[m64_offs::crc]);
+    dump_u16(metadata.country_code, &buffer[m64_offs::country_code]);
+    
+    dump_str(metadata.video_plugin, &buffer[m64_offs::video_plugin], 64);
+    dump_str(metadata.sound_plugin, &buffer[m64_offs::sound_plugin], 64);
+    dump_str(metadata.input_plugin, &buffer[m64_offs::input_plugin], 64);
+    dump_str(metadata.rsp_plugin, &buffer[m64_offs::rsp_plugin], 64);
+    
+    dump_str(metadata.authors, &buffer[m64_offs::authors], 222);
+    dump_str(metadata.description, &buffer[m64_offs::description], 256);
+  }
+  
+  // Serializes one frame into 4 bytes. The button word is stored high byte
+  // first, matching how the constructor reads it.
+  void dump_frame(const pancake::frame& f, char* p) {
+    p[0] = static_cast<uint16_t>(f.buttons) >> 8;
+    p[1] = static_cast<uint16_t>(f.buttons);
+    p[2] = f.stick_x;
+    p[3] = f.stick_y;
+  }
+  
+  // Forces a file's contents to disk.
+  void sync_file(std::FILE* file) {
+  #if defined(_WIN32)
+    _commit(_fileno(file));
+  #else
+    fsync(fileno(file));
+  #endif
+  }
+  
+  // Seeks to an absolute offset. Frame data can run past 2 GiB, which
+  // doesn't fit in a long on Windows.
+  bool seek_to(std::FILE* file, uint64_t off) {
+  #if defined(_WIN32)
+    return _fseeki64(file, int64_t(off), SEEK_SET) == 0;
+  #else
+    if (off > uint64_t(numeric_limits<off_t>::max()))
+      return false;
+    return fseeko(file, off_t(off), SEEK_SET) == 0;
+  #endif
+  }
 }  // namespace
 
 namespace pancake {
@@ -191,81 +295,142 @@ namespace pancake {
   }
 
   void frame::apply(pancake::sm64& game) const {
-    game.get<uint16_t>("gControllerPads[0].button") =
-      static_cast<uint16_t>(this->buttons);
-    game.get<int8_t>("gControllerPads[0].stick_x") = this->stick_x;
-    game.get<int8_t>("gControllerPads[0].stick_y") = this->stick_y;
+    game.inputs().apply(*this);
   }
 
   void m64::dump(fs::path path) {
-    auto dump_int32 = [](uint32_t x, char* p) {
-      // Narrowing conversion takes the lowest byte
-      p[0] = x;
-      x >>= 8;
-      p[1] = x;
-      x >>= 8;
-      p[2] = x;
-      x >>= 8;
-      p[3] = x;
-    };
-    auto dump_int16 = [](uint16_t x, char* p) {
-      // Narrowing conversion takes the lowest byte
-      p[0] = x;
-      x >>= 8;
-      p[1] = x;
-    };
-    auto dump_str = [](string x, char* p, unsigned bytes) {
-      // Truncate if needed
-      if (x.length() + 1 > bytes)
-        x.resize(bytes - 1);
-      for (size_t i = 0; i < x.length(); i++) {
-        p[i] = x[i];
-      }
-      p[x.length()] = '\0';
-    };
-
-    std::ofstream out         = std::ofstream(path, ios::out | ios::binary);
-    unique_ptr<char[]> buffer = unique_ptr<char[]>(new char[1024]);
+    std::vector<char> buffer(m64_offs::start_of_data + m_inputs.size() * 4);
     // Metadata
-    std::copy(M64_SIG.begin(), M64_SIG.end(), &buffer[m64_offs::signature]);
-
-    dump_int32(metadata.version, &buffer[m64_offs::version]);
-    dump_int32(metadata.timestamp, &buffer[m64_offs::timestamp]);
-    dump_int32(metadata.num_vis, &buffer[m64_offs::num_vis]);
-    dump_int32(metadata.rerecords, &buffer[m64_offs::rerecords]);
-    buffer[m64_offs::vis_per_s]       = metadata.vis_per_s;
-    buffer[m64_offs::num_controllers] = metadata.num_controllers;
-    dump_int32(metadata.num_input_frames(), &buffer[m64_offs::num_input_frames]);
+    dump_header(metadata, metadata.num_input_frames(), &buffer[0]);
     
-    dump_int16(
-      static_cast<uint16_t>(metadata.start_type), &buffer[m64_offs::start_type]);
-    dump_int32(static_cast<uint32_t>(metadata.controllers), &buffer[m64_offs::controllers]);
+    // Inputs
+    for (size_t i = 0; i < m_inputs.size(); i++) {
+      dump_frame(m_inputs[i], &buffer[m64_offs::start_of_data + i * 4]);
+    }
+    atomic_write(path, buffer);
+  }
+  
+  m64_writer::m64_writer(
+    fs::path path, const m64::metadata_s& mdata, options opts) :
+    m_path(std::move(path)), m_file(nullptr), m_size(0), m_opts(opts) {
+    m_file = std::fopen(m_path.string().c_str(), "w+b");
+    if (m_file == nullptr) {
+      stringstream fmt;
+      fmt << "Could not open " << m_path << " for writing";
+      throw std::runtime_error(fmt.str());
+    }
     
-    dump_str(metadata.rom_name, &buffer[m64_offs::rom_name], 32);
-    dump_int32(metadata.crc, &buffer[m64_offs::crc]);
-    dump_int32(metadata.country_code, &buffer[m64_offs::country_code]);
+    char header[1024] {};
+    dump_header(mdata, 0, header);
+    if (std::fwrite(header, 1, 1024, m_file) != 1024) {
+      std::fclose(m_file);
+      throw std::runtime_error("Failed to write M64 header");
+    }
+    std::fflush(m_file);
+    m_buffer.reserve(size_t(m_opts.flush_interval) * 4);
+  }
+  
+  m64_writer::m64_writer(fs::path path, const m64::metadata_s& mdata) :
+    m64_writer(std::move(path), mdata, options()) {}
+  
+  m64_writer::m64_writer(fs::path path, const m64& base, options opts) :
+    m64_writer(std::move(path), base.metadata, opts) {
+    append(base.begin(), base.end());
+  }
+  
+  m64_writer::m64_writer(fs::path path, const m64& base) :
+    m64_writer(std::move(path), base, options()) {}
+  
+  m64_writer::m64_writer(fs::path path, options opts) :
+    m_path(std::move(path)), m_file(nullptr), m_size(0), m_opts(opts) {
+    m_file = std::fopen(m_path.string().c_str(), "r+b");
+    if (m_file == nullptr) {
+      stringstream fmt;
+      fmt << m_path << " isn't a file or it doesn't exist";
+      throw invalid_m64(fmt.str());
+    }
     
-    dump_str(metadata.video_plugin, &buffer[m64_offs::video_plugin], 64);
-    dump_str(metadata.sound_plugin, &buffer[m64_offs::sound_plugin], 64);
-    dump_str(metadata.input_plugin, &buffer[m64_offs::input_plugin], 64);
-    dump_str(metadata.rsp_plugin, &buffer[m64_offs::rsp_plugin], 64);
+    char header[1024];
+    if (
+      std::fread(header, 1, 1024, m_file) != 1024 ||
+      !std::equal(M64_SIG.begin(), M64_SIG.end(), &header[0])) {
+      std::fclose(m_file);
+      stringstream fmt;
+      fmt << "File " << m_path << " isn't a valid M64, signature should be \"M64\\x1A\"";
+      throw invalid_m64(fmt.str());
+    }
+    m_size = read_u32(&header[m64_offs::num_input_frames]);
+    m_buffer.reserve(size_t(m_opts.flush_interval) * 4);
+  }
+  
+  m64_writer::~m64_writer() {
+    try {
+      flush();
+    }
+    catch (...) {
+      // destructors shouldn't throw, the file is still valid up to the last
+      // successful flush
+    }
+    std::fclose(m_file);
+  }
+  
+  void m64_writer::push_back(const frame& frame) {
+    if (size() == numeric_limits<uint32_t>::max()) {
+      throw out_of_range("An .m64 cannot be longer than 2^32 - 1 frames");
+    }
+    size_t off = m_buffer.size();
+    m_buffer.resize(off + 4);
+    dump_frame(frame, &m_buffer[off]);
     
-    dump_str(metadata.authors, &buffer[m64_offs::authors], 222);
-    dump_str(metadata.description, &buffer[m64_offs::description], 256);
-
-    out.seekp(0, ios::beg);
-    out.write(&buffer[0], 1024);
+    if (m_opts.flush_interval != 0 && m_buffer.size() / 4 >= m_opts.flush_interval)
+      flush();
+  }
+  
+  void m64_writer::flush() {
+    if (m_buffer.empty())
+      return;
     
-    // Inputs
-    size_t input_size = m_inputs.size() * 4;
-    buffer.reset(new char[input_size]);
-    for (size_t i = 0, j = 0; i < m_inputs.size(); j = (++i * 4)) {
-      buffer[j]     = static_cast<uint16_t>(m_inputs[i].buttons);
-      buffer[j + 1] = static_cast<uint16_t>(m_inputs[i].buttons) >> 8;
-      buffer[j + 2] = m_inputs[i].stick_x;
-      buffer[j + 3] = m_inputs[i].stick_y;
+    // Frames first: until the header is patched they're past the end of the
+    // movie, so a crash here leaves the previous flush intact.
+    uint64_t off = uint64_t(m64_offs::start_of_data) + uint64_t(m_size) * 4;
+    if (
+      !seek_to(m_file, off) ||
+      std::fwrite(m_buffer.data(), 1, m_buffer.size(), m_file) != m_buffer.size() ||
+      std::fflush(m_file) != 0) {
+      throw std::runtime_error("Failed to write M64 frames");
+    }
+    if (m_opts.sync == sync_policy::on_flush)
+      sync_file(m_file);
+    
+    uint32_t new_size = size();
+    char count[4];
+    dump_u32(new_size, count);
+    if (
+      !seek_to(m_file, m64_offs::num_input_frames) ||
+      std::fwrite(count, 1, 4, m_file) != 4 || std::fflush(m_file) != 0) {
+      throw std::runtime_error("Failed to patch M64 header");
+    }
+    if (m_opts.sync == sync_policy::on_flush)
+      sync_file(m_file);
+    
+    m_size = new_size;
+    m_buffer.clear();
+  }
+  
+  void m64_writer::checkpoint(const fs::path& dest) {
+    flush();
+    
+    // only copy the committed part of the file
+    uint64_t size = uint64_t(m64_offs::start_of_data) + uint64_t(m_size) * 4;
+    if (size > numeric_limits<size_t>::max()) {
+      throw std::runtime_error("M64 is too large to checkpoint");
+    }
+    std::vector<char> bytes(size);
+    if (
+      !seek_to(m_file, 0) ||
+      std::fread(bytes.data(), 1, bytes.size(), m_file) != bytes.size()) {
+      throw std::runtime_error("Failed to read M64 for checkpoint");
     }
-    out.seekp(m64_offs::start_of_data, ios::beg);
-    out.write(&buffer[0], input_size);
+    atomic_write(dest, bytes, m_opts.sync != sync_policy::none);
   }
-}  // namespace pancake
\ No newline at end of file
+}  // namespace pancake
@@ -0,0 +1,151 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#include <pancake/objects.hpp>
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include <pancake/exception.hpp>
+#include <pancake/expr/compile.hpp>
+#include <pancake/expr/parse.hpp>
+#include <pancake/sm64.hpp>
+
+using std::string;
+
+namespace {
+  namespace dwarf = pancake::dwarf;
+  namespace expr  = pancake::expr;
+
+  // Compiles an expression that must not follow any pointers, and returns
+  // it along with its offset from its symbol.
+  std::pair<expr::expr_eval, size_t> resolve(
+    dwarf::debug& dbg, const string& text) {
+    expr::expr_eval eval = expr::compile(expr::parse(text), dbg);
+    intptr_t off         = 0;
+    for (auto& step : eval.steps) {
+      if (!std::holds_alternative<expr::expr_eval::offset>(step)) {
+        throw pancake::type_error(text + " follows a pointer");
+      }
+      off += std::get<expr::expr_eval::offset>(step).off;
+    }
+    return {std::move(eval), size_t(off)};
+  }
+
+  template <typename T>
+  void read_column(
+    std::vector<double>& col, const std::vector<uint16_t>& slots,
+    const char* pool, size_t stride, size_t offset) {
+    col.resize(slots.size());
+    for (size_t i = 0; i < slots.size(); i++) {
+      col[i] = double(
+        *reinterpret_cast<const T*>(pool + slots[i] * stride + offset));
+    }
+  }
+}  // namespace
+
+namespace pancake {
+  const std::vector<double>& object_snapshot::column(const string& field) const {
+    for (size_t i = 0; i < fields.size(); i++) {
+      if (fields[i] == field)
+        return columns[i];
+    }
+    throw std::out_of_range(field + " is not in this snapshot");
+  }
+
+  object_query::object_query(
+    sm64& game, const std::vector<string>& fields, const string& behavior) :
+    m_filter(nullptr), m_names(fields) {
+    dwarf::debug& dbg = game.get_debug_info();
+    dl::library& lib  = game.get_lib();
+
+    {
+      auto [pool, off] = resolve(dbg, "gObjectPool[*]");
+      m_pool     = static_cast<const char*>(lib.get_symbol(pool.start)) + off;
+      m_stride   = size_t(pool.span->stride);
+      m_capacity = pool.span->count;
+    }
+    {
+      auto [lists, off] = resolve(dbg, "gObjectListArray[*]");
+      const char* base =
+        static_cast<const char*>(lib.get_symbol(lists.start)) + off;
+      m_lists.reserve(lists.span->count);
+      for (size_t i = 0; i < lists.span->count; i++)
+        m_lists.push_back(base + i * size_t(lists.span->stride));
+    }
+    m_header = resolve(dbg, "gObjectPool[0].header").second;
+    m_next   = resolve(dbg, "gObjectPool[0].header.next").second - m_header;
+
+    {
+      auto [flags, off] = resolve(dbg, "gObjectPool[0].activeFlags");
+      if (flags.result != dwarf::get_type_info<int16_t>()) {
+        throw type_error("Object::activeFlags is not an s16");
+      }
+      m_active_flags = off;
+    }
+    m_behavior = resolve(dbg, "gObjectPool[0].behavior").second;
+    if (!behavior.empty())
+      m_filter = lib.get_symbol(behavior);
+
+    m_fields.reserve(fields.size());
+    for (auto& name : fields) {
+      auto [eval, off] = resolve(dbg, "gObjectPool[0]." + name);
+      if (eval.span) {
+        throw std::invalid_argument(name + " selects several elements");
+      }
+      if (eval.result.encoding == dwarf::encoding::none) {
+        throw type_error(name + " does not refer to a fundamental type");
+      }
+      m_fields.push_back(field {off, eval.result});
+    }
+  }
+
+  void object_query::run(object_snapshot& out) const {
+    out.slots.clear();
+    for_each([&](size_t slot, const char*) {
+      out.slots.push_back(uint16_t(slot));
+    });
+    out.fields = m_names;
+    out.columns.resize(m_fields.size());
+
+    // one type switch per column, not per value
+    for (size_t f = 0; f < m_fields.size(); f++) {
+      std::vector<double>& col = out.columns[f];
+      const field& fd          = m_fields[f];
+      auto read = [&](auto tag) {
+        read_column<decltype(tag)>(col, out.slots, m_pool, m_stride, fd.offset);
+      };
+      switch (fd.type.encoding) {
+        case dwarf::encoding::floating_point:
+          if (fd.type.size == 4)
+            read(float());
+          else
+            read(double());
+          break;
+        case dwarf::encoding::signed_int:
+        case dwarf::encoding::signed_char:
+          switch (fd.type.size) {
+            case 1: read(int8_t()); break;
+            case 2: read(int16_t()); break;
+            case 4: read(int32_t()); break;
+            default: read(int64_t()); break;
+          }
+          break;
+        default:
+          switch (fd.type.size) {
+            case 1: read(uint8_t()); break;
+            case 2: read(uint16_t()); break;
+            case 4: read(uint32_t()); break;
+            default: read(uint64_t()); break;
+          }
+          break;
+      }
+    }
+  }
+}  // namespace pancake
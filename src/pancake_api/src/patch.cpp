@@ -0,0 +1,21 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#include <pancake/patch.hpp>
+
+#include <string>
+#include <vector>
+
+#include <pancake/sm64.hpp>
+
+namespace pancake {
+  write_patch::write_patch(sm64& game, const std::vector<std::string>& fields) {
+    m_fields.reserve(fields.size());
+    for (auto& field : fields) {
+      m_fields.push_back(game.compile(field));
+    }
+  }
+}  // namespace pancake
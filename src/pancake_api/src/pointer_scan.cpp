@@ -0,0 +1,262 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#include <pancake/pointer_scan.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <pancake/dl/pdl.hpp>
+
+using std::string;
+
+namespace {
+  // Something in memory reached by a path, and the type it has there.
+  struct object {
+    uintptr_t addr;
+    uint32_t type;
+    // set if the path is a pointer to a struct, whose members need ->
+    bool arrow;
+    string path;
+    // other paths that reached it in the same round; the object is only
+    // walked once, through `path`
+    std::vector<string> aliases;
+  };
+
+  using object_key = std::pair<uintptr_t, uint32_t>;
+
+  struct object_key_hash {
+    size_t operator()(const object_key& key) const {
+      return std::hash<uintptr_t>()(key.first) * 31 + key.second;
+    }
+  };
+}  // namespace
+
+namespace pancake {
+  pointer_scan::pointer_scan(sm64& game, const address_index& index) :
+    m_game(game), m_index(index) {
+    dl::library& lib = game.get_lib();
+    for (const char* name : {".data", ".bss"}) {
+      dl::section sect = lib.get_section(name);
+      uintptr_t begin  = reinterpret_cast<uintptr_t>(sect.ptr);
+      m_memory.emplace_back(begin, begin + sect.size);
+    }
+    std::sort(m_memory.begin(), m_memory.end());
+
+    using type_node = address_index::type_node;
+    auto& types     = m_index.m_types;
+    m_has_pointer.assign(types.size(), false);
+    auto settle = [&](size_t i) {
+      const type_node& t = types[i];
+      switch (t.kind) {
+        case type_node::scalar:
+          m_has_pointer[i] = t.base.encoding == dwarf::encoding::address &&
+            t.pointee != address_index::npos && types[t.pointee].size > 0;
+          break;
+        case type_node::array:
+          m_has_pointer[i] = t.count > 0 && m_has_pointer[t.elem];
+          break;
+        case type_node::record:
+          m_has_pointer[i] = std::any_of(
+            t.members.begin(), t.members.end(),
+            [&](const address_index::member& m) {
+              return m_has_pointer[m.type];
+            });
+          break;
+      }
+    };
+    // records are added before their members, so one pass in order isn't
+    // enough; repeat until nothing changes
+    for (bool changed = true; changed;) {
+      changed = false;
+      for (size_t i = 0; i < types.size(); i++) {
+        bool before = m_has_pointer[i];
+        settle(i);
+        changed |= (before != m_has_pointer[i]);
+      }
+    }
+  }
+
+  bool pointer_scan::readable(uintptr_t addr, size_t size) const {
+    for (auto& [begin, end] : m_memory) {
+      if (addr >= begin && addr < end)
+        return end - addr >= size;
+    }
+    return false;
+  }
+
+  std::vector<pointer_path> pointer_scan::find(
+    const void* target_p, size_t max_depth, size_t threads) const {
+    using type_node = address_index::type_node;
+    auto& types      = m_index.m_types;
+    uintptr_t target = reinterpret_cast<uintptr_t>(target_p);
+    if (threads == 0)
+      threads = std::max<unsigned>(std::thread::hardware_concurrency(), 1);
+
+    std::unordered_set<object_key, object_key_hash> seen;
+    std::vector<object> round;
+    for (auto& sym : m_index.symbols()) {
+      if (sym.is_function || sym.type == address_index::npos)
+        continue;
+      if (seen.emplace(sym.begin, sym.type).second)
+        round.push_back(object {sym.begin, sym.type, false, sym.name, {}});
+    }
+
+    std::vector<pointer_path> res;
+    for (size_t depth = 0; !round.empty(); depth++) {
+      struct output {
+        std::vector<pointer_path> hits;
+        std::vector<object> next;
+      };
+      std::vector<output> outputs(threads);
+      std::exception_ptr error;
+      std::mutex error_lock;
+
+      auto work = [&](size_t tid) {
+        output& out = outputs[tid];
+        string path;
+        // Collects the pointers in an object, writing each one's path into
+        // `path` while it's being visited.
+        auto walk = [&](auto& self, uintptr_t addr, uint32_t node,
+                        const char* sep) -> void {
+          const type_node& t = types[node];
+          switch (t.kind) {
+            case type_node::scalar: {
+              uintptr_t value;
+              std::memcpy(
+                &value, reinterpret_cast<const void*>(addr), sizeof(value));
+              const type_node& pointee = types[t.pointee];
+              if (value == 0 || !readable(value, pointee.size))
+                break;
+              // pointers to anything but structs need an explicit [0]
+              bool arrow = pointee.kind == type_node::record;
+              out.next.push_back(object {
+                value, t.pointee, arrow, arrow ? path : path + "[0]", {}});
+            } break;
+            case type_node::array: {
+              size_t elem_size = types[t.elem].size;
+              size_t len       = path.size();
+              for (size_t i = 0; i < t.count; i++) {
+                path += '[' + std::to_string(i) + ']';
+                self(self, addr + i * elem_size, t.elem, ".");
+                path.resize(len);
+              }
+            } break;
+            case type_node::record: {
+              size_t len = path.size();
+              for (auto& m : t.members) {
+                if (!m_has_pointer[m.type])
+                  continue;
+                // members of anonymous structs and unions are named directly
+                if (!m.name.empty()) {
+                  path += sep;
+                  path += m.name;
+                }
+                const char* next = m.name.empty() ? sep : ".";
+                self(self, addr + m.offset, m.type, next);
+                path.resize(len);
+              }
+            } break;
+          }
+        };
+
+        try {
+          for (size_t i = tid; i < round.size(); i += threads) {
+            const object& obj  = round[i];
+            const type_node& t = types[obj.type];
+
+            if (target >= obj.addr && target - obj.addr < t.size) {
+              size_t offset = target - obj.addr;
+              string suffix;
+              dwarf::base_type_info type;
+              m_index.descend(obj.type, offset, suffix, type);
+              if (obj.arrow && !suffix.empty() && suffix[0] == '.')
+                suffix = "->" + suffix.substr(1);
+              else if (obj.arrow)
+                suffix = "[0]" + suffix;
+              if (offset == 0) {
+                out.hits.push_back(pointer_path {obj.path + suffix, depth});
+                for (auto& alias : obj.aliases)
+                  out.hits.push_back(pointer_path {alias + suffix, depth});
+              }
+            }
+
+            if (depth < max_depth && m_has_pointer[obj.type]) {
+              path = obj.path;
+              walk(walk, obj.addr, obj.type, obj.arrow ? "->" : ".");
+            }
+          }
+        }
+        catch (...) {
+          std::lock_guard<std::mutex> guard(error_lock);
+          if (!error)
+            error = std::current_exception();
+        }
+      };
+
+      std::vector<std::thread> pool;
+      pool.reserve(threads);
+      for (size_t tid = 0; tid < threads; tid++)
+        pool.emplace_back(work, tid);
+      for (auto& t : pool)
+        t.join();
+      if (error)
+        std::rethrow_exception(error);
+
+      round.clear();
+      std::unordered_map<object_key, size_t, object_key_hash> reached;
+      for (auto& out : outputs) {
+        std::move(out.hits.begin(), out.hits.end(), std::back_inserter(res));
+        for (auto& obj : out.next) {
+          object_key key {obj.addr, obj.type};
+          if (seen.insert(key).second) {
+            reached.emplace(key, round.size());
+            round.push_back(std::move(obj));
+          }
+          else if (auto it = reached.find(key); it != reached.end()) {
+            round[it->second].aliases.push_back(std::move(obj.path));
+          }
+        }
+      }
+    }
+
+    // the paths are built from the index, not by the expression compiler, so
+    // make sure each one really leads back to the target
+    res.erase(
+      std::remove_if(
+        res.begin(), res.end(),
+        [&](const pointer_path& hit) {
+          try {
+            return m_game.get_unsafe(hit.path) != target_p;
+          }
+          catch (const std::exception&) {
+            return true;
+          }
+        }),
+      res.end());
+
+    std::sort(
+      res.begin(), res.end(),
+      [](const pointer_path& a, const pointer_path& b) {
+        if (a.depth != b.depth)
+          return a.depth < b.depth;
+        if (a.path.size() != b.path.size())
+          return a.path.size() < b.path.size();
+        return a.path < b.path;
+      });
+    return res;
+  }
+}  // namespace pancake
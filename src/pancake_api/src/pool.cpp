@@ -0,0 +1,131 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#include <pancake/pool.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include <pancake/sm64.hpp>
+
+namespace fs = std::filesystem;
+
+namespace pancake {
+  namespace details {
+    work_stealer::work_stealer(size_t n, size_t workers) :
+      m_shares(new share[std::max<size_t>(workers, 1)]),
+      m_workers(std::max<size_t>(workers, 1)) {
+      for (size_t i = 0; i < m_workers; i++) {
+        m_shares[i].begin = n * i / m_workers;
+        m_shares[i].end   = n * (i + 1) / m_workers;
+      }
+    }
+
+    bool work_stealer::next(size_t worker, size_t& item) {
+      share& own = m_shares[worker];
+      while (true) {
+        {
+          std::lock_guard<std::mutex> guard(own.lock);
+          if (own.begin < own.end) {
+            item = own.begin++;
+            return true;
+          }
+        }
+
+        // Own share is empty, find the largest one and take its back half.
+        size_t victim = m_workers, most = 0;
+        for (size_t i = 0; i < m_workers; i++) {
+          if (i == worker)
+            continue;
+          std::lock_guard<std::mutex> guard(m_shares[i].lock);
+          size_t left = m_shares[i].end - m_shares[i].begin;
+          if (left > most) {
+            most   = left;
+            victim = i;
+          }
+        }
+        if (victim == m_workers)
+          return false;
+
+        // Lock both in a fixed order to avoid deadlocking with a thief
+        // stealing in the other direction.
+        share& other = m_shares[victim];
+        std::unique_lock<std::mutex> first(
+          (victim < worker) ? other.lock : own.lock);
+        std::unique_lock<std::mutex> second(
+          (victim < worker) ? own.lock : other.lock);
+        size_t left = other.end - other.begin;
+        if (left == 0)
+          continue;
+        size_t take = (left + 1) / 2;
+        own.begin   = other.end - take;
+        own.end     = other.end;
+        other.end  -= take;
+      }
+    }
+  }  // namespace details
+
+  sm64_pool::sm64_pool(const fs::path& path, size_t count) {
+    if (count == 0)
+      count = std::max<unsigned>(std::thread::hardware_concurrency(), 1);
+
+    std::stringstream token;
+    token << std::hex << std::random_device()();
+
+    try {
+      for (size_t i = 0; i < count; i++) {
+        fs::path copy = fs::temp_directory_path() /
+          ("pancake-" + token.str() + "-" + std::to_string(i) +
+           path.extension().string());
+        fs::copy_file(path, copy, fs::copy_options::overwrite_existing);
+        m_paths.push_back(copy);
+        m_games.emplace_back(new sm64(copy));
+      }
+    }
+    catch (...) {
+      m_games.clear();
+      std::error_code ec;
+      for (auto& p : m_paths)
+        fs::remove(p, ec);
+      throw;
+    }
+  }
+
+  sm64_pool::~sm64_pool() {
+    // unload everything before deleting the files
+    m_games.clear();
+    std::error_code ec;
+    for (auto& p : m_paths)
+      fs::remove(p, ec);
+  }
+
+  sm64_pool::savestate sm64_pool::alloc_svst() const {
+    savestate result;
+    result.m_states.reserve(m_games.size());
+    for (auto& game : m_games)
+      result.m_states.push_back(game->alloc_svst());
+    return result;
+  }
+
+  void sm64_pool::savestate::save() {
+    for (auto& st : m_states)
+      st.save();
+  }
+
+  void sm64_pool::savestate::load() const {
+    for (auto& st : m_states)
+      st.load();
+  }
+}  // namespace pancake
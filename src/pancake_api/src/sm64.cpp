@@ -1,22 +1,29 @@
 #include "pancake/dwarf/types.hpp"
 #include "pancake/expr/parse.hpp"
 #include "pancake/movie.hpp"
+#include "pancake/stx/hash_bytes.hpp"
 #include "pancake/stx/overload.hpp"
 #include <pancake/sm64.hpp>
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
+#include <cstring>
 #include <memory>
 #include <stdexcept>
 #include <string>
 #include <filesystem>
+#include <fstream>
+#include <iterator>
 #include <unordered_map>
+#include <utility>
 #include <variant>
 #include <vector>
 
 #include <gsl/span>
 
 #include <pancake/dl/pdl.hpp>
+#include <pancake/dwarf/layout.hpp>
 #include <pancake/dwarf/types.hpp>
 #include <pancake/expr/compile.hpp>
 
@@ -24,20 +31,141 @@ using std::string;
 namespace fs = std::filesystem;
 
 namespace {
-  struct expr_info {
-    void* ptr;
-    pancake::dwarf::base_type_info type;
-  };
-}
+  namespace dwarf = pancake::dwarf;
+
+  // Compares base types, treating chars and bools as the integers they are.
+  bool same_type(dwarf::base_type_info a, dwarf::base_type_info b) {
+    auto normalise = [](dwarf::encoding e) {
+      switch (e) {
+        case dwarf::encoding::signed_char: return dwarf::encoding::signed_int;
+        case dwarf::encoding::unsigned_char:
+        case dwarf::encoding::boolean: return dwarf::encoding::unsigned_int;
+        default: return e;
+      }
+    };
+    return a.size == b.size && normalise(a.encoding) == normalise(b.encoding);
+  }
+
+  // Lists the byte ranges in [0, size) that none of a mirror's fields cover.
+  std::vector<std::pair<size_t, size_t>> gaps(
+    const std::vector<pancake::struct_field>& fields, size_t size) {
+    std::vector<std::pair<size_t, size_t>> ranges, res;
+    for (auto& field : fields) {
+      ranges.emplace_back(
+        field.offset, field.offset + field.type.size * field.count);
+    }
+    std::sort(ranges.begin(), ranges.end());
+    size_t end = 0;
+    for (auto& [begin, stop] : ranges) {
+      if (begin > end && end < size)
+        res.emplace_back(end, std::min(begin, size));
+      end = std::max(end, stop);
+    }
+    if (end < size)
+      res.emplace_back(end, size);
+    return res;
+  }
+
+  // Checks a mirror type's fields against a type from the debug info.
+  // Returns true if every byte the mirror leaves out is padding in the game,
+  // so that writing the whole mirror back can't clobber a member.
+  bool check_layout(
+    const std::string& expr, dwarf::die type,
+    const std::vector<pancake::struct_field>& fields, size_t size) {
+    using pancake::type_error;
+    auto fail = [&](const std::string& what) {
+      throw type_error("Mirror of " + expr + " doesn't match: " + what);
+    };
+
+    auto holes = gaps(fields, size);
+    switch (type.tag()) {
+      case dwarf::die_tag::array_type: {
+        dwarf::die_tag tag;
+        auto [info, count] = dwarf::flatten_type(type, tag);
+        if (fields.size() != 1 || fields[0].name[0] != '\0')
+          fail("it is an array, so mirror it with std::array");
+        if (!same_type(fields[0].type, info))
+          fail("element types differ");
+        if (fields[0].count > count)
+          fail("the mirror has more elements than the array");
+        return holes.empty();
+      }
+      case dwarf::die_tag::structure_type:
+      case dwarf::die_tag::union_type: {
+        dwarf::record_layout record = dwarf::read_record(type);
+        if (size > record.size) {
+          fail(
+            "the mirror is " + std::to_string(size) + " bytes but the struct is " +
+            std::to_string(record.size));
+        }
+        for (auto& field : fields) {
+          auto member = std::find_if(
+            record.members.begin(), record.members.end(),
+            [&](const dwarf::member_layout& m) { return m.name == field.name; });
+          if (member == record.members.end())
+            fail(string("there is no member ") + field.name);
+          if (member->offset != field.offset) {
+            fail(
+              string(field.name) + " is at offset " +
+              std::to_string(field.offset) + " in the mirror but " +
+              std::to_string(member->offset) + " in the game");
+          }
+          if (!same_type(member->type, field.type) || member->count != field.count)
+            fail(string(field.name) + " has a different type");
+        }
+        for (auto& [begin, end] : holes) {
+          for (auto& m : record.members) {
+            const size_t m_end = m.offset + m.type.size * m.count;
+            if (m.offset < end && begin < m_end)
+              return false;
+          }
+        }
+        return true;
+      }
+      default: {
+        fail("it is not a struct, union or array");
+      }
+    }
+    return false;
+  }
+
+  // Follows a compiled expression's steps from its global.
+  uint8_t* walk(pancake::dl::library& lib, const pancake::expr::expr_eval& eval) {
+    namespace expr = pancake::expr;
+    uint8_t* ptr = static_cast<uint8_t*>(lib.get_symbol(eval.start));
+    for (auto& step: eval.steps) {
+      std::visit(stx::overload {
+        [&](expr::expr_eval::offset step) mutable {
+          ptr += step.off;
+        },
+        [&](expr::expr_eval::indirect step) mutable {
+          ptr = *reinterpret_cast<uint8_t**>(ptr);
+        }
+      }, step);
+    }
+    return ptr;
+  }
+}  // namespace
 
 namespace pancake {
   sm64::sm64(const fs::path& path) :
-    lib(path), dbg(path) {
+    m_path(path), lib(path), dbg(path) {
     lib.get_symbol<void()>("sm64_init")();
+    m_update = &lib.get_symbol<void()>("sm64_update");
+    m_input.reset(new input_sink(*this));
+  }
+  
+  sm64::input_sink::input_sink(sm64& game) {
+    for (size_t i = 0; i < pads.size(); i++) {
+      string base = "gControllerPads[" + std::to_string(i) + "]";
+      pads[i]     = pad {
+        &game.get<uint16_t>(base + ".button"),
+        &game.get<int8_t>(base + ".stick_x"),
+        &game.get<int8_t>(base + ".stick_y")};
+    }
   }
   
   void* sm64::_impl_get(const string& expr, pancake::dwarf::base_type_info type) {
-    static std::unordered_map<string, expr_info> cache;
     {
       decltype(cache)::iterator it;
       if ((it = cache.find(expr)) != cache.end()) {
@@ -50,19 +178,13 @@ namespace pancake {
     }
 
     expr::expr_eval eval = expr::compile(expr::parse(expr), dbg);
-    
-    uint8_t* ptr = static_cast<uint8_t*>(lib.get_symbol(eval.start));
-    for (auto& step: eval.steps) {
-      std::visit(stx::overload {
-        [&](expr::expr_eval::offset step) mutable {
-          ptr += step.off;
-        },
-        [&](expr::expr_eval::indirect step) mutable {
-          ptr = *reinterpret_cast<uint8_t**>(ptr);
-        }
-      }, step);
+    if (eval.span) {
+      throw std::invalid_argument(
+        expr + " selects several elements; use get_span() instead");
     }
     
+    uint8_t* ptr = walk(lib, eval);
+    
     cache[expr] = expr_info {
       ptr, eval.result
     };
@@ -74,12 +196,83 @@ namespace pancake {
     return ptr;
   }
   
+  stx::strided_span<char> sm64::_impl_get_span(
+    const string& expr, dwarf::base_type_info type) {
+    expr::expr_eval eval = expr::compile(expr::parse(expr), dbg);
+    if (!eval.span) {
+      throw std::invalid_argument(expr + " has no slice");
+    }
+    if (type != eval.result) {
+      throw type_error(expr + " does not match the requested type");
+    }
+    
+    uint8_t* ptr = walk(lib, eval);
+    return stx::strided_span<char>(
+      reinterpret_cast<char*>(ptr), eval.span->count, eval.span->stride);
+  }
+  
+  void* sm64::_impl_get_struct(
+    const string& expr, const char* key, size_t size, size_t align,
+    std::vector<struct_field> (*fields)(), bool writable) {
+    auto check_writable = [&](const struct_info& info) {
+      if (writable && !info.complete) {
+        throw type_error(
+          "Mirror of " + expr +
+          " leaves out members, which writes would overwrite; list them or "
+          "use view_struct()");
+      }
+      return info.ptr;
+    };
+    string cache_key = expr + '\n' + key;
+    {
+      auto it = struct_cache.find(cache_key);
+      if (it != struct_cache.end())
+        return check_writable(it->second);
+    }
+    
+    expr::expr_eval eval = expr::compile(expr::parse(expr), dbg);
+    if (eval.span) {
+      throw std::invalid_argument(
+        expr + " selects several elements; use get_span() instead");
+    }
+    std::vector<struct_field> list = fields();
+    bool complete =
+      check_layout(expr, dwarf::strip_typedefs(*eval.result_die), list, size);
+    
+    uint8_t* ptr = walk(lib, eval);
+    if (reinterpret_cast<uintptr_t>(ptr) % align != 0) {
+      throw type_error(expr + " is not aligned for its mirror type");
+    }
+    struct_info info {ptr, complete};
+    struct_cache.emplace(cache_key, info);
+    return check_writable(info);
+  }
+  
+  sm64::accessor sm64::compile(const string& expr) {
+    void* ptr = _impl_get(expr);
+    const expr_info& info = cache.at(expr);
+    if (info.type.encoding == dwarf::encoding::none) {
+      throw type_error(expr + " does not refer to a fundamental type");
+    }
+    return accessor {ptr, info.type};
+  }
+  
   sm64::savestate sm64::alloc_svst() const {
     return sm64::savestate(*this);
   }
   
-  void sm64::advance() {
-    lib.get_symbol<void()>("sm64_update");
+  dl::library& sm64::get_lib() {
+    return lib;
+  }
+  
+  uint64_t sm64::build_id() const {
+    std::ifstream file(m_path, std::ios::binary);
+    std::vector<char> data(
+      (std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (file.bad()) {
+      throw std::runtime_error("Failed to read " + m_path.string());
+    }
+    return stx::hash_bytes(data.data(), data.size());
   }
   
   dwarf::debug& sm64::get_debug_info() {
@@ -120,12 +313,29 @@ namespace pancake {
       std::copy(buffers[0].first.get(), buffers[0].first.get() + buffers[0].second, regions[0].begin());
       std::copy(buffers[1].first.get(), buffers[1].first.get() + buffers[1].second, regions[1].begin());
     }
+    
+    void load_changed() const {
+      constexpr size_t block = 4096;
+      for (size_t i = 0; i < 2; i++) {
+        char* dst = regions[i].data();
+        const char* src = buffers[i].first.get();
+        for (size_t off = 0; off < buffers[i].second; off += block) {
+          size_t len = std::min(block, buffers[i].second - off);
+          if (std::memcmp(dst + off, src + off, len) != 0)
+            std::memcpy(dst + off, src + off, len);
+        }
+      }
+    }
   };
   
   sm64::savestate::savestate(const sm64& game) {
     p_impl = std::make_unique<impl>(game);
   }
   
+  sm64::savestate::savestate(savestate&&) noexcept = default;
+  sm64::savestate& sm64::savestate::operator=(savestate&&) noexcept = default;
+  sm64::savestate::~savestate() = default;
+  
   void sm64::savestate::save() {
     p_impl->save();
   }
@@ -133,4 +343,23 @@ namespace pancake {
   void sm64::savestate::load() const {
     p_impl->load();
   }
+  
+  void sm64::savestate::load_changed() const {
+    p_impl->load_changed();
+  }
+  
+  size_t sm64::savestate::size() const {
+    return p_impl->buffers[0].second + p_impl->buffers[1].second;
+  }
+  
+  std::array<sm64::savestate::region, 2> sm64::savestate::regions() const {
+    std::array<region, 2> res;
+    for (size_t i = 0; i < 2; i++) {
+      res[i] = region {
+        p_impl->regions[i].data(), p_impl->buffers[i].first.get(),
+        p_impl->buffers[i].second
+      };
+    }
+    return res;
+  }
 }
\ No newline at end of file
@@ -0,0 +1,256 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#include <pancake/state_diff.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using std::string;
+
+namespace {
+  namespace dwarf = pancake::dwarf;
+  using range     = std::pair<size_t, size_t>;
+
+  void add_range(std::vector<range>& out, size_t begin, size_t end) {
+    if (!out.empty() && out.back().second == begin)
+      out.back().second = end;
+    else
+      out.emplace_back(begin, end);
+  }
+
+  void byte_ranges(
+    const char* x, const char* y, size_t begin, size_t end,
+    std::vector<range>& out) {
+    for (size_t i = begin; i < end;) {
+      if (x[i] == y[i]) {
+        i++;
+        continue;
+      }
+      size_t j = i + 1;
+      while (j < end && x[j] != y[j])
+        j++;
+      add_range(out, i, j);
+      i = j;
+    }
+  }
+
+  // Finds the byte ranges where two buffers differ. Whole 64-byte blocks
+  // are compared a word at a time, which the compiler vectorises; only
+  // blocks with a difference are scanned byte by byte.
+  void changed_ranges(
+    const char* x, const char* y, size_t size, std::vector<range>& out) {
+    constexpr size_t block = 64;
+    size_t off             = 0;
+    for (; off + block <= size; off += block) {
+      uint64_t acc = 0;
+      for (size_t k = 0; k < block; k += 8) {
+        uint64_t p, q;
+        std::memcpy(&p, x + off + k, 8);
+        std::memcpy(&q, y + off + k, 8);
+        acc |= p ^ q;
+      }
+      if (acc != 0)
+        byte_ranges(x, y, off, off + block, out);
+    }
+    byte_ranges(x, y, off, size, out);
+  }
+
+  uint64_t load(const char* ptr, size_t size) {
+    uint64_t res = 0;
+    std::memcpy(&res, ptr, size);
+    return res;
+  }
+
+  template <typename T>
+  void put(std::ostream& out, T value) {
+    char bytes[sizeof(T)];
+    for (size_t i = 0; i < sizeof(T); i++)
+      bytes[i] = char(uint64_t(value) >> (8 * i));
+    out.write(bytes, sizeof(T));
+  }
+
+  template <typename T>
+  T get(std::istream& in) {
+    unsigned char bytes[sizeof(T)];
+    if (!in.read(reinterpret_cast<char*>(bytes), sizeof(T)))
+      throw std::runtime_error("Savestate diff is truncated");
+    uint64_t res = 0;
+    for (size_t i = 0; i < sizeof(T); i++)
+      res |= uint64_t(bytes[i]) << (8 * i);
+    return T(res);
+  }
+
+  // Reads in pieces, so a corrupt length runs into the end of the stream
+  // rather than allocating it all up front.
+  std::string get_string(std::istream& in, uint32_t len) {
+    std::string res;
+    char buf[4096];
+    while (len > 0) {
+      const uint32_t n = std::min<uint32_t>(len, sizeof(buf));
+      if (!in.read(buf, n))
+        throw std::runtime_error("Savestate diff is truncated");
+      res.append(buf, n);
+      len -= n;
+    }
+    return res;
+  }
+
+  constexpr char diff_magic[4] = {'P', 'K', 'S', 'D'};
+  constexpr uint32_t diff_version = 1;
+}  // namespace
+
+namespace pancake {
+  double field_change::decode(uint64_t bits) const {
+    switch (type.encoding) {
+      case dwarf::encoding::floating_point:
+        if (type.size == 4) {
+          float res;
+          std::memcpy(&res, &bits, 4);
+          return res;
+        }
+        else {
+          double res;
+          std::memcpy(&res, &bits, 8);
+          return res;
+        }
+      case dwarf::encoding::signed_int:
+      case dwarf::encoding::signed_char: {
+        // sign-extend from the field's size
+        unsigned shift = unsigned(64 - 8 * type.size);
+        return double(int64_t(bits << shift) >> shift);
+      }
+      default: return double(bits);
+    }
+  }
+
+  void state_diff::write(std::ostream& out) const {
+    out.write(diff_magic, sizeof(diff_magic));
+    put<uint32_t>(out, diff_version);
+    put<uint32_t>(out, uint32_t(paths.size()));
+    for (auto& path : paths) {
+      put<uint32_t>(out, uint32_t(path.size()));
+      out.write(path.data(), path.size());
+    }
+    put<uint32_t>(out, uint32_t(changes.size()));
+    for (auto& change : changes) {
+      put<uint32_t>(out, change.path);
+      put<uint16_t>(out, change.region);
+      put<uint16_t>(out, change.size);
+      put<uint32_t>(out, change.offset);
+      put<uint16_t>(out, uint16_t(change.type.encoding));
+      put<uint8_t>(out, uint8_t(change.type.size));
+      put<uint64_t>(out, change.before);
+      put<uint64_t>(out, change.after);
+    }
+  }
+
+  state_diff state_diff::read(std::istream& in) {
+    char magic[sizeof(diff_magic)];
+    if (
+      !in.read(magic, sizeof(magic)) ||
+      std::memcmp(magic, diff_magic, sizeof(magic)) != 0) {
+      throw std::runtime_error("Not a savestate diff");
+    }
+    if (get<uint32_t>(in) != diff_version)
+      throw std::runtime_error("Unsupported savestate diff version");
+
+    state_diff res;
+    // counts come from the file, so entries are appended as they're read
+    const uint32_t npaths = get<uint32_t>(in);
+    for (uint32_t i = 0; i < npaths; i++)
+      res.paths.push_back(get_string(in, get<uint32_t>(in)));
+    const uint32_t nchanges = get<uint32_t>(in);
+    for (uint32_t i = 0; i < nchanges; i++) {
+      field_change change;
+      change.path   = get<uint32_t>(in);
+      change.region = get<uint16_t>(in);
+      change.size   = get<uint16_t>(in);
+      change.offset = get<uint32_t>(in);
+      change.type.encoding = dwarf::encoding(get<uint16_t>(in));
+      change.type.size     = get<uint8_t>(in);
+      change.before = get<uint64_t>(in);
+      change.after  = get<uint64_t>(in);
+      if (change.path >= res.paths.size() || change.size > 8)
+        throw std::runtime_error("Savestate diff is malformed");
+      // decode() shifts by the size, so it has to be a real one
+      if (
+        change.type.encoding != dwarf::encoding::none &&
+        (change.type.size < 1 || change.type.size > 8))
+        throw std::runtime_error("Savestate diff is malformed");
+      res.changes.push_back(change);
+    }
+    return res;
+  }
+
+  state_diff diff(
+    const sm64::savestate& a, const sm64::savestate& b,
+    const address_index& index) {
+    auto regions_a = a.regions();
+    auto regions_b = b.regions();
+
+    state_diff res;
+    std::unordered_map<string, uint32_t> path_ids;
+    auto intern = [&](string&& path) -> uint32_t {
+      auto [it, added] = path_ids.try_emplace(path, uint32_t(res.paths.size()));
+      if (added)
+        res.paths.push_back(std::move(path));
+      return it->second;
+    };
+
+    std::vector<range> ranges;
+    for (size_t r = 0; r < regions_a.size(); r++) {
+      const auto& ra = regions_a[r];
+      const auto& rb = regions_b[r];
+      if (ra.live != rb.live || ra.size != rb.size) {
+        throw std::invalid_argument("Savestates are from different games");
+      }
+
+      ranges.clear();
+      changed_ranges(ra.saved, rb.saved, ra.size, ranges);
+
+      auto emit = [&](size_t at, size_t size, dwarf::base_type_info type,
+                      string&& path) {
+        res.changes.push_back(field_change {
+          intern(std::move(path)), uint16_t(r), uint16_t(size), uint32_t(at),
+          type, load(ra.saved + at, size), load(rb.saved + at, size)});
+      };
+
+      // fields already reported, for ranges that end partway through one
+      size_t cursor = 0;
+      for (auto [begin, end] : ranges) {
+        for (size_t at = std::max(begin, cursor); at < end;) {
+          auto loc = index.lookup(ra.live + at);
+          if (
+            loc && loc->type.encoding != dwarf::encoding::none &&
+            loc->type.size > 0 && loc->type.size <= 8 && loc->offset <= at &&
+            at - loc->offset + loc->type.size <= ra.size) {
+            size_t start = at - loc->offset;
+            emit(start, loc->type.size, loc->type, std::move(loc->path));
+            at = start + loc->type.size;
+          }
+          else {
+            size_t len = std::min<size_t>(8, end - at);
+            emit(
+              at, len, dwarf::base_type_info {dwarf::encoding::none, len},
+              index.describe(ra.live + at));
+            at += len;
+          }
+          cursor = at;
+        }
+      }
+    }
+    return res;
+  }
+}  // namespace pancake
@@ -0,0 +1,184 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#include <pancake/stick_table.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <pancake/sm64.hpp>
+#include "atomic_write.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+  constexpr size_t num_sticks = 65536;
+  constexpr char cache_magic[8] = {'P', 'C', 'S', 'T', 'I', 'C', 'K', 1};
+
+  // Orders effects by magnitude, then yaw
+  bool effect_less(
+    const pancake::stick_table::effect& a,
+    const pancake::stick_table::effect& b) {
+    return (a.mag != b.mag) ? a.mag < b.mag : a.yaw < b.yaw;
+  }
+
+  void dump_effect(const pancake::stick_table::effect& e, char* p) {
+    uint32_t mag;
+    std::memcpy(&mag, &e.mag, 4);
+    p[0] = uint16_t(e.yaw);
+    p[1] = uint16_t(e.yaw) >> 8;
+    for (size_t i = 0; i < 4; i++)
+      p[2 + i] = mag >> (8 * i);
+  }
+
+  pancake::stick_table::effect read_effect(const char* p) {
+    uint32_t mag = 0;
+    for (size_t i = 0; i < 4; i++)
+      mag |= uint32_t(uint8_t(p[2 + i])) << (8 * i);
+    pancake::stick_table::effect e;
+    e.yaw = int16_t(uint16_t(uint8_t(p[0]) | (uint8_t(p[1]) << 8)));
+    std::memcpy(&e.mag, &mag, 4);
+    return e;
+  }
+}  // namespace
+
+namespace pancake {
+  stick_table::stick_table(std::vector<effect> effects) :
+    m_effects(std::move(effects)), m_class(num_sticks) {
+    // Members of a class end up adjacent, closest to the centre first.
+    std::vector<uint16_t> order(num_sticks);
+    std::iota(order.begin(), order.end(), 0);
+    auto dist = [](uint16_t i) {
+      stick s = unindex(i);
+      return int(s.x) * s.x + int(s.y) * s.y;
+    };
+    std::sort(order.begin(), order.end(), [&](uint16_t a, uint16_t b) {
+      const effect &ea = m_effects[a], &eb = m_effects[b];
+      if (ea != eb)
+        return effect_less(ea, eb);
+      if (dist(a) != dist(b))
+        return dist(a) < dist(b);
+      stick sa = unindex(a), sb = unindex(b);
+      return (sa.x != sb.x) ? sa.x < sb.x : sa.y < sb.y;
+    });
+
+    m_members = std::move(order);
+    for (size_t i = 0; i < num_sticks; i++) {
+      if (i == 0 || m_effects[m_members[i]] != m_effects[m_members[i - 1]])
+        m_offsets.push_back(uint32_t(i));
+      m_class[m_members[i]] = uint32_t(m_offsets.size() - 1);
+    }
+    m_offsets.push_back(uint32_t(num_sticks));
+  }
+
+  stick_table::stick_table(sm64& game) :
+    stick_table([&]() {
+      auto& adjust = game.get_symbol<void(void*)>("adjust_analog_stick");
+      auto& atan2s = game.get_symbol<int16_t(float, float)>("atan2s");
+      void* controller =
+        game.get_lib().get_symbol("gControllers");
+
+      int16_t& raw_x = game.get<int16_t>("gControllers[0].rawStickX");
+      int16_t& raw_y = game.get<int16_t>("gControllers[0].rawStickY");
+      float& stick_x = game.get<float>("gControllers[0].stickX");
+      float& stick_y = game.get<float>("gControllers[0].stickY");
+      float& mag     = game.get<float>("gControllers[0].stickMag");
+
+      const int16_t old_raw[2] = {raw_x, raw_y};
+      const float old_stick[3] = {stick_x, stick_y, mag};
+
+      std::vector<effect> result(num_sticks);
+      for (size_t i = 0; i < num_sticks; i++) {
+        stick s = unindex(uint16_t(i));
+        raw_x   = s.x;
+        raw_y   = s.y;
+        adjust(controller);
+        result[i] = effect {
+          int16_t((mag > 0) ? atan2s(-stick_y, stick_x) : 0), mag};
+      }
+
+      raw_x   = old_raw[0];
+      raw_y   = old_raw[1];
+      stick_x = old_stick[0];
+      stick_y = old_stick[1];
+      mag     = old_stick[2];
+      return result;
+    }()) {}
+
+  stick_table stick_table::cached(sm64& game, const fs::path& cache_dir) {
+    std::stringstream name;
+    name << "sticks-" << std::hex << std::setw(16) << std::setfill('0')
+         << game.build_id() << ".bin";
+    fs::path path = cache_dir / name.str();
+
+    constexpr size_t record = 6;
+    std::vector<char> buffer(sizeof(cache_magic) + num_sticks * record);
+    {
+      std::ifstream in(path, std::ios::in | std::ios::binary);
+      if (
+        in && in.read(buffer.data(), buffer.size()) &&
+        std::equal(cache_magic, cache_magic + sizeof(cache_magic), buffer.data())) {
+        std::vector<effect> effects(num_sticks);
+        for (size_t i = 0; i < num_sticks; i++) {
+          effects[i] = read_effect(&buffer[sizeof(cache_magic) + i * record]);
+        }
+        return stick_table(std::move(effects));
+      }
+    }
+
+    stick_table result(game);
+
+    std::copy(cache_magic, cache_magic + sizeof(cache_magic), buffer.data());
+    for (size_t i = 0; i < num_sticks; i++) {
+      dump_effect(result.m_effects[i], &buffer[sizeof(cache_magic) + i * record]);
+    }
+    fs::create_directories(cache_dir);
+    atomic_write(path, buffer);
+    return result;
+  }
+
+  std::vector<stick_table::stick> stick_table::members(size_t cls) const {
+    std::vector<stick> result;
+    for (uint32_t i = m_offsets[cls]; i < m_offsets[cls + 1]; i++) {
+      result.push_back(unindex(m_members[i]));
+    }
+    return result;
+  }
+
+  std::vector<stick_table::stick> stick_table::representatives() const {
+    std::vector<stick> result;
+    result.reserve(size());
+    for (size_t cls = 0; cls < size(); cls++) {
+      result.push_back(representative(cls));
+    }
+    return result;
+  }
+
+  std::vector<stick_table::stick> stick_table::find(const effect& e) const {
+    // classes are sorted by effect
+    size_t lo = 0, hi = size();
+    while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      if (effect_less(m_effects[m_members[m_offsets[mid]]], e))
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    if (lo == size() || m_effects[m_members[m_offsets[lo]]] != e)
+      return {};
+    return members(lo);
+  }
+}  // namespace pancake
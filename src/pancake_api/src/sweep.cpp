@@ -0,0 +1,275 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#include <pancake/sweep.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <pancake/movie.hpp>
+#include <pancake/patch.hpp>
+#include <pancake/pool.hpp>
+#include <pancake/sm64.hpp>
+#include <pancake/stick_table.hpp>
+
+namespace fs = std::filesystem;
+using pancake::frame;
+using pancake::sm64;
+
+namespace {
+  constexpr char sweep_magic[8] = {'P', 'C', 'S', 'W', 'E', 'E', 'P', 1};
+  constexpr char grid_magic[8]  = {'P', 'C', 'G', 'R', 'I', 'D', 0, 1};
+  constexpr size_t width        = pancake::stick_sweep::width;
+
+  void write_u32(std::ostream& out, uint32_t x) {
+    char buf[4];
+    for (size_t i = 0; i < 4; i++)
+      buf[i] = char(x >> (8 * i));
+    out.write(buf, 4);
+  }
+
+  // Writes the watch list and returns its size.
+  size_t write_watch(std::ostream& out, const std::vector<std::string>& watch) {
+    write_u32(out, uint32_t(watch.size()));
+    size_t size = 4;
+    for (auto& expr : watch) {
+      write_u32(out, uint32_t(expr.size()));
+      out.write(expr.data(), expr.size());
+      size += 4 + expr.size();
+    }
+    return size;
+  }
+
+  // Writes the stick sweep header and returns its size.
+  size_t write_header(std::ostream& out, const std::vector<std::string>& watch) {
+    out.write(sweep_magic, sizeof(sweep_magic));
+    return sizeof(sweep_magic) + write_watch(out, watch);
+  }
+
+  std::vector<std::vector<sm64::accessor>> compile_all(
+    pancake::sm64_pool& pool, const std::vector<std::string>& watch) {
+    std::vector<std::vector<sm64::accessor>> result(pool.size());
+    for (size_t i = 0; i < pool.size(); i++) {
+      for (auto& expr : watch) {
+        result[i].push_back(pool[i].compile(expr));
+      }
+    }
+    return result;
+  }
+
+  // Holds one stick position from `state` and reads the watch list into
+  // `values`.
+  void run_one(
+    sm64& game, const sm64::savestate& state, const frame& input,
+    size_t frames, const std::vector<sm64::accessor>& watch, double* values,
+    size_t stride) {
+    state.load_changed();
+    game.advance(frames, [&](size_t) { return input; });
+    for (size_t c = 0; c < watch.size(); c++) {
+      values[c * stride] = watch[c].value();
+    }
+  }
+}  // namespace
+
+namespace pancake {
+  void stick_sweep::dump(const fs::path& path) const {
+    std::ofstream out(path, std::ios::out | std::ios::binary);
+    write_header(out, watch);
+    for (size_t row = 0; row < width; row++) {
+      for (auto& col : columns) {
+        out.write(
+          reinterpret_cast<const char*>(&col[row * width]),
+          width * sizeof(double));
+      }
+    }
+    if (!out) {
+      throw std::runtime_error("Failed to write " + path.string());
+    }
+  }
+
+  stick_sweep sweep_stick(
+    sm64_pool& pool, const sm64_pool::savestate& state, frame::button buttons,
+    size_t frames, const std::vector<std::string>& watch,
+    const stick_table* classes) {
+    stick_sweep result {
+      watch, std::vector<std::vector<double>>(
+               watch.size(), std::vector<double>(width * width))};
+    auto accessors = compile_all(pool, watch);
+
+    std::vector<stick_table::stick> todo;
+    if (classes) {
+      todo = classes->representatives();
+    }
+    else {
+      todo.reserve(width * width);
+      for (int y = -128; y < 128; y++) {
+        for (int x = -128; x < 128; x++) {
+          todo.push_back(stick_table::stick {int8_t(x), int8_t(y)});
+        }
+      }
+    }
+
+    std::vector<std::vector<double>> scratch(
+      pool.size(), std::vector<double>(watch.size()));
+    pool.parallel_for(todo.size(), [&](size_t w, sm64& game, size_t item) {
+      const stick_table::stick& s = todo[item];
+      run_one(
+        game, state[w], frame {buttons, s.x, s.y}, frames, accessors[w],
+        scratch[w].data(), 1);
+      size_t idx = stick_sweep::index(s.x, s.y);
+      for (size_t c = 0; c < watch.size(); c++) {
+        result.columns[c][idx] = scratch[w][c];
+      }
+    });
+
+    if (classes) {
+      for (size_t cls = 0; cls < classes->size(); cls++) {
+        stick_table::stick rep = classes->representative(cls);
+        size_t from            = stick_sweep::index(rep.x, rep.y);
+        for (auto& s : classes->members(cls)) {
+          size_t to = stick_sweep::index(s.x, s.y);
+          for (auto& col : result.columns)
+            col[to] = col[from];
+        }
+      }
+    }
+    return result;
+  }
+
+  void sweep_stick(
+    sm64_pool& pool, const sm64_pool::savestate& state, frame::button buttons,
+    size_t frames, const std::vector<std::string>& watch,
+    const fs::path& output) {
+    auto accessors = compile_all(pool, watch);
+
+    std::ofstream out(output, std::ios::out | std::ios::binary);
+    const size_t header = write_header(out, watch);
+    if (!out) {
+      throw std::runtime_error("Failed to write " + output.string());
+    }
+    std::mutex out_lock;
+
+    // one row block per worker
+    const size_t block = watch.size() * width;
+    std::vector<std::vector<double>> rows(
+      pool.size(), std::vector<double>(block));
+    pool.parallel_for(width, [&](size_t w, sm64& game, size_t row) {
+      int8_t y = int8_t(int(row) - 128);
+      for (size_t col = 0; col < width; col++) {
+        int8_t x = int8_t(int(col) - 128);
+        run_one(
+          game, state[w], frame {buttons, x, y}, frames, accessors[w],
+          &rows[w][col], width);
+      }
+
+      std::lock_guard<std::mutex> guard(out_lock);
+      out.seekp(header + row * block * sizeof(double));
+      out.write(
+        reinterpret_cast<const char*>(rows[w].data()), block * sizeof(double));
+      if (!out) {
+        throw std::runtime_error("Failed to write " + output.string());
+      }
+    });
+  }
+
+  grid_axis grid_axis::linspace(
+    std::string field, double lo, double hi, size_t count) {
+    grid_axis result {std::move(field), std::vector<double>(count)};
+    for (size_t i = 0; i < count; i++) {
+      result.values[i] =
+        (count == 1) ? lo : lo + (hi - lo) * double(i) / double(count - 1);
+    }
+    return result;
+  }
+
+  size_t grid_sweep::size() const {
+    size_t n = 1;
+    for (size_t dim : shape)
+      n *= dim;
+    return n;
+  }
+
+  size_t grid_sweep::index(const std::vector<size_t>& coords) const {
+    size_t idx = 0;
+    for (size_t i = 0; i < shape.size(); i++)
+      idx = idx * shape[i] + coords[i];
+    return idx;
+  }
+
+  void grid_sweep::dump(const fs::path& path) const {
+    std::ofstream out(path, std::ios::out | std::ios::binary);
+    out.write(grid_magic, sizeof(grid_magic));
+    write_u32(out, uint32_t(shape.size()));
+    for (size_t dim : shape)
+      write_u32(out, uint32_t(dim));
+    write_watch(out, watch);
+    for (auto& col : columns) {
+      out.write(
+        reinterpret_cast<const char*>(col.data()), col.size() * sizeof(double));
+    }
+    if (!out) {
+      throw std::runtime_error("Failed to write " + path.string());
+    }
+  }
+
+  grid_sweep sweep_grid(
+    sm64_pool& pool, const sm64_pool::savestate& state,
+    const std::vector<grid_axis>& axes, size_t frames,
+    const std::vector<std::string>& watch, const frame& input) {
+    if (axes.empty()) {
+      throw std::invalid_argument("Grid sweeps need at least one axis");
+    }
+    grid_sweep result {{}, watch, {}};
+    std::vector<std::string> fields;
+    for (auto& axis : axes) {
+      if (axis.values.empty()) {
+        throw std::invalid_argument("Grid axis " + axis.field + " is empty");
+      }
+      result.shape.push_back(axis.values.size());
+      fields.push_back(axis.field);
+    }
+    result.columns.assign(watch.size(), std::vector<double>(result.size()));
+
+    auto accessors = compile_all(pool, watch);
+    std::vector<std::unique_ptr<write_patch>> patches;
+    for (size_t i = 0; i < pool.size(); i++) {
+      patches.emplace_back(new write_patch(pool[i], fields));
+    }
+
+    struct scratch {
+      std::vector<double> values;
+      std::vector<double> watched;
+    };
+    std::vector<scratch> work(
+      pool.size(),
+      scratch {
+        std::vector<double>(axes.size()), std::vector<double>(watch.size())});
+
+    pool.parallel_for(result.size(), [&](size_t w, sm64& game, size_t item) {
+      // Decode the row-major index, last axis first
+      scratch& s = work[w];
+      size_t rem = item;
+      for (size_t a = axes.size(); a-- > 0;) {
+        s.values[a] = axes[a].values[rem % axes[a].values.size()];
+        rem /= axes[a].values.size();
+      }
+
+      state[w].load_changed();
+      patches[w]->apply(s.values);
+      game.advance(frames, [&](size_t) { return input; });
+      for (size_t c = 0; c < watch.size(); c++) {
+        result.columns[c][item] = accessors[w][c].value();
+      }
+    });
+    return result;
+  }
+}  // namespace pancake
@@ -0,0 +1,133 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#include <pancake/timeline.hpp>
+
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include <pancake/movie.hpp>
+#include <pancake/sm64.hpp>
+
+namespace pancake {
+  timeline::timeline(sm64& game, m64& movie, size_t budget, uint32_t interval) :
+    m_game(game),
+    m_movie(movie),
+    m_budget(budget),
+    m_interval(interval),
+    m_memory(0),
+    m_pos(0),
+    m_synced(true) {
+    if (interval == 0) {
+      throw std::invalid_argument("Checkpoint interval must be at least 1");
+    }
+    sm64::savestate st = m_game.alloc_svst();
+    st.save();
+    m_memory += st.size();
+    m_states.emplace(0, std::move(st));
+  }
+
+  void timeline::checkpoint(uint32_t frame) {
+    if (m_states.count(frame))
+      return;
+
+    if (m_spare.empty()) {
+      m_states.emplace(frame, m_game.alloc_svst());
+      m_memory += m_states.at(frame).size();
+    }
+    else {
+      // spares are already counted in m_memory
+      m_states.emplace(frame, std::move(m_spare.back()));
+      m_spare.pop_back();
+    }
+    m_states.at(frame).save();
+    evict(frame);
+  }
+
+  void timeline::evict(uint32_t keep) {
+    // Spares go first, they're only kept to avoid reallocating
+    while (m_memory > m_budget && !m_spare.empty()) {
+      m_memory -= m_spare.back().size();
+      m_spare.pop_back();
+    }
+
+    while (m_memory > m_budget && m_states.size() > 1) {
+      // Removing a checkpoint merges the gaps on either side of it. Pick the
+      // one whose merged gap is smallest relative to its distance from the
+      // current position, so spacing grows with distance.
+      auto victim     = m_states.end();
+      double min_cost = std::numeric_limits<double>::infinity();
+      for (auto it = std::next(m_states.begin()); it != m_states.end(); ++it) {
+        if (it->first == keep)
+          continue;
+        uint32_t prev = std::prev(it)->first;
+        auto next_it  = std::next(it);
+        uint32_t next =
+          (next_it == m_states.end()) ? it->first + m_interval : next_it->first;
+        uint32_t dist = (it->first > keep) ? it->first - keep : keep - it->first;
+
+        double cost =
+          double(next - prev) / (1.0 + double(dist) / double(m_interval));
+        if (cost < min_cost) {
+          min_cost = cost;
+          victim   = it;
+        }
+      }
+      if (victim == m_states.end())
+        break;
+      m_memory -= victim->second.size();
+      m_states.erase(victim);
+    }
+  }
+
+  void timeline::seek(uint32_t frame) {
+    if (frame > m_movie.size()) {
+      throw std::out_of_range("Tried to seek past the end of the movie");
+    }
+    if (m_synced && m_pos == frame)
+      return;
+
+    // nearest checkpoint at or before the target; frame 0 is always present
+    auto it = std::prev(m_states.upper_bound(frame));
+    if (!(m_synced && m_pos <= frame && m_pos >= it->first)) {
+      it->second.load();
+      m_pos = it->first;
+    }
+    m_synced = true;
+
+    const sm64::input_sink& sink = m_game.inputs();
+    while (m_pos < frame) {
+      sink.apply(m_movie[m_pos]);
+      m_game.advance();
+      if (++m_pos % m_interval == 0)
+        checkpoint(m_pos);
+    }
+  }
+
+  void timeline::set(uint32_t index, const frame& value) {
+    m_movie.at(index) = value;
+    invalidate(index);
+  }
+
+  void timeline::push_back(const frame& value) {
+    m_movie.push_back(value);
+  }
+
+  void timeline::invalidate(uint32_t index) {
+    // The checkpoint at `index` is the state before that input is applied,
+    // so it stays valid.
+    auto it = m_states.upper_bound(index);
+    while (it != m_states.end()) {
+      m_spare.push_back(std::move(it->second));
+      it = m_states.erase(it);
+    }
+    if (m_pos > index)
+      m_synced = false;
+  }
+}  // namespace pancake
@@ -0,0 +1,119 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#include <pancake/trace.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <pancake/sm64.hpp>
+#include "trace_codec.hpp"
+
+namespace fs = std::filesystem;
+using std::string;
+
+namespace pancake {
+  trace_writer::trace_writer(
+    sm64& game, const std::vector<string>& fields, const fs::path& path,
+    size_t chunk_rows) :
+    m_out(path, std::ios::binary | std::ios::trunc),
+    m_chunk_rows(chunk_rows),
+    m_rows(0),
+    m_closed(false) {
+    if (fields.empty()) {
+      throw std::invalid_argument("A trace needs at least one field");
+    }
+    if (!m_out) {
+      throw std::runtime_error("Failed to create " + path.string());
+    }
+    for (auto& field : fields) {
+      m_fields.push_back(game.compile(field));
+      m_columns.push_back(trace_column {field, m_fields.back().type});
+    }
+    m_buffers.resize(fields.size());
+    for (auto& buffer : m_buffers)
+      buffer.reserve(m_chunk_rows);
+    m_out.write(trace_codec::magic, sizeof(trace_codec::magic));
+  }
+
+  trace_writer::~trace_writer() {
+    if (!m_closed) {
+      try {
+        close();
+      }
+      catch (...) {}
+    }
+  }
+
+  void trace_writer::flush() {
+    const size_t rows = m_buffers[0].size();
+    if (rows == 0)
+      return;
+
+    trace_chunk chunk {m_rows, uint32_t(rows), {}};
+    std::vector<char> data;
+    uint64_t pos = uint64_t(m_out.tellp());
+    for (size_t i = 0; i < m_buffers.size(); i++) {
+      size_t start = data.size();
+      trace_column_chunk col =
+        trace_codec::encode(m_buffers[i], m_columns[i].type, data);
+      col.offset = pos + start;
+      chunk.columns.push_back(col);
+      m_buffers[i].clear();
+    }
+    m_out.write(data.data(), data.size());
+    if (!m_out) {
+      throw std::runtime_error("Failed to write trace chunk");
+    }
+    m_chunks.push_back(std::move(chunk));
+    m_rows += rows;
+  }
+
+  void trace_writer::close() {
+    using trace_codec::put;
+    if (m_closed)
+      return;
+    flush();
+    m_closed = true;
+
+    std::vector<char> footer;
+    put<uint32_t>(footer, trace_codec::version);
+    put<uint32_t>(footer, uint32_t(m_columns.size()));
+    for (auto& col : m_columns) {
+      put<uint32_t>(footer, uint32_t(col.name.size()));
+      footer.insert(footer.end(), col.name.begin(), col.name.end());
+      put<uint16_t>(footer, uint16_t(col.type.encoding));
+      put<uint8_t>(footer, uint8_t(col.type.size));
+    }
+    put<uint32_t>(footer, uint32_t(m_chunks.size()));
+    for (auto& chunk : m_chunks) {
+      put<uint64_t>(footer, chunk.first_row);
+      put<uint32_t>(footer, chunk.rows);
+      for (auto& col : chunk.columns) {
+        put<uint64_t>(footer, col.offset);
+        put<uint64_t>(footer, col.length);
+        put<uint8_t>(footer, uint8_t(col.encoding));
+        put<uint8_t>(footer, col.width);
+        put<double>(footer, col.min);
+        put<double>(footer, col.max);
+      }
+    }
+    put<uint64_t>(footer, uint64_t(footer.size()));
+    footer.insert(
+      footer.end(), std::begin(trace_codec::magic), std::end(trace_codec::magic));
+
+    m_out.write(footer.data(), footer.size());
+    m_out.close();
+    if (!m_out) {
+      throw std::runtime_error("Failed to write trace footer");
+    }
+  }
+}  // namespace pancake
@@ -0,0 +1,279 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#ifndef _PANCAKE_TRACE_CODEC_HPP_
+#define _PANCAKE_TRACE_CODEC_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include <pancake/dwarf/type_info.hpp>
+#include <pancake/trace.hpp>
+
+// Encodings shared by the trace writer and reader. Values are held as
+// canonical 64-bit words: signed integers sign-extended, unsigned integers
+// zero-extended, and floats as their bits.
+namespace pancake::trace_codec {
+  inline constexpr char magic[4]    = {'P', 'K', 'T', 'R'};
+  inline constexpr uint32_t version = 1;
+
+  template <typename T>
+  void put(std::vector<char>& out, T value) {
+    uint64_t bits;
+    if constexpr (std::is_floating_point_v<T>) {
+      static_assert(sizeof(T) == 8);
+      std::memcpy(&bits, &value, 8);
+    }
+    else {
+      bits = uint64_t(value);
+    }
+    for (size_t i = 0; i < sizeof(T); i++)
+      out.push_back(char(bits >> (8 * i)));
+  }
+
+  inline bool is_float(dwarf::base_type_info type) {
+    return type.encoding == dwarf::encoding::floating_point;
+  }
+  inline bool is_signed(dwarf::base_type_info type) {
+    return type.encoding == dwarf::encoding::signed_int ||
+      type.encoding == dwarf::encoding::signed_char;
+  }
+
+  // Converts a word to a double, for statistics and predicates.
+  inline double to_double(uint64_t word, dwarf::base_type_info type) {
+    if (is_float(type)) {
+      if (type.size == 4) {
+        float res;
+        uint32_t bits = uint32_t(word);
+        std::memcpy(&res, &bits, 4);
+        return res;
+      }
+      double res;
+      std::memcpy(&res, &word, 8);
+      return res;
+    }
+    if (is_signed(type))
+      return double(int64_t(word));
+    return double(word);
+  }
+
+  inline unsigned bit_width(uint64_t x) {
+    unsigned res = 0;
+    for (; x != 0; x >>= 1)
+      res++;
+    return res;
+  }
+
+  inline uint64_t zigzag(uint64_t x) {
+    return (x << 1) ^ uint64_t(int64_t(x) >> 63);
+  }
+  inline uint64_t unzigzag(uint64_t x) {
+    return (x >> 1) ^ (~(x & 1) + 1);
+  }
+
+  inline size_t packed_size(size_t n, unsigned width) {
+    return (n * width + 7) / 8;
+  }
+
+  // Packs the low `width` bits of each value, least significant first.
+  inline void pack(
+    const uint64_t* values, size_t n, unsigned width, std::vector<char>& out) {
+    if (width == 0)
+      return;
+    const uint64_t mask =
+      (width == 64) ? ~uint64_t(0) : (uint64_t(1) << width) - 1;
+    uint64_t acc  = 0;
+    unsigned bits = 0;
+    for (size_t i = 0; i < n; i++) {
+      uint64_t x = values[i] & mask;
+      acc |= x << bits;
+      if (bits + width >= 64) {
+        put<uint64_t>(out, acc);
+        unsigned used = 64 - bits;
+        acc           = (used == 64) ? 0 : x >> used;
+        bits          = bits + width - 64;
+      }
+      else {
+        bits += width;
+      }
+    }
+    for (unsigned i = 0; i < bits; i += 8)
+      out.push_back(char(acc >> i));
+  }
+
+  // Encodes one column of a chunk with its smallest encoding.
+  inline trace_column_chunk encode(
+    const std::vector<uint64_t>& words, dwarf::base_type_info type,
+    std::vector<char>& out) {
+    const size_t n = words.size();
+    trace_column_chunk res {
+      0, 0, trace_encoding::plain, 0,
+      std::numeric_limits<double>::infinity(),
+      -std::numeric_limits<double>::infinity()};
+
+    for (uint64_t w : words) {
+      double v = to_double(w, type);
+      // NaNs fail every comparison, so they don't need to widen the range
+      if (v < res.min)
+        res.min = v;
+      if (v > res.max)
+        res.max = v;
+    }
+
+    size_t best   = n * type.size;
+    uint64_t base = 0, range = 0, deltas = 0, xors = 0;
+    if (n > 0) {
+      uint64_t lo = words[0], hi = words[0];
+      for (size_t i = 0; i < n; i++) {
+        uint64_t w = words[i];
+        if (is_signed(type) ? int64_t(w) < int64_t(lo) : w < lo)
+          lo = w;
+        if (is_signed(type) ? int64_t(w) > int64_t(hi) : w > hi)
+          hi = w;
+        if (i > 0) {
+          deltas |= zigzag(w - words[i - 1]);
+          xors |= w ^ words[i - 1];
+        }
+      }
+      base  = lo;
+      range = hi - lo;
+
+      auto consider = [&](trace_encoding enc, unsigned width, size_t count) {
+        size_t size = 8 + packed_size(count, width);
+        if (size < best) {
+          best         = size;
+          res.encoding = enc;
+          res.width    = uint8_t(width);
+        }
+      };
+      if (!is_float(type)) {
+        consider(trace_encoding::bitpack, bit_width(range), n);
+        consider(trace_encoding::delta, bit_width(deltas), n - 1);
+      }
+      consider(trace_encoding::xor_bits, bit_width(xors), n - 1);
+    }
+
+    size_t start = out.size();
+    switch (res.encoding) {
+      case trace_encoding::plain:
+        for (uint64_t w : words) {
+          for (size_t i = 0; i < type.size; i++)
+            out.push_back(char(w >> (8 * i)));
+        }
+        break;
+      case trace_encoding::bitpack: {
+        put<uint64_t>(out, base);
+        std::vector<uint64_t> offsets(n);
+        for (size_t i = 0; i < n; i++)
+          offsets[i] = words[i] - base;
+        pack(offsets.data(), n, res.width, out);
+      } break;
+      case trace_encoding::delta: {
+        put<uint64_t>(out, words[0]);
+        std::vector<uint64_t> diffs(n - 1);
+        for (size_t i = 1; i < n; i++)
+          diffs[i - 1] = zigzag(words[i] - words[i - 1]);
+        pack(diffs.data(), n - 1, res.width, out);
+      } break;
+      case trace_encoding::xor_bits: {
+        put<uint64_t>(out, words[0]);
+        std::vector<uint64_t> diffs(n - 1);
+        for (size_t i = 1; i < n; i++)
+          diffs[i - 1] = words[i] ^ words[i - 1];
+        pack(diffs.data(), n - 1, res.width, out);
+      } break;
+    }
+    res.length = out.size() - start;
+    return res;
+  }
+
+  // Reads a little-endian word, padding with zeroes past the end.
+  inline uint64_t load(const char* data, size_t size, size_t pos) {
+    uint64_t res = 0;
+    for (size_t i = 0; i < 8 && pos + i < size; i++)
+      res |= uint64_t(uint8_t(data[pos + i])) << (8 * i);
+    return res;
+  }
+
+  // Unpacks `n` values of `width` bits each.
+  inline void unpack(
+    const char* data, size_t size, size_t n, unsigned width, uint64_t* out) {
+    if (width == 0) {
+      std::fill(out, out + n, 0);
+      return;
+    }
+    const uint64_t mask =
+      (width == 64) ? ~uint64_t(0) : (uint64_t(1) << width) - 1;
+    for (size_t i = 0; i < n; i++) {
+      size_t bit     = i * width;
+      unsigned shift = unsigned(bit % 64);
+      size_t word    = (bit / 64) * 8;
+      uint64_t value = load(data, size, word) >> shift;
+      if (shift + width > 64)
+        value |= load(data, size, word + 8) << (64 - shift);
+      out[i] = value & mask;
+    }
+  }
+
+  // Decodes one column of a chunk into words.
+  inline void decode(
+    const trace_column_chunk& col, dwarf::base_type_info type,
+    const char* data, size_t rows, std::vector<uint64_t>& out) {
+    const size_t size = col.length;
+    out.resize(rows);
+    if (rows == 0)
+      return;
+    // delta and xor_bits store the first value unpacked
+    const size_t packed =
+      (col.encoding == trace_encoding::bitpack) ? rows : rows - 1;
+    if (col.encoding != trace_encoding::plain &&
+        (size < 8 || size - 8 < packed_size(packed, col.width)))
+      throw std::runtime_error("Trace chunk is truncated");
+
+    switch (col.encoding) {
+      case trace_encoding::plain: {
+        if (size < rows * type.size)
+          throw std::runtime_error("Trace chunk is truncated");
+        const unsigned shift = unsigned(64 - 8 * type.size);
+        for (size_t i = 0; i < rows; i++) {
+          uint64_t w = 0;
+          for (size_t b = 0; b < type.size; b++)
+            w |= uint64_t(uint8_t(data[i * type.size + b])) << (8 * b);
+          // sign-extend signed integers back to 64 bits
+          if (is_signed(type) && shift < 64)
+            w = uint64_t(int64_t(w << shift) >> shift);
+          out[i] = w;
+        }
+      } break;
+      case trace_encoding::bitpack: {
+        uint64_t base = load(data, size, 0);
+        unpack(data + 8, size - 8, rows, col.width, out.data());
+        for (size_t i = 0; i < rows; i++)
+          out[i] += base;
+      } break;
+      case trace_encoding::delta: {
+        out[0] = load(data, size, 0);
+        unpack(data + 8, size - 8, rows - 1, col.width, out.data() + 1);
+        for (size_t i = 1; i < rows; i++)
+          out[i] = out[i - 1] + unzigzag(out[i]);
+      } break;
+      case trace_encoding::xor_bits: {
+        out[0] = load(data, size, 0);
+        unpack(data + 8, size - 8, rows - 1, col.width, out.data() + 1);
+        for (size_t i = 1; i < rows; i++)
+          out[i] ^= out[i - 1];
+      } break;
+      default: throw std::runtime_error("Unknown trace encoding");
+    }
+  }
+}  // namespace pancake::trace_codec
+#endif
@@ -0,0 +1,330 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#include <pancake/trace_query.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <pancake/stx/bits.hpp>
+#include "trace_codec.hpp"
+
+namespace fs = std::filesystem;
+using std::string;
+
+namespace {
+  // Reads footer fields, checking that each one is in bounds.
+  struct cursor {
+    const char* data;
+    size_t size;
+    size_t pos;
+
+    const char* take(size_t n) {
+      if (size - pos < n)
+        throw std::runtime_error("Trace footer is malformed");
+      const char* res = data + pos;
+      pos += n;
+      return res;
+    }
+
+    template <typename T>
+    T get() {
+      uint64_t bits = pancake::trace_codec::load(take(sizeof(T)), sizeof(T), 0);
+      T res;
+      if constexpr (std::is_floating_point_v<T>) {
+        std::memcpy(&res, &bits, sizeof(T));
+      }
+      else {
+        res = T(bits);
+      }
+      return res;
+    }
+  };
+
+  // ANDs `value[i] cmp x` into each row's bit. The inner loop has no
+  // branches, so the compiler can vectorise it; words with no rows left are
+  // skipped.
+  template <typename Cmp>
+  void filter(
+    const double* values, size_t n, double x, uint64_t* bits, Cmp cmp) {
+    for (size_t w = 0; w * 64 < n; w++) {
+      if (bits[w] == 0)
+        continue;
+      const double* block = values + w * 64;
+      const size_t len    = std::min<size_t>(64, n - w * 64);
+      uint64_t mask       = 0;
+      for (size_t i = 0; i < len; i++)
+        mask |= uint64_t(cmp(block[i], x)) << i;
+      bits[w] &= mask;
+    }
+  }
+
+  enum class verdict { none, some, all };
+
+  // Decides from a chunk's statistics whether no rows, some rows, or all
+  // rows can pass a comparison. NaNs aren't counted in the statistics, so
+  // only integer columns can be known to pass entirely.
+  verdict check(
+    pancake::trace_op op, double x, const pancake::trace_column_chunk& col,
+    bool exact) {
+    using pancake::trace_op;
+    const double lo = col.min, hi = col.max;
+    switch (op) {
+      case trace_op::lt:
+        if (lo >= x)
+          return verdict::none;
+        return (exact && hi < x) ? verdict::all : verdict::some;
+      case trace_op::le:
+        if (lo > x)
+          return verdict::none;
+        return (exact && hi <= x) ? verdict::all : verdict::some;
+      case trace_op::gt:
+        if (hi <= x)
+          return verdict::none;
+        return (exact && lo > x) ? verdict::all : verdict::some;
+      case trace_op::ge:
+        if (hi < x)
+          return verdict::none;
+        return (exact && lo >= x) ? verdict::all : verdict::some;
+      case trace_op::eq:
+        if (x < lo || x > hi)
+          return verdict::none;
+        return (exact && lo == x && hi == x) ? verdict::all : verdict::some;
+      case trace_op::ne:
+        if (exact && lo == x && hi == x)
+          return verdict::none;
+        return (exact && (x < lo || x > hi)) ? verdict::all : verdict::some;
+    }
+    return verdict::some;
+  }
+}  // namespace
+
+namespace pancake {
+  trace_reader::trace_reader(const fs::path& path) :
+    m_in(path, std::ios::binary), m_rows(0) {
+    if (!m_in) {
+      throw std::runtime_error("Failed to open " + path.string());
+    }
+    m_in.seekg(0, std::ios::end);
+    const uint64_t file_size = uint64_t(m_in.tellg());
+    const size_t tail_size   = 8 + sizeof(trace_codec::magic);
+    if (file_size < sizeof(trace_codec::magic) + tail_size) {
+      throw std::runtime_error(path.string() + " is not a trace");
+    }
+
+    char tail[tail_size];
+    m_in.seekg(file_size - tail_size);
+    m_in.read(tail, tail_size);
+    if (!m_in ||
+        std::memcmp(tail + 8, trace_codec::magic, sizeof(trace_codec::magic)) !=
+          0) {
+      throw std::runtime_error(path.string() + " is not a trace");
+    }
+    const uint64_t footer_size = trace_codec::load(tail, 8, 0);
+    if (footer_size > file_size - tail_size - sizeof(trace_codec::magic)) {
+      throw std::runtime_error("Trace footer is malformed");
+    }
+
+    std::vector<char> footer(footer_size);
+    m_in.seekg(file_size - tail_size - footer_size);
+    m_in.read(footer.data(), footer.size());
+    if (!m_in) {
+      throw std::runtime_error("Failed to read trace footer");
+    }
+
+    cursor in {footer.data(), footer.size(), 0};
+    if (in.get<uint32_t>() != trace_codec::version) {
+      throw std::runtime_error("Unsupported trace version");
+    }
+    const uint32_t ncols = in.get<uint32_t>();
+    for (uint32_t i = 0; i < ncols; i++) {
+      uint32_t len = in.get<uint32_t>();
+      string name(in.take(len), len);
+      dwarf::base_type_info type;
+      type.encoding = dwarf::encoding(in.get<uint16_t>());
+      type.size     = in.get<uint8_t>();
+      if (type.size != 1 && type.size != 2 && type.size != 4 && type.size != 8)
+        throw std::runtime_error("Trace footer is malformed");
+      m_columns.push_back(trace_column {std::move(name), type});
+    }
+
+    const uint32_t nchunks  = in.get<uint32_t>();
+    const uint64_t data_end = file_size - tail_size - footer_size;
+    for (uint32_t i = 0; i < nchunks; i++) {
+      trace_chunk chunk;
+      chunk.first_row = in.get<uint64_t>();
+      chunk.rows      = in.get<uint32_t>();
+      for (uint32_t j = 0; j < ncols; j++) {
+        trace_column_chunk col;
+        col.offset   = in.get<uint64_t>();
+        col.length   = in.get<uint64_t>();
+        col.encoding = trace_encoding(in.get<uint8_t>());
+        col.width    = in.get<uint8_t>();
+        col.min      = in.get<double>();
+        col.max      = in.get<double>();
+        if (col.offset > data_end || col.length > data_end - col.offset ||
+            col.width > 64)
+          throw std::runtime_error("Trace footer is malformed");
+        chunk.columns.push_back(col);
+      }
+      m_rows += chunk.rows;
+      m_chunks.push_back(std::move(chunk));
+    }
+  }
+
+  size_t trace_reader::column_index(const string& name) const {
+    for (size_t i = 0; i < m_columns.size(); i++) {
+      if (m_columns[i].name == name)
+        return i;
+    }
+    throw std::out_of_range("Trace has no column " + name);
+  }
+
+  void trace_reader::read_words(
+    size_t chunk, size_t column, std::vector<uint64_t>& out) {
+    const trace_chunk& ch         = m_chunks.at(chunk);
+    const trace_column_chunk& col = ch.columns.at(column);
+    m_scratch.resize(col.length);
+    m_in.clear();
+    m_in.seekg(col.offset);
+    m_in.read(m_scratch.data(), m_scratch.size());
+    if (!m_in) {
+      throw std::runtime_error("Failed to read trace chunk");
+    }
+    trace_codec::decode(
+      col, m_columns[column].type, m_scratch.data(), ch.rows, out);
+  }
+
+  void trace_reader::read_values(
+    size_t chunk, size_t column, std::vector<double>& out) {
+    std::vector<uint64_t> words;
+    read_words(chunk, column, words);
+    const dwarf::base_type_info type = m_columns[column].type;
+    out.resize(words.size());
+    for (size_t i = 0; i < words.size(); i++)
+      out[i] = trace_codec::to_double(words[i], type);
+  }
+
+  trace_query& trace_query::where(
+    const string& column, trace_op op, double value) {
+    m_where.push_back(condition {m_reader.column_index(column), op, value});
+    return *this;
+  }
+
+  trace_query& trace_query::select(const std::vector<string>& columns) {
+    std::vector<size_t> indices;
+    for (auto& name : columns)
+      indices.push_back(m_reader.column_index(name));
+    m_select = std::move(indices);
+    return *this;
+  }
+
+  bool trace_query::match(size_t chunk, std::vector<uint64_t>& bits) {
+    const trace_chunk& ch = m_reader.chunks().at(chunk);
+    const size_t n        = ch.rows;
+    bits.assign((n + 63) / 64, 0);
+    if (n == 0)
+      return false;
+
+    // decide what to evaluate before reading anything
+    std::vector<const condition*> pending;
+    for (auto& cond : m_where) {
+      const bool exact =
+        !trace_codec::is_float(m_reader.columns()[cond.column].type);
+      switch (check(cond.op, cond.value, ch.columns[cond.column], exact)) {
+        case verdict::none: return false;
+        case verdict::some: pending.push_back(&cond); break;
+        case verdict::all: break;
+      }
+    }
+
+    std::fill(bits.begin(), bits.end(), ~uint64_t(0));
+    if (n % 64 != 0)
+      bits.back() = (uint64_t(1) << (n % 64)) - 1;
+
+    for (const condition* cond : pending) {
+      m_reader.read_values(chunk, cond->column, m_values);
+      const double* v = m_values.data();
+      const double x  = cond->value;
+      uint64_t* out   = bits.data();
+      switch (cond->op) {
+        case trace_op::lt: filter(v, n, x, out, std::less<double>()); break;
+        case trace_op::le:
+          filter(v, n, x, out, std::less_equal<double>());
+          break;
+        case trace_op::gt: filter(v, n, x, out, std::greater<double>()); break;
+        case trace_op::ge:
+          filter(v, n, x, out, std::greater_equal<double>());
+          break;
+        case trace_op::eq: filter(v, n, x, out, std::equal_to<double>()); break;
+        case trace_op::ne:
+          filter(v, n, x, out, std::not_equal_to<double>());
+          break;
+      }
+      if (std::all_of(bits.begin(), bits.end(), [](uint64_t w) {
+            return w == 0;
+          }))
+        return false;
+    }
+    return true;
+  }
+
+  void trace_query::for_each(const row_fn& fn) {
+    std::vector<uint64_t> bits;
+    std::vector<std::vector<double>> columns(m_select.size());
+    std::vector<double> row(m_select.size());
+    for (size_t c = 0; c < m_reader.chunks().size(); c++) {
+      if (!match(c, bits))
+        continue;
+      for (size_t i = 0; i < m_select.size(); i++)
+        m_reader.read_values(c, m_select[i], columns[i]);
+
+      const uint64_t first = m_reader.chunks()[c].first_row;
+      for (size_t w = 0; w < bits.size(); w++) {
+        for (uint64_t word = bits[w]; word != 0; word &= word - 1) {
+          size_t r = w * 64 + stx::ctz(word);
+          for (size_t i = 0; i < columns.size(); i++)
+            row[i] = columns[i][r];
+          fn(first + r, row.data());
+        }
+      }
+    }
+  }
+
+  uint64_t trace_query::count() {
+    std::vector<uint64_t> bits;
+    uint64_t res = 0;
+    for (size_t c = 0; c < m_reader.chunks().size(); c++) {
+      if (!match(c, bits))
+        continue;
+      for (uint64_t word : bits)
+        res += stx::popcount(word);
+    }
+    return res;
+  }
+
+  std::vector<uint64_t> trace_query::rows() {
+    std::vector<uint64_t> res;
+    std::vector<uint64_t> bits;
+    for (size_t c = 0; c < m_reader.chunks().size(); c++) {
+      if (!match(c, bits))
+        continue;
+      const uint64_t first = m_reader.chunks()[c].first_row;
+      for (size_t w = 0; w < bits.size(); w++) {
+        for (uint64_t word = bits[w]; word != 0; word &= word - 1)
+          res.push_back(first + w * 64 + stx::ctz(word));
+      }
+    }
+    return res;
+  }
+}  // namespace pancake
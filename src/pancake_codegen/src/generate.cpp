@@ -0,0 +1,365 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#include "generate.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include <pancake/dwarf/layout.hpp>
+#include <pancake/dwarf/types.hpp>
+#include <pancake/expr/compile.hpp>
+#include <pancake/expr/parse.hpp>
+#include <pancake/stx/hash_bytes.hpp>
+#include <pancake/stx/overload.hpp>
+
+namespace fs = std::filesystem;
+namespace dwarf = pancake::dwarf;
+namespace expr = pancake::expr;
+using std::string;
+
+namespace {
+  bool is_identifier(const string& str) {
+    if (str.empty() || std::isdigit(static_cast<unsigned char>(str[0])))
+      return false;
+    return std::all_of(str.begin(), str.end(), [](char c) {
+      return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    });
+  }
+
+  // Hashes a file the same way as sm64::build_id().
+  uint64_t build_id(const fs::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::vector<char> data(
+      (std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (!file.eof() || file.bad()) {
+      throw std::runtime_error("Failed to read " + path.string());
+    }
+    return stx::hash_bytes(data.data(), data.size());
+  }
+
+  // The C++ name of a base type, or an empty string if there's none.
+  string scalar_name(dwarf::base_type_info type) {
+    switch (type.encoding) {
+      case dwarf::encoding::floating_point:
+        switch (type.size) {
+          case 4: return "float";
+          case 8: return "double";
+        }
+        break;
+      case dwarf::encoding::signed_int:
+      case dwarf::encoding::signed_char:
+        switch (type.size) {
+          case 1: return "int8_t";
+          case 2: return "int16_t";
+          case 4: return "int32_t";
+          case 8: return "int64_t";
+        }
+        break;
+      case dwarf::encoding::unsigned_int:
+      case dwarf::encoding::unsigned_char:
+      case dwarf::encoding::boolean:
+        switch (type.size) {
+          case 1: return "uint8_t";
+          case 2: return "uint16_t";
+          case 4: return "uint32_t";
+          case 8: return "uint64_t";
+        }
+        break;
+      case dwarf::encoding::address:
+        if (type.size == sizeof(void*))
+          return "void*";
+        break;
+      default: break;
+    }
+    return string();
+  }
+
+  // Strips typedefs and arrays down to the element type.
+  dwarf::die element_die(dwarf::die type) {
+    type = dwarf::strip_typedefs(type);
+    while (type.tag() == dwarf::die_tag::array_type)
+      type = dwarf::strip_typedefs(type.get_attr<dwarf::die>(dwarf::dw_attrs::type));
+    return type;
+  }
+
+  // Describes a record's layout, to tell apart different records that share
+  // a name.
+  string shape(const dwarf::record_layout& layout) {
+    std::ostringstream out;
+    out << (layout.is_union ? "union " : "struct ") << layout.size;
+    for (auto& m : layout.members) {
+      out << ';' << m.name << '@' << m.offset << ':' << m.type.size << 'x'
+          << m.count;
+    }
+    return out.str();
+  }
+
+  class generator {
+    dwarf::debug m_dbg;
+    // C++ names of generated records, by DIE offset
+    std::unordered_map<Dwarf_Off, string> m_names;
+    // shapes of generated records, by C++ name
+    std::unordered_map<string, string> m_shapes;
+    std::ostringstream m_defs;
+    std::ostringstream m_checks;
+    std::ostringstream m_offsets;
+    std::ostringstream m_accessors;
+
+    // Returns the C++ name of a member's element type, generating records
+    // as needed.
+    string type_name(const dwarf::member_layout& member, const string& fallback) {
+      string scalar = scalar_name(member.type);
+      if (!scalar.empty())
+        return scalar;
+      if (
+        member.tag == dwarf::die_tag::structure_type ||
+        member.tag == dwarf::die_tag::union_type) {
+        return record(element_die(*member.type_die), fallback);
+      }
+      return string();
+    }
+
+  public:
+    generator(const fs::path& lib) : m_dbg(lib) {}
+
+    // Generates a struct or union, and everything it contains.
+    string record(dwarf::die type, const string& fallback) {
+      type         = dwarf::strip_typedefs(type);
+      Dwarf_Off id = type.offset();
+      if (auto it = m_names.find(id); it != m_names.end())
+        return it->second;
+
+      dwarf::record_layout layout = dwarf::read_record(type);
+      const string base = layout.name.empty() ? fallback : layout.name;
+      const string sig  = shape(layout);
+      // The same struct appears once per compilation unit, so a name that's
+      // taken by the same layout is reused. A different record with the
+      // same name gets a numbered one instead.
+      string name = base;
+      for (size_t n = 2;; n++) {
+        auto [it, fresh] = m_shapes.emplace(name, sig);
+        if (fresh)
+          break;
+        if (it->second == sig) {
+          m_names[id] = name;
+          return name;
+        }
+        name = base + "_" + std::to_string(n);
+      }
+      m_names[id] = name;
+
+      std::vector<dwarf::member_layout> members = layout.members;
+      std::stable_sort(
+        members.begin(), members.end(),
+        [](const dwarf::member_layout& a, const dwarf::member_layout& b) {
+          return a.offset < b.offset;
+        });
+
+      std::ostringstream body;
+      std::ostringstream offsets;
+      size_t cursor = 0;
+      for (auto& member : members) {
+        string member_name = member.name.empty()
+          ? "_anon_" + std::to_string(member.offset)
+          : member.name;
+        string elem = type_name(member, name + "_" + member_name);
+        if (elem.empty() || member.count == 0) {
+          body << "    // " << member_name << " is left as padding\n";
+          continue;
+        }
+        if (!layout.is_union && member.offset < cursor) {
+          body << "    // " << member_name << " overlaps the previous member\n";
+          continue;
+        }
+        if (!layout.is_union && member.offset > cursor) {
+          body << "    uint8_t _pad_" << cursor << "[" << (member.offset - cursor)
+               << "];\n";
+        }
+        body << "    " << elem << " " << member_name;
+        if (member.count != 1)
+          body << "[" << member.count << "]";
+        body << ";\n";
+        if (!layout.is_union)
+          cursor = member.offset + member.type.size * member.count;
+
+        offsets << "      inline constexpr size_t " << member_name << " = 0x"
+                << std::hex << member.offset << std::dec << ";\n";
+        m_checks << "  static_assert(offsetof(" << name << ", " << member_name
+                 << ") == 0x" << std::hex << member.offset << std::dec
+                 << ");\n";
+      }
+      if (layout.is_union) {
+        // make sure the union has its full size
+        body << "    uint8_t _bytes[" << layout.size << "];\n";
+      }
+      else if (cursor < layout.size) {
+        body << "    uint8_t _pad_" << cursor << "[" << (layout.size - cursor)
+             << "];\n";
+      }
+
+      m_defs << "  " << (layout.is_union ? "union " : "struct ") << name
+             << " {\n"
+             << body.str() << "  };\n";
+      m_checks << "  static_assert(sizeof(" << name << ") == " << layout.size
+               << ");\n";
+      m_offsets << "    namespace " << name << " {\n"
+                << offsets.str() << "    }\n";
+      return name;
+    }
+
+    void accessor(const string& name, const string& text) {
+      expr::expr_eval eval = expr::compile(expr::parse(text), m_dbg);
+
+      // look through typedefs and qualifiers, which compile() may leave
+      dwarf::die type = dwarf::strip_typedefs(*eval.result_die);
+      string result;
+      if (type.tag() != dwarf::die_tag::array_type) {
+        dwarf::die_tag tag;
+        result = scalar_name(dwarf::flatten_type(type, tag).first);
+        if (
+          result.empty() &&
+          (tag == dwarf::die_tag::structure_type ||
+           tag == dwarf::die_tag::union_type)) {
+          result = record(type, name + "_t");
+        }
+      }
+      if (result.empty()) {
+        throw std::invalid_argument(
+          text + " is not a number, pointer, struct or union");
+      }
+
+      m_accessors << "  // " << text << "\n";
+      m_accessors << "  inline constexpr char " << name << "_symbol[] = \""
+                  << eval.start << "\";\n";
+      if (eval.span) {
+        m_accessors << "  inline constexpr size_t " << name
+                    << "_count = " << eval.span->count << ";\n";
+      }
+      m_accessors << "  inline " << result << "& " << name << "(void* base"
+                  << (eval.span ? ", size_t i" : "") << ") {\n";
+      m_accessors << "    char* p = static_cast<char*>(base);\n";
+      for (auto& step : eval.steps) {
+        std::visit(
+          stx::overload {
+            [&](const expr::expr_eval::offset& s) {
+              m_accessors << "    p += " << s.off << ";\n";
+            },
+            [&](const expr::expr_eval::indirect&) {
+              m_accessors << "    p = *reinterpret_cast<char**>(p);\n";
+            }},
+          step);
+      }
+      // nothing after a slice follows a pointer, so the index can go last
+      if (eval.span) {
+        m_accessors << "    p += i * " << eval.span->stride << ";\n";
+      }
+      m_accessors << "    return *reinterpret_cast<" << result << "*>(p);\n";
+      m_accessors << "  }\n";
+    }
+
+    void struct_of(const string& name, const string& text) {
+      expr::expr_eval eval = expr::compile(expr::parse(text), m_dbg);
+      string got = record(*eval.result_die, name);
+      if (got != name) {
+        throw std::invalid_argument(
+          text + " is a " + got + ", not a " + name);
+      }
+    }
+
+    void write(std::ostream& out, const fs::path& lib, const string& ns) {
+      string guard = ns;
+      std::transform(guard.begin(), guard.end(), guard.begin(), [](char c) {
+        return char(std::toupper(static_cast<unsigned char>(c)));
+      });
+
+      out << "// Generated by pancake.codegen from " << lib.filename().string()
+          << ". Do not edit.\n";
+      out << "#ifndef _PANCAKE_GEN_" << guard << "_HPP_\n";
+      out << "#define _PANCAKE_GEN_" << guard << "_HPP_\n\n";
+      out << "#include <cstddef>\n#include <cstdint>\n#include <stdexcept>\n\n";
+      out << "namespace " << ns << " {\n";
+      out << "  inline constexpr uint64_t build_id = 0x" << std::hex
+          << std::setw(16) << std::setfill('0') << build_id(lib) << std::dec
+          << std::setfill(' ') << "ULL;\n\n";
+      out << "  /**\n"
+          << "   * @brief Throws if a game wasn't loaded from the build this "
+             "header was\n"
+          << "   * generated from.\n"
+          << "   */\n"
+          << "  template <typename Game>\n"
+          << "  void check_build(Game& game) {\n"
+          << "    if (game.build_id() != build_id) {\n"
+          << "      throw std::runtime_error(\n"
+          << "        \"libsm64 doesn't match the build " << ns
+          << " was generated from\");\n"
+          << "    }\n"
+          << "  }\n\n";
+      out << "#pragma pack(push, 1)\n" << m_defs.str() << "#pragma pack(pop)\n\n";
+      out << m_checks.str() << "\n";
+      out << "  namespace offsets {\n" << m_offsets.str() << "  }\n\n";
+      out << m_accessors.str();
+      out << "}  // namespace " << ns << "\n";
+      out << "#endif\n";
+    }
+  };
+}  // namespace
+
+namespace pancake::codegen {
+  spec read_spec(std::istream& in) {
+    spec result;
+    string line;
+    for (size_t num = 1; std::getline(in, line); num++) {
+      if (auto hash = line.find('#'); hash != string::npos)
+        line.erase(hash);
+      std::istringstream words(line);
+      string directive, name, text, extra;
+      if (!(words >> directive))
+        continue;
+
+      auto fail = [&](const string& what) {
+        throw std::invalid_argument(
+          "Spec line " + std::to_string(num) + ": " + what);
+      };
+      words >> name >> text;
+      if (directive == "namespace") {
+        if (!is_identifier(name) || !text.empty())
+          fail("expected \"namespace <name>\"");
+        result.ns = name;
+        continue;
+      }
+      if (!is_identifier(name) || text.empty() || (words >> extra))
+        fail("expected \"" + directive + " <name> <expression>\"");
+      if (directive == "struct")
+        result.structs.emplace_back(name, text);
+      else if (directive == "accessor")
+        result.accessors.emplace_back(name, text);
+      else
+        fail("unknown directive " + directive);
+    }
+    return result;
+  }
+
+  void generate(std::ostream& out, const fs::path& lib, const spec& what) {
+    generator gen(lib);
+    for (auto& [name, text] : what.structs)
+      gen.struct_of(name, text);
+    for (auto& [name, text] : what.accessors)
+      gen.accessor(name, text);
+    gen.write(out, lib, what.ns);
+  }
+}  // namespace pancake::codegen
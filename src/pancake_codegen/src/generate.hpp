@@ -0,0 +1,51 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#ifndef _PANCAKE_CODEGEN_GENERATE_HPP_
+#define _PANCAKE_CODEGEN_GENERATE_HPP_
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace pancake::codegen {
+  /**
+   * @brief What to generate.
+   */
+  struct spec {
+    std::string ns = "sm64gen";
+    /**
+     * @brief Pairs of a struct name and an expression of that type.
+     */
+    std::vector<std::pair<std::string, std::string>> structs;
+    /**
+     * @brief Pairs of an accessor name and its expression.
+     */
+    std::vector<std::pair<std::string, std::string>> accessors;
+  };
+
+  /**
+   * @brief Reads a spec file.
+   *
+   * @param in the spec
+   * @return the parsed spec
+   * @exception std::invalid_argument on unknown or malformed directives
+   */
+  spec read_spec(std::istream& in);
+
+  /**
+   * @brief Writes a header for a libsm64 build.
+   *
+   * @param out the stream to write to
+   * @param lib the libsm64 build
+   * @param what what to generate
+   */
+  void generate(
+    std::ostream& out, const std::filesystem::path& lib, const spec& what);
+}  // namespace pancake::codegen
+#endif
@@ -0,0 +1,46 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "generate.hpp"
+
+namespace fs = std::filesystem;
+
+int main(int argc, char* argv[]) {
+  if (argc != 4) {
+    std::cerr << "usage: " << argv[0] << " <libsm64> <spec file> <output header>\n";
+    return 2;
+  }
+  try {
+    std::ifstream spec_file(argv[2]);
+    if (!spec_file) {
+      std::cerr << "Failed to open " << argv[2] << "\n";
+      return 1;
+    }
+    pancake::codegen::spec what = pancake::codegen::read_spec(spec_file);
+
+    // generate in memory first so a failure doesn't leave a broken header
+    std::ostringstream header;
+    pancake::codegen::generate(header, argv[1], what);
+
+    std::ofstream out(argv[3], std::ios::out | std::ios::trunc);
+    out << header.str();
+    if (!out) {
+      std::cerr << "Failed to write " << argv[3] << "\n";
+      return 1;
+    }
+  }
+  catch (const std::exception& e) {
+    std::cerr << "error: " << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
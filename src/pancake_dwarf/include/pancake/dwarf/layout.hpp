@@ -0,0 +1,179 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#ifndef _PANCAKE_DWARF_LAYOUT_HPP_
+#define _PANCAKE_DWARF_LAYOUT_HPP_
+
+#include <cstddef>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <libdwarf/libdwarf.h>
+#include <pancake/dwarf/enums.hpp>
+#include <pancake/dwarf/type_info.hpp>
+#include <pancake/dwarf/types.hpp>
+
+namespace pancake::dwarf {
+  /**
+   * @brief Strips typedefs and cv-qualifiers from a type DIE.
+   */
+  inline die strip_typedefs(die type) {
+    for (;;) {
+      switch (type.tag()) {
+        case die_tag::typedef_:
+        case die_tag::const_type:
+        case die_tag::volatile_type:
+        case die_tag::restrict_type:
+        case die_tag::atomic_type:
+          if (!type.has_attr(dw_attrs::type))
+            return type;
+          type = type.get_attr<die>(dw_attrs::type);
+          break;
+        default: return type;
+      }
+    }
+  }
+
+  /**
+   * @brief The layout of one member of a struct or union.
+   */
+  struct member_layout {
+    std::string name;
+    /**
+     * @brief The byte offset from the start of the struct (0 in unions).
+     */
+    size_t offset;
+    /**
+     * @brief The base type of the member, or of its elements if it's an
+     * array. Pointers have the `address` encoding; structs, unions and
+     * bitfields have `none`.
+     */
+    base_type_info type;
+    /**
+     * @brief The number of elements: 1 unless the member is an array, in
+     * which case all dimensions are multiplied together.
+     */
+    size_t count;
+    /**
+     * @brief The tag of the member's type, or of its elements if it's an
+     * array, after stripping typedefs.
+     */
+    die_tag tag;
+    /**
+     * @brief The member's type as declared, before stripping anything.
+     */
+    std::optional<die> type_die;
+  };
+
+  /**
+   * @brief The layout of a struct or union.
+   */
+  struct record_layout {
+    std::string name;
+    size_t size;
+    bool is_union;
+    std::vector<member_layout> members;
+  };
+
+  /**
+   * @brief Returns the base type and element count of a type. Arrays are
+   * flattened.
+   */
+  inline std::pair<base_type_info, size_t> flatten_type(die type, die_tag& tag) {
+    type         = strip_typedefs(type);
+    size_t count = 1;
+    while (type.tag() == die_tag::array_type) {
+      for (auto sub = type.child(); sub; sub = sub->sibling()) {
+        if (sub->tag() != die_tag::subrange_type)
+          continue;
+        if (sub->has_attr(dw_attrs::upper_bound))
+          count *= size_t(sub->get_attr<Dwarf_Unsigned>(dw_attrs::upper_bound)) + 1;
+        else if (sub->has_attr(dw_attrs::count))
+          count *= size_t(sub->get_attr<Dwarf_Unsigned>(dw_attrs::count));
+        else
+          count = 0;
+      }
+      type = strip_typedefs(type.get_attr<die>(dw_attrs::type));
+    }
+
+    tag = type.tag();
+    base_type_info info {encoding::none, 0};
+    if (type.has_attr(dw_attrs::byte_size))
+      info.size = size_t(type.get_attr<Dwarf_Unsigned>(dw_attrs::byte_size));
+    switch (tag) {
+      case die_tag::base_type:
+        info.encoding = static_cast<encoding>(
+          type.get_attr<Dwarf_Unsigned>(dw_attrs::encoding));
+        break;
+      case die_tag::pointer_type:
+        info.encoding = encoding::address;
+        if (info.size == 0)
+          info.size = sizeof(void*);
+        break;
+      case die_tag::enumeration_type:
+        // enums take their underlying type's encoding where DWARF has it
+        if (type.has_attr(dw_attrs::type)) {
+          die_tag under;
+          info = flatten_type(type.get_attr<die>(dw_attrs::type), under).first;
+        }
+        else {
+          info.encoding = encoding::unsigned_int;
+        }
+        break;
+      default: break;
+    }
+    return {info, count};
+  }
+
+  /**
+   * @brief Reads the layout of a struct or union type.
+   *
+   * @param type a struct or union type DIE (typedefs are stripped)
+   * @return its layout
+   * @exception std::invalid_argument if `type` isn't a struct or union
+   */
+  inline record_layout read_record(die type) {
+    type        = strip_typedefs(type);
+    die_tag tag = type.tag();
+    if (tag != die_tag::structure_type && tag != die_tag::union_type) {
+      throw std::invalid_argument("Type is not a struct or union");
+    }
+
+    record_layout result {
+      type.has_attr(dw_attrs::name) ? type.get_attr<std::string>(dw_attrs::name)
+                                    : std::string(),
+      size_t(type.get_attr<Dwarf_Unsigned>(dw_attrs::byte_size)),
+      tag == die_tag::union_type,
+      {}};
+
+    for (auto child = type.child(); child; child = child->sibling()) {
+      if (child->tag() != die_tag::member)
+        continue;
+      member_layout member {
+        child->has_attr(dw_attrs::name)
+          ? child->get_attr<std::string>(dw_attrs::name)
+          : std::string(),
+        0, base_type_info {encoding::none, 0}, 1, die_tag::base_type,
+        child->get_attr<die>(dw_attrs::type)};
+      if (child->has_attr(dw_attrs::data_member_location)) {
+        member.offset = size_t(
+          child->get_attr<Dwarf_Unsigned>(dw_attrs::data_member_location));
+      }
+      auto [info, count] = flatten_type(*member.type_die, member.tag);
+      member.type        = info;
+      member.count       = count;
+      if (child->has_attr(dw_attrs::bit_size)) {
+        // bitfields don't occupy whole bytes
+        member.type.encoding = encoding::none;
+      }
+      result.members.push_back(std::move(member));
+    }
+    return result;
+  }
+}  // namespace pancake::dwarf
+#endif
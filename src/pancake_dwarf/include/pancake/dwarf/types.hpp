@@ -100,8 +100,13 @@ namespace pancake::dwarf {
         dbg(dbg_p), ptr(ptr_p, deleter {dbg, size_p}), size(size_p) {}
 
   public:
+    /**
+     * @brief Returns the number of globals.
+     */
+    size_t count() const { return size_t(size); }
+
     global operator[](size_t i) {
-      if (i > size) {
+      if (i >= size_t(size)) {
         throw std::out_of_range("Accessed out-of-range in global array");
       }
       return global(dbg, ptr[i]);
@@ -153,7 +158,7 @@ namespace pancake::dwarf {
 
   public:
     global_type operator[](size_t i) {
-      if (i > size) {
+      if (i >= size_t(size)) {
         throw std::out_of_range("Accessed out-of-range in global array");
       }
       return global_type(dbg, ptr[i]);
@@ -304,6 +309,18 @@ namespace pancake::dwarf {
       return static_cast<die_tag>(res);
     }
 
+    /**
+     * @brief Returns this DIE's offset in .debug_info, which identifies it.
+     */
+    Dwarf_Off offset() {
+      Dwarf_Error err;
+      Dwarf_Off res;
+      if (dwarf_dieoffset(ptr.get(), &res, &err) == DW_DLV_ERROR) {
+        throw std::logic_error(dwarf_errmsg(err));
+      }
+      return res;
+    }
+
     std::optional<die> child() {
       Dwarf_Die res;
       Dwarf_Error err;
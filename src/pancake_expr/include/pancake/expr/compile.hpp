@@ -11,6 +11,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include <functional>
 #include <iterator>
 #include <memory>
+#include <optional>
 #include <string>
 #include <variant>
 #include <vector>
@@ -37,12 +38,30 @@ namespace pancake::expr {
      */
     struct indirect {};
     
+    /**
+     * @brief The elements selected by a slice: the steps lead to the first
+     * one, and each next one is `stride` bytes further on.
+     */
+    struct range {
+      intptr_t stride;
+      size_t count;
+    };
+    
     using step = std::variant<offset, indirect>;
     using result_type = std::variant<dwarf::base_type_info, dwarf::die>;
     
     std::string start;
     std::vector<step> steps;
     dwarf::base_type_info result;
+    /**
+     * @brief Set if the expression has a slice.
+     */
+    std::optional<range> span;
+    /**
+     * @brief The type the expression refers to. Only one level of typedef
+     * is stripped, so it may still be a typedef, const or volatile.
+     */
+    std::optional<dwarf::die> result_die;
     
     expr_eval& operator+=(expr_eval&& eval) {
       std::copy(eval.steps.begin(), eval.steps.end(), std::back_inserter(steps));
@@ -17,6 +17,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include <any>
 #include <vector>
 #include <list>
+#include <optional>
 #include <regex>
 #include <variant>
 
@@ -39,6 +40,8 @@ namespace pancake::expr {
         subscript_end,
         dot,
         arrow,
+        wildcard,
+        colon,
       };
       type_t type;
       ptrdiff_t index;
@@ -47,11 +50,13 @@ namespace pancake::expr {
       static std::list<std::pair<token::type_t, std::regex>> instance {
         {token::type_t::identifier, R"/(^([A-Za-z_]\w*)\b)/"_re},
         {token::type_t::number,
-         R"/(^(?:((?:[1-9]\d+)|\d)|(?:0[0-7]+)|(?:0x[\dA-Fa-f]+)|(?:0b[01]+)))/"_re},
+         R"/(^(?:(?:0[xX][\dA-Fa-f]+)|(?:0[bB][01]+)|(?:0[0-7]+)|(?:[1-9]\d*)|0))/"_re},
         {token::type_t::subscript_begin, R"/(^\[)/"_re},
         {token::type_t::subscript_end, R"/(^\])/"_re},
         {token::type_t::dot, R"/(^\.)/"_re},
-        {token::type_t::arrow, R"/(^->)/"_re}
+        {token::type_t::arrow, R"/(^->)/"_re},
+        {token::type_t::wildcard, R"/(^\*)/"_re},
+        {token::type_t::colon, R"/(^:)/"_re}
       };
       return instance;
     }
@@ -69,7 +74,15 @@ namespace pancake::expr {
     struct arrow {
       std::string name;
     };
-    using step = std::variant<subscript, dot, arrow>;
+    /**
+     * @brief A range of elements, `[begin:end]`. `[*]` is every element;
+     * a missing end means the end of the array.
+     */
+    struct slice {
+      size_t begin;
+      std::optional<size_t> end;
+    };
+    using step = std::variant<subscript, dot, arrow, slice>;
     std::string global;
     std::vector<step> steps;
   };
@@ -85,6 +98,11 @@ namespace pancake::expr {
       [&](expr_ast::arrow step) mutable -> void {
         out << "deref+member " << step.name;
       },
+      [&](expr_ast::slice step) mutable -> void {
+        out << "slice " << step.begin << ":";
+        if (step.end)
+          out << *step.end;
+      },
     }, step);
     return out;
   }
@@ -0,0 +1,247 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#ifndef _PANCAKE_EXPR_VM_HPP_
+#define _PANCAKE_EXPR_VM_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <pancake/dwarf/type_info.hpp>
+#include <pancake/expr/parse.hpp>
+
+namespace pancake::expr {
+  /**
+   * @brief A parsed formula: accessor expressions combined with C-style
+   * arithmetic, comparison and logical operators, and a few math functions.
+   */
+  struct formula_ast {
+    enum class kind : uint8_t {
+      integer,
+      floating,
+      path,
+      unary,
+      binary,
+      ternary,
+      call
+    };
+
+    kind type;
+    /**
+     * @brief The operator or function name, for unary, binary and call
+     * nodes.
+     */
+    std::string op;
+    int64_t ival;
+    double fval;
+    /**
+     * @brief For path nodes, the accessor expression as written.
+     */
+    std::string text;
+    expr_ast path;
+    std::vector<formula_ast> args;
+  };
+
+  /**
+   * @brief Parses a formula.
+   * @details Grammar and precedence follow C: `?:`, `||`, `&&`, `|`, `^`,
+   * `&`, `== !=`, `< <= > >=`, `<< >>`, `+ -`, `* / %`, then unary `- + ! ~`.
+   * Operands are number literals, macro constants, function calls and
+   * accessor expressions.
+   *
+   * @param text the formula
+   * @return the parsed formula
+   * @exception std::invalid_argument if the formula is malformed
+   */
+  formula_ast parse_formula(const std::string& text);
+
+  /**
+   * @brief A formula compiled to register bytecode.
+   * @details Integer and floating-point values live in separate register
+   * files, and every opcode is specialised for its operand types and (for
+   * loads) the field's size, so evaluating is a single switch loop with no
+   * type dispatch. Field addresses are resolved when compiling, which ties a
+   * program to the game instance it was compiled for.
+   */
+  class program {
+  public:
+    enum class value_type : uint8_t { integer, floating };
+
+    enum class opcode : uint8_t {
+      // loads and constants
+      load_s8,
+      load_s16,
+      load_s32,
+      load_s64,
+      load_u8,
+      load_u16,
+      load_u32,
+      load_u64,
+      load_f32,
+      load_f64,
+      const_i,
+      const_f,
+      // conversions
+      itof,
+      ftoi,
+      bool_i,
+      bool_f,
+      // integer arithmetic
+      add_i,
+      sub_i,
+      mul_i,
+      div_i,
+      mod_i,
+      neg_i,
+      abs_i,
+      min_i,
+      max_i,
+      and_i,
+      or_i,
+      xor_i,
+      shl_i,
+      shr_i,
+      not_i,
+      lnot_i,
+      // float arithmetic
+      add_f,
+      sub_f,
+      mul_f,
+      div_f,
+      mod_f,
+      neg_f,
+      abs_f,
+      min_f,
+      max_f,
+      sqrt_f,
+      sin_f,
+      cos_f,
+      floor_f,
+      ceil_f,
+      round_f,
+      hypot_f,
+      atan2_f,
+      pow_f,
+      // comparisons, all producing integers
+      eq_i,
+      ne_i,
+      lt_i,
+      le_i,
+      eq_f,
+      ne_f,
+      lt_f,
+      le_f,
+      // selects, with the condition register in `arg.reg`
+      select_i,
+      select_f,
+    };
+
+    /**
+     * @brief One instruction. `dst`, `a` and `b` index the register file
+     * matching the opcode's operand types.
+     */
+    struct insn {
+      opcode op;
+      uint16_t dst;
+      uint16_t a;
+      uint16_t b;
+      union {
+        const void* ptr;
+        int64_t imm_i;
+        double imm_f;
+        uint32_t reg;
+      } arg;
+    };
+
+    /**
+     * @brief A resolved field: its address and base type.
+     */
+    struct operand {
+      const void* ptr;
+      dwarf::base_type_info type;
+    };
+    /**
+     * @brief Resolves an accessor expression, as written, to a field.
+     */
+    using resolver = std::function<operand(const std::string&)>;
+
+  private:
+    struct compiler;
+
+    std::vector<insn> m_code;
+    mutable std::vector<int64_t> m_ints;
+    mutable std::vector<double> m_floats;
+    value_type m_type;
+    uint16_t m_result;
+
+    static void exec(
+      const insn* pc, const insn* end, int64_t* ints, double* floats);
+    void run() const {
+      exec(
+        m_code.data(), m_code.data() + m_code.size(), m_ints.data(),
+        m_floats.data());
+    }
+
+    friend program compile_formula(const formula_ast&, const resolver&);
+
+  public:
+    /**
+     * @brief Returns the type of the formula's result.
+     */
+    value_type type() const { return m_type; }
+    /**
+     * @brief Returns the bytecode.
+     */
+    const std::vector<insn>& code() const { return m_code; }
+
+    /**
+     * @brief Evaluates the formula, converting the result to a double.
+     */
+    double eval() const {
+      run();
+      return (m_type == value_type::floating) ? m_floats[m_result]
+                                              : double(m_ints[m_result]);
+    }
+    /**
+     * @brief Evaluates the formula, converting the result to an integer.
+     */
+    int64_t eval_int() const {
+      run();
+      return (m_type == value_type::floating) ? int64_t(m_floats[m_result])
+                                              : m_ints[m_result];
+    }
+    /**
+     * @brief Evaluates the formula as a condition (true if nonzero).
+     */
+    bool test() const {
+      run();
+      return (m_type == value_type::floating) ? m_floats[m_result] != 0
+                                              : m_ints[m_result] != 0;
+    }
+    bool operator()() const { return test(); }
+  };
+
+  /**
+   * @brief Compiles a parsed formula.
+   * @details Integer operands stay integers (with C semantics, except that
+   * dividing by zero gives 0); an operation with any floating-point operand
+   * is done in doubles. Comparisons and logical operators give 0 or 1.
+   * Subexpressions made only of constants are folded.
+   *
+   * @param ast the formula
+   * @param resolve resolves accessor expressions
+   * @return the program
+   * @exception std::invalid_argument on unknown functions, wrong argument
+   * counts or bitwise operators on floats
+   * @exception std::invalid_argument if a field isn't an integer or
+   * floating-point type; `resolve` may also throw
+   */
+  program compile_formula(const formula_ast& ast, const program::resolver& resolve);
+}  // namespace pancake::expr
+#endif
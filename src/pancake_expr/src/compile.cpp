@@ -14,12 +14,14 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include <iostream>
 #include <limits>
 #include <memory>
+#include <optional>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <typeinfo>
 #include <utility>
 #include <variant>
+#include <vector>
 #include <pancake/dwarf/type_info.hpp>
 #include <pancake/dwarf/types.hpp>
 
@@ -42,10 +44,65 @@ namespace {
           },
           [&](const pancake::expr::expr_ast::subscript& step) {
             out << "[" << step.index << "]";
+          },
+          [&](const pancake::expr::expr_ast::slice& step) {
+            out << "[" << step.begin << ":";
+            if (step.end)
+              out << *step.end;
+            out << "]";
           }},
         ast.steps[i]);
     }
   }
+
+  // Returns the length of each of an array type's dimensions, outermost
+  // first, where DWARF records it. Other types have no dimensions.
+  std::vector<std::optional<size_t>> array_dims(pancake::dwarf::die die) {
+    namespace dwarf = pancake::dwarf;
+    std::vector<std::optional<size_t>> dims;
+    if (die.tag() != dwarf::die_tag::array_type)
+      return dims;
+    for (auto sub = die.child(); sub; sub = sub->sibling()) {
+      if (sub->tag() != dwarf::die_tag::subrange_type)
+        continue;
+      if (sub->has_attr(dwarf::dw_attrs::upper_bound))
+        dims.push_back(size_t(sub->get_attr<Dwarf_Unsigned>(dwarf::dw_attrs::upper_bound)) + 1);
+      else if (sub->has_attr(dwarf::dw_attrs::count))
+        dims.push_back(size_t(sub->get_attr<Dwarf_Unsigned>(dwarf::dw_attrs::count)));
+      else
+        dims.push_back(std::nullopt);
+    }
+    return dims;
+  }
+
+  // Returns the distance in bytes between consecutive indices of dimension
+  // `dim` of an array (or of a pointer's target): the element size, times
+  // the lengths of the dimensions after it.
+  intptr_t dim_stride(
+    pancake::dwarf::die die, const std::vector<std::optional<size_t>>& dims,
+    size_t dim) {
+    namespace dwarf = pancake::dwarf;
+    intptr_t stride;
+    if (die.has_attr(dwarf::dw_attrs::byte_stride)) {
+      // use byte stride if available
+      stride = static_cast<intptr_t>(
+        die.get_attr<Dwarf_Unsigned>(dwarf::dw_attrs::byte_stride));
+    }
+    else {
+      // size of member otherwise
+      auto type_die = die.get_attr<dwarf::die>(dwarf::dw_attrs::type);
+      if (type_die.tag() == dwarf::die_tag::typedef_)
+        type_die = type_die.get_attr<dwarf::die>(dwarf::dw_attrs::type);
+      stride = static_cast<intptr_t>(
+        type_die.get_attr<Dwarf_Unsigned>(dwarf::dw_attrs::byte_size));
+    }
+    for (size_t d = dim + 1; d < dims.size(); d++) {
+      if (!dims[d])
+        throw invalid_argument("Array has a dimension of unknown length");
+      stride *= static_cast<intptr_t>(*dims[d]);
+    }
+    return stride;
+  }
 }  // namespace
 
 namespace pancake::expr {
@@ -64,6 +121,21 @@ namespace pancake::expr {
     if (die.tag() == dwarf::die_tag::typedef_)
       die = die.get_attr<dwarf::die>(dwarf::dw_attrs::type);
     
+    // steps before this index lead to the first element of a slice
+    size_t slice_end = 0;
+    
+    // DWARF puts all of an array's dimensions in one DIE, so `die` stays on
+    // the array until every dimension has been indexed
+    size_t dim = 0;
+    auto next_dim = [&](const std::vector<std::optional<size_t>>& dims) {
+      if (++dim < dims.size())
+        return;
+      dim = 0;
+      die = die.get_attr<dwarf::die>(dwarf::dw_attrs::type);
+      if (die.tag() == dwarf::die_tag::typedef_)
+        die = die.get_attr<dwarf::die>(dwarf::dw_attrs::type);
+    };
+    
     auto& steps = ast.steps;
     for (size_t i = 0; i < steps.size(); i++) {
       std::visit(
@@ -75,31 +147,10 @@ namespace pancake::expr {
               }
               // fall through case here, since logic is basically the same
               case dwarf::die_tag::array_type: {
-                if (die.has_attr(dwarf::dw_attrs::byte_stride)) {
-                  // use byte stride if available
-                  result.steps.push_back(
-                    expr_eval::step(expr_eval::offset {static_cast<intptr_t>(
-                      die.get_attr<Dwarf_Unsigned>(
-                        dwarf::dw_attrs::byte_stride) *
-                      step.index)}));
-                }
-                else {
-                  // size of member otherwise
-                  auto type_die =
-                    die.get_attr<dwarf::die>(dwarf::dw_attrs::type);
-                  if (type_die.tag() == dwarf::die_tag::typedef_)
-                    type_die =
-                      type_die.get_attr<dwarf::die>(dwarf::dw_attrs::type);
-
-                  auto size = type_die.get_attr<Dwarf_Unsigned>(
-                    dwarf::dw_attrs::byte_size);
-                  // cerr << "Size value is " << size << "\n";
-                  result.steps.push_back(expr_eval::offset {
-                    static_cast<intptr_t>(size * step.index)});
-                }
-                die = die.get_attr<dwarf::die>(dwarf::dw_attrs::type);
-                if (die.tag() == dwarf::die_tag::typedef_)
-                  die = die.get_attr<dwarf::die>(dwarf::dw_attrs::type);
+                auto dims = array_dims(die);
+                result.steps.push_back(expr_eval::offset {
+                  dim_stride(die, dims, dim) * static_cast<intptr_t>(step.index)});
+                next_dim(dims);
               } break;
               default: {
                 stringstream fmt;
@@ -111,6 +162,55 @@ namespace pancake::expr {
               }
             }
           },
+          [&](const expr_ast::slice& step) mutable {
+            dwarf::die_tag tag = die.tag();
+            if (!(tag == dwarf::die_tag::pointer_type ||
+                  tag == dwarf::die_tag::array_type)) {
+              stringstream fmt;
+              fmt << "\033[0;38;5;38m";
+              print_ast(fmt, ast, i);
+              fmt << "\033[0m is not a pointer or array, ";
+              fmt << "actually is " << tag;
+              throw invalid_argument(fmt.str());
+            }
+            if (result.span) {
+              throw invalid_argument("Expressions can only have one slice");
+            }
+
+            auto dims = array_dims(die);
+            std::optional<size_t> length =
+              (dim < dims.size()) ? dims[dim] : std::nullopt;
+            size_t end;
+            if (step.end)
+              end = *step.end;
+            else if (length)
+              end = *length;
+            else {
+              stringstream fmt;
+              fmt << "\033[0;38;5;38m";
+              print_ast(fmt, ast, i);
+              fmt << "\033[0m has no known length, so slices of it need an end";
+              throw invalid_argument(fmt.str());
+            }
+            if (step.begin > end || (length && end > *length)) {
+              stringstream fmt;
+              fmt << "Slice " << step.begin << ":" << end << " of \033[0;38;5;38m";
+              print_ast(fmt, ast, i);
+              fmt << "\033[0m is out of bounds";
+              throw std::out_of_range(fmt.str());
+            }
+
+            if (tag == dwarf::die_tag::pointer_type)
+              result.steps.push_back(expr_eval::indirect {});
+            intptr_t stride = dim_stride(die, dims, dim);
+            if (step.begin != 0) {
+              result.steps.push_back(expr_eval::offset {
+                static_cast<intptr_t>(stride * step.begin)});
+            }
+            result.span = expr_eval::range {stride, end - step.begin};
+            slice_end   = result.steps.size();
+            next_dim(dims);
+          },
           [&](const expr_ast::dot& step) mutable {
             dwarf::die_tag tag = die.tag();
             if (!(tag == dwarf::die_tag::structure_type ||
@@ -124,7 +224,7 @@ namespace pancake::expr {
 
             // Search for the correct member
             dwarf::die child = die.child().value();
-            bool found;
+            bool found = false;
             do {
               if (
                 child.get_attr<std::string>(dwarf::dw_attrs::name) ==
@@ -186,7 +286,7 @@ namespace pancake::expr {
 
             // Search for the correct member
             dwarf::die child = die.child().value();
-            bool found;
+            bool found = false;
             do {
               if (
                 child.get_attr<std::string>(dwarf::dw_attrs::name) ==
@@ -228,9 +328,31 @@ namespace pancake::expr {
         },
         steps[i]);
     }
+    if (dim != 0) {
+      stringstream fmt;
+      fmt << "\033[0;38;5;38m";
+      print_ast(fmt, ast, ast.steps.size());
+      fmt << "\033[0m is part of a multi-dimensional array; index all "
+          << array_dims(die).size() << " dimensions";
+      throw invalid_argument(fmt.str());
+    }
     if (die.tag() == dwarf::die_tag::typedef_)
       die = die.get_attr<dwarf::die>(dwarf::dw_attrs::type);
+    
+    // Elements must be evenly spaced, so no pointers after a slice
+    if (result.span) {
+      for (size_t i = slice_end; i < result.steps.size(); i++) {
+        if (std::holds_alternative<expr_eval::indirect>(result.steps[i])) {
+          stringstream fmt;
+          fmt << "\033[0;38;5;38m";
+          print_ast(fmt, ast, ast.steps.size());
+          fmt << "\033[0m follows a pointer after a slice";
+          throw invalid_argument(fmt.str());
+        }
+      }
+    }
 
+    result.result_die = die;
     dwarf::die_tag tag = die.tag();
     switch (tag) {
       case dwarf::die_tag::base_type: {
@@ -12,6 +12,7 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 #include <cstdint>
 #include <iostream>
 #include <map>
+#include <optional>
 #include <regex>
 #include <sstream>
 #include <stdexcept>
@@ -110,11 +111,13 @@ namespace pancake::expr {
           result.push_back(
             {std::to_string(obj.at("value").get<int64_t>()),
              token::type_t::number, begin - expr.begin()});
+          continue;
         }
         else if (type == "f64") {
           throw std::invalid_argument("Floating point values are not allowed");
         }
-        else if (type == "null") {
+        else if (type == "void") {
+          throw std::invalid_argument(string(matched) + " has no value");
         }
         throw std::logic_error(
           "Pancake was compiled with a broken sm64_macro_defns.json. "
@@ -130,6 +133,13 @@ namespace pancake::expr {
     return result;
   }
 
+  // Parses an index, which may be decimal, hex, octal or binary.
+  size_t parse_index(const string& text) {
+    if (text.size() > 2 && text[0] == '0' && (text[1] == 'b' || text[1] == 'B'))
+      return std::stoull(text.substr(2), nullptr, 2);
+    return std::stoull(text, nullptr, 0);
+  }
+
   // Parses a lexed expression.
   expr_ast parse(const std::vector<lexer::token>& tokens, const string& expr) {
     using lexer::token;
@@ -142,23 +152,45 @@ namespace pancake::expr {
     while (i < tokens.size()) {
       switch (tokens[i].type) {
         case token::type_t::subscript_begin: {
-          if (
-            i + 2 >= tokens.size() ||
-            tokens[i + 2].type != token::type_t::subscript_end) {
+          // [n], [*], or a slice: [a:b], [a:], [:b], [:]
+          auto is = [&](size_t k, type_t type) {
+            return k < tokens.size() && tokens[k].type == type;
+          };
+          size_t j = i + 1;
+          std::optional<size_t> lo, hi;
+          bool slice = false;
+          if (is(j, type_t::wildcard)) {
+            slice = true;
+            lo    = 0;
+            j++;
+          }
+          else {
+            if (is(j, type_t::number))
+              lo = parse_index(tokens[j++].text);
+            if (is(j, type_t::colon)) {
+              slice = true;
+              j++;
+              if (is(j, type_t::number))
+                hi = parse_index(tokens[j++].text);
+            }
+          }
+          if (!is(j, type_t::subscript_end)) {
             stringstream fmt;
             fmt << "Error parsing \"" << expr << "\": Bracket at index ";
-            fmt << tokens[i].index << " is unclosed";
+            fmt << tokens[i].index << " is unclosed or malformed";
             throw std::invalid_argument(fmt.str());
           }
-          if (tokens[i + 1].type != token::type_t::number) {
+          if (!slice && !lo) {
             stringstream fmt;
-            fmt << "Error parsing \"" << expr << "\": Subscript at index";
+            fmt << "Error parsing \"" << expr << "\": Subscript at index ";
             fmt << tokens[i].index << " does not contain an index";
             throw std::invalid_argument(fmt.str());
           }
-          result.steps.push_back(
-            expr_ast::subscript {std::stoull(tokens[i + 1].text)});
-          i += 3;
+          if (slice)
+            result.steps.push_back(expr_ast::slice {lo.value_or(0), hi});
+          else
+            result.steps.push_back(expr_ast::subscript {*lo});
+          i = j + 1;
         } break;
         case token::type_t::dot: {
           if (
@@ -185,11 +217,12 @@ namespace pancake::expr {
           }
           result.steps.push_back(expr_ast::arrow {tokens[i + 1].text});
           i += 2;
-        }
+        } break;
         default: {
           stringstream fmt;
           fmt << "Error parsing \"" << expr << "\": unexpected token \"";
           fmt << tokens[i].text << "\" at index " << tokens[i].index;
+          throw std::invalid_argument(fmt.str());
         } break;
       }
     }
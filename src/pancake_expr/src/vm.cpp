@@ -0,0 +1,712 @@
+/******************************************************************
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+******************************************************************/
+
+#include <pancake/expr/vm.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <pancake/dwarf/enums.hpp>
+#include <pancake/expr/parse.hpp>
+#include <pancake/macro_defns.hpp>
+
+using std::string, std::stringstream;
+using pancake::expr::formula_ast;
+using pancake::expr::program;
+
+namespace {
+  // Every operator, longest first so that e.g. "<=" wins over "<".
+  const char* const operators[] = {
+    "<<", ">>", "<=", ">=", "==", "!=", "&&", "||", "<", ">", "+", "-", "*",
+    "/",  "%",  "&",  "|",  "^",  "!",  "~",  "?",  ":", "(", ")", ","};
+
+  // Binary operators by precedence, loosest first.
+  const std::vector<std::vector<string>> binary_levels = {
+    {"||"}, {"&&"}, {"|"},  {"^"}, {"&"}, {"==", "!="}, {"<", "<=", ">", ">="},
+    {"<<", ">>"}, {"+", "-"}, {"*", "/", "%"}};
+
+  bool is_ident_start(char c) {
+    return std::isalpha(static_cast<unsigned char>(c)) || c == '_';
+  }
+  bool is_ident_char(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+  }
+
+  formula_ast make_node(
+    formula_ast::kind type, string op, std::vector<formula_ast> args) {
+    formula_ast result {type, std::move(op), 0, 0, {}, {}, std::move(args)};
+    return result;
+  }
+
+  class formula_parser {
+    const string& m_text;
+    size_t m_pos;
+
+    [[noreturn]] void fail(const string& what, size_t at) const {
+      stringstream fmt;
+      fmt << "Error parsing \"" << m_text << "\": " << what << " at index "
+          << at;
+      throw std::invalid_argument(fmt.str());
+    }
+
+    void skip_ws() {
+      while (m_pos < m_text.size() &&
+             std::isspace(static_cast<unsigned char>(m_text[m_pos])))
+        m_pos++;
+    }
+
+    // Returns the operator at the current position, or an empty string.
+    string peek_op() {
+      skip_ws();
+      for (const char* op : operators) {
+        if (m_text.compare(m_pos, std::char_traits<char>::length(op), op) == 0)
+          return op;
+      }
+      return string();
+    }
+
+    bool accept(const string& op) {
+      if (peek_op() != op)
+        return false;
+      m_pos += op.size();
+      return true;
+    }
+
+    void expect(const string& op) {
+      if (!accept(op))
+        fail("expected \"" + op + "\"", m_pos);
+    }
+
+    formula_ast ternary() {
+      formula_ast cond = binary(0);
+      if (!accept("?"))
+        return cond;
+      formula_ast yes = ternary();
+      expect(":");
+      formula_ast no = ternary();
+      return make_node(
+        formula_ast::kind::ternary, "?:",
+        {std::move(cond), std::move(yes), std::move(no)});
+    }
+
+    formula_ast binary(size_t level) {
+      if (level == binary_levels.size())
+        return unary();
+      formula_ast lhs = binary(level + 1);
+      for (;;) {
+        string op           = peek_op();
+        const auto& choices = binary_levels[level];
+        if (std::find(choices.begin(), choices.end(), op) == choices.end())
+          return lhs;
+        m_pos += op.size();
+        formula_ast rhs = binary(level + 1);
+        lhs             = make_node(
+          formula_ast::kind::binary, op, {std::move(lhs), std::move(rhs)});
+      }
+    }
+
+    formula_ast unary() {
+      string op = peek_op();
+      if (op == "-" || op == "+" || op == "!" || op == "~") {
+        m_pos += op.size();
+        return make_node(formula_ast::kind::unary, op, {unary()});
+      }
+      return primary();
+    }
+
+    formula_ast number() {
+      size_t start    = m_pos;
+      const char* str = m_text.c_str() + m_pos;
+      char* end_i;
+      char* end_f;
+      formula_ast result = make_node(formula_ast::kind::integer, "", {});
+
+      if (str[0] == '0' && (str[1] == 'b' || str[1] == 'B')) {
+        result.ival = int64_t(std::strtoull(str + 2, &end_i, 2));
+        if (end_i == str + 2)
+          fail("invalid binary literal", start);
+        m_pos += end_i - str;
+      }
+      else {
+        uint64_t ival = std::strtoull(str, &end_i, 0);
+        double fval   = std::strtod(str, &end_f);
+        if (end_f > end_i) {
+          result.type = formula_ast::kind::floating;
+          result.fval = fval;
+          m_pos += end_f - str;
+          if (m_pos < m_text.size() && (m_text[m_pos] == 'f' || m_text[m_pos] == 'F'))
+            m_pos++;
+        }
+        else {
+          result.ival = int64_t(ival);
+          m_pos += end_i - str;
+        }
+      }
+      if (m_pos < m_text.size() && is_ident_char(m_text[m_pos]))
+        fail("invalid number literal", start);
+      return result;
+    }
+
+    // Consumes an accessor expression's steps after its leading identifier.
+    // Accessor expressions can't contain whitespace.
+    void path_steps() {
+      for (;;) {
+        if (m_pos >= m_text.size())
+          return;
+        char c = m_text[m_pos];
+        if (c == '[') {
+          size_t close = m_text.find(']', m_pos);
+          if (close == string::npos)
+            fail("unclosed bracket", m_pos);
+          m_pos = close + 1;
+        }
+        else if (
+          c == '.' && m_pos + 1 < m_text.size() &&
+          is_ident_start(m_text[m_pos + 1])) {
+          m_pos++;
+          identifier();
+        }
+        else if (
+          m_text.compare(m_pos, 2, "->") == 0 && m_pos + 2 < m_text.size() &&
+          is_ident_start(m_text[m_pos + 2])) {
+          m_pos += 2;
+          identifier();
+        }
+        else {
+          return;
+        }
+      }
+    }
+
+    string identifier() {
+      size_t start = m_pos;
+      while (m_pos < m_text.size() && is_ident_char(m_text[m_pos]))
+        m_pos++;
+      return m_text.substr(start, m_pos - start);
+    }
+
+    formula_ast primary() {
+      skip_ws();
+      if (m_pos >= m_text.size())
+        fail("unexpected end of formula", m_pos);
+
+      char c = m_text[m_pos];
+      if (accept("(")) {
+        formula_ast inner = ternary();
+        expect(")");
+        return inner;
+      }
+      if (
+        std::isdigit(static_cast<unsigned char>(c)) ||
+        (c == '.' && m_pos + 1 < m_text.size() &&
+         std::isdigit(static_cast<unsigned char>(m_text[m_pos + 1])))) {
+        return number();
+      }
+      if (!is_ident_start(c))
+        fail("unexpected character", m_pos);
+
+      size_t start = m_pos;
+      string name  = identifier();
+
+      // function call
+      size_t after = m_pos;
+      if (accept("(")) {
+        formula_ast call = make_node(formula_ast::kind::call, name, {});
+        if (!accept(")")) {
+          do {
+            call.args.push_back(ternary());
+          } while (accept(","));
+          expect(")");
+        }
+        return call;
+      }
+      m_pos = after;
+
+      // macro constant
+      path_steps();
+      if (m_pos == after) {
+        static const nlohmann::json constants =
+          pancake::sm64_macro_defns::get()["constants"];
+        auto entry = constants.find(name);
+        if (entry != constants.end()) {
+          const string type = entry->at("type");
+          if (type == "s64") {
+            formula_ast result = make_node(formula_ast::kind::integer, "", {});
+            result.ival        = entry->at("value").get<int64_t>();
+            return result;
+          }
+          else if (type == "f64") {
+            formula_ast result = make_node(formula_ast::kind::floating, "", {});
+            result.fval        = entry->at("value").get<double>();
+            return result;
+          }
+          fail("constant " + name + " has no value", start);
+        }
+      }
+
+      formula_ast result = make_node(formula_ast::kind::path, "", {});
+      result.text        = m_text.substr(start, m_pos - start);
+      result.path        = pancake::expr::parse(result.text);
+      return result;
+    }
+
+  public:
+    formula_parser(const string& text) : m_text(text), m_pos(0) {}
+
+    formula_ast parse() {
+      formula_ast result = ternary();
+      skip_ws();
+      if (m_pos != m_text.size())
+        fail("unexpected \"" + m_text.substr(m_pos, 1) + "\"", m_pos);
+      return result;
+    }
+  };
+
+  // Wrapping integer arithmetic, to avoid signed overflow.
+  int64_t wrap_add(int64_t a, int64_t b) { return int64_t(uint64_t(a) + uint64_t(b)); }
+  int64_t wrap_sub(int64_t a, int64_t b) { return int64_t(uint64_t(a) - uint64_t(b)); }
+  int64_t wrap_mul(int64_t a, int64_t b) { return int64_t(uint64_t(a) * uint64_t(b)); }
+}  // namespace
+
+namespace pancake::expr {
+  formula_ast parse_formula(const string& text) {
+    return formula_parser(text).parse();
+  }
+
+  void program::exec(
+    const insn* pc, const insn* end, int64_t* ri, double* rf) {
+    for (; pc != end; ++pc) {
+      const insn& in = *pc;
+      switch (in.op) {
+        case opcode::load_s8: ri[in.dst] = *static_cast<const int8_t*>(in.arg.ptr); break;
+        case opcode::load_s16: ri[in.dst] = *static_cast<const int16_t*>(in.arg.ptr); break;
+        case opcode::load_s32: ri[in.dst] = *static_cast<const int32_t*>(in.arg.ptr); break;
+        case opcode::load_s64: ri[in.dst] = *static_cast<const int64_t*>(in.arg.ptr); break;
+        case opcode::load_u8: ri[in.dst] = *static_cast<const uint8_t*>(in.arg.ptr); break;
+        case opcode::load_u16: ri[in.dst] = *static_cast<const uint16_t*>(in.arg.ptr); break;
+        case opcode::load_u32: ri[in.dst] = *static_cast<const uint32_t*>(in.arg.ptr); break;
+        case opcode::load_u64: ri[in.dst] = int64_t(*static_cast<const uint64_t*>(in.arg.ptr)); break;
+        case opcode::load_f32: rf[in.dst] = *static_cast<const float*>(in.arg.ptr); break;
+        case opcode::load_f64: rf[in.dst] = *static_cast<const double*>(in.arg.ptr); break;
+        case opcode::const_i: ri[in.dst] = in.arg.imm_i; break;
+        case opcode::const_f: rf[in.dst] = in.arg.imm_f; break;
+
+        case opcode::itof: rf[in.dst] = double(ri[in.a]); break;
+        case opcode::ftoi: {
+          double v = rf[in.a];
+          // out-of-range conversions are undefined, so saturate them
+          if (!(v == v))
+            ri[in.dst] = 0;
+          else if (v >= 9223372036854775807.0)
+            ri[in.dst] = std::numeric_limits<int64_t>::max();
+          else if (v <= -9223372036854775808.0)
+            ri[in.dst] = std::numeric_limits<int64_t>::min();
+          else
+            ri[in.dst] = int64_t(v);
+        } break;
+        case opcode::bool_i: ri[in.dst] = ri[in.a] != 0; break;
+        case opcode::bool_f: ri[in.dst] = rf[in.a] != 0; break;
+
+        case opcode::add_i: ri[in.dst] = wrap_add(ri[in.a], ri[in.b]); break;
+        case opcode::sub_i: ri[in.dst] = wrap_sub(ri[in.a], ri[in.b]); break;
+        case opcode::mul_i: ri[in.dst] = wrap_mul(ri[in.a], ri[in.b]); break;
+        case opcode::div_i: {
+          int64_t a = ri[in.a], b = ri[in.b];
+          ri[in.dst] = (b == 0) ? 0 : (b == -1) ? wrap_sub(0, a) : a / b;
+        } break;
+        case opcode::mod_i: {
+          int64_t a = ri[in.a], b = ri[in.b];
+          ri[in.dst] = (b == 0 || b == -1) ? 0 : a % b;
+        } break;
+        case opcode::neg_i: ri[in.dst] = wrap_sub(0, ri[in.a]); break;
+        case opcode::abs_i: {
+          int64_t a  = ri[in.a];
+          ri[in.dst] = (a < 0) ? wrap_sub(0, a) : a;
+        } break;
+        case opcode::min_i: ri[in.dst] = std::min(ri[in.a], ri[in.b]); break;
+        case opcode::max_i: ri[in.dst] = std::max(ri[in.a], ri[in.b]); break;
+        case opcode::and_i: ri[in.dst] = ri[in.a] & ri[in.b]; break;
+        case opcode::or_i: ri[in.dst] = ri[in.a] | ri[in.b]; break;
+        case opcode::xor_i: ri[in.dst] = ri[in.a] ^ ri[in.b]; break;
+        case opcode::shl_i: ri[in.dst] = int64_t(uint64_t(ri[in.a]) << (ri[in.b] & 63)); break;
+        case opcode::shr_i: ri[in.dst] = ri[in.a] >> (ri[in.b] & 63); break;
+        case opcode::not_i: ri[in.dst] = ~ri[in.a]; break;
+        case opcode::lnot_i: ri[in.dst] = ri[in.a] == 0; break;
+
+        case opcode::add_f: rf[in.dst] = rf[in.a] + rf[in.b]; break;
+        case opcode::sub_f: rf[in.dst] = rf[in.a] - rf[in.b]; break;
+        case opcode::mul_f: rf[in.dst] = rf[in.a] * rf[in.b]; break;
+        case opcode::div_f: rf[in.dst] = rf[in.a] / rf[in.b]; break;
+        case opcode::mod_f: rf[in.dst] = std::fmod(rf[in.a], rf[in.b]); break;
+        case opcode::neg_f: rf[in.dst] = -rf[in.a]; break;
+        case opcode::abs_f: rf[in.dst] = std::fabs(rf[in.a]); break;
+        case opcode::min_f: rf[in.dst] = std::fmin(rf[in.a], rf[in.b]); break;
+        case opcode::max_f: rf[in.dst] = std::fmax(rf[in.a], rf[in.b]); break;
+        case opcode::sqrt_f: rf[in.dst] = std::sqrt(rf[in.a]); break;
+        case opcode::sin_f: rf[in.dst] = std::sin(rf[in.a]); break;
+        case opcode::cos_f: rf[in.dst] = std::cos(rf[in.a]); break;
+        case opcode::floor_f: rf[in.dst] = std::floor(rf[in.a]); break;
+        case opcode::ceil_f: rf[in.dst] = std::ceil(rf[in.a]); break;
+        case opcode::round_f: rf[in.dst] = std::round(rf[in.a]); break;
+        case opcode::hypot_f: {
+          // game values are far from overflowing, so skip std::hypot's
+          // (slow) scaling
+          double a = rf[in.a], b = rf[in.b];
+          rf[in.dst] = std::sqrt(a * a + b * b);
+        } break;
+        case opcode::atan2_f: rf[in.dst] = std::atan2(rf[in.a], rf[in.b]); break;
+        case opcode::pow_f: rf[in.dst] = std::pow(rf[in.a], rf[in.b]); break;
+
+        case opcode::eq_i: ri[in.dst] = ri[in.a] == ri[in.b]; break;
+        case opcode::ne_i: ri[in.dst] = ri[in.a] != ri[in.b]; break;
+        case opcode::lt_i: ri[in.dst] = ri[in.a] < ri[in.b]; break;
+        case opcode::le_i: ri[in.dst] = ri[in.a] <= ri[in.b]; break;
+        case opcode::eq_f: ri[in.dst] = rf[in.a] == rf[in.b]; break;
+        case opcode::ne_f: ri[in.dst] = rf[in.a] != rf[in.b]; break;
+        case opcode::lt_f: ri[in.dst] = rf[in.a] < rf[in.b]; break;
+        case opcode::le_f: ri[in.dst] = rf[in.a] <= rf[in.b]; break;
+
+        case opcode::select_i: ri[in.dst] = ri[in.arg.reg] ? ri[in.a] : ri[in.b]; break;
+        case opcode::select_f: rf[in.dst] = ri[in.arg.reg] ? rf[in.a] : rf[in.b]; break;
+      }
+    }
+  }
+
+  struct program::compiler {
+    struct value {
+      value_type type;
+      uint16_t reg;
+      bool constant;
+    };
+
+    const resolver& resolve;
+    std::vector<insn> code;
+    size_t num_ints   = 0;
+    size_t num_floats = 0;
+
+    compiler(const resolver& r) : resolve(r) {}
+
+    uint16_t alloc(value_type type) {
+      size_t& count = (type == value_type::integer) ? num_ints : num_floats;
+      if (count > std::numeric_limits<uint16_t>::max()) {
+        throw std::invalid_argument("Formula is too large");
+      }
+      return uint16_t(count++);
+    }
+
+    value emit(
+      opcode op, value_type type, uint16_t a = 0, uint16_t b = 0,
+      bool constant = false) {
+      insn in {op, alloc(type), a, b, {nullptr}};
+      code.push_back(in);
+      return value {type, in.dst, constant};
+    }
+
+    value const_int(int64_t x) {
+      value v                = emit(opcode::const_i, value_type::integer, 0, 0, true);
+      code.back().arg.imm_i = x;
+      return v;
+    }
+    value const_float(double x) {
+      value v                = emit(opcode::const_f, value_type::floating, 0, 0, true);
+      code.back().arg.imm_f = x;
+      return v;
+    }
+
+    value to_float(value v) {
+      if (v.type == value_type::floating)
+        return v;
+      if (v.constant && code.back().op == opcode::const_i &&
+          code.back().dst == v.reg) {
+        // converting a literal that was just emitted
+        double x = double(code.back().arg.imm_i);
+        code.pop_back();
+        num_ints--;
+        return const_float(x);
+      }
+      return emit(opcode::itof, value_type::floating, v.reg, 0, v.constant);
+    }
+    value to_int(value v) {
+      if (v.type == value_type::integer)
+        return v;
+      return emit(opcode::ftoi, value_type::integer, v.reg, 0, v.constant);
+    }
+    value to_bool(value v) {
+      return emit(
+        (v.type == value_type::integer) ? opcode::bool_i : opcode::bool_f,
+        value_type::integer, v.reg, 0, v.constant);
+    }
+    value require_int(value v, const string& op) {
+      if (v.type != value_type::integer) {
+        throw std::invalid_argument(
+          "Operator " + op + " needs integer operands");
+      }
+      return v;
+    }
+
+    // Emits a binary op, choosing the integer or float version.
+    value arith(opcode op_i, opcode op_f, value a, value b, bool compare) {
+      bool constant = a.constant && b.constant;
+      if (a.type == value_type::integer && b.type == value_type::integer) {
+        return emit(
+          op_i, value_type::integer, a.reg, b.reg, constant);
+      }
+      a = to_float(a);
+      b = to_float(b);
+      return emit(
+        op_f, compare ? value_type::integer : value_type::floating, a.reg,
+        b.reg, constant);
+    }
+
+    value load(const string& text) {
+      operand field = resolve(text);
+      opcode op;
+      switch (field.type.encoding) {
+        case dwarf::encoding::floating_point:
+          switch (field.type.size) {
+            case 4: op = opcode::load_f32; break;
+            case 8: op = opcode::load_f64; break;
+            default:
+              throw std::invalid_argument(
+                text + " is a floating-point type of unsupported size");
+          }
+          break;
+        case dwarf::encoding::signed_int:
+        case dwarf::encoding::signed_char:
+          switch (field.type.size) {
+            case 1: op = opcode::load_s8; break;
+            case 2: op = opcode::load_s16; break;
+            case 4: op = opcode::load_s32; break;
+            case 8: op = opcode::load_s64; break;
+            default:
+              throw std::invalid_argument(
+                text + " is an integer type of unsupported size");
+          }
+          break;
+        case dwarf::encoding::unsigned_int:
+        case dwarf::encoding::unsigned_char:
+        case dwarf::encoding::boolean:
+        case dwarf::encoding::address:
+          switch (field.type.size) {
+            case 1: op = opcode::load_u8; break;
+            case 2: op = opcode::load_u16; break;
+            case 4: op = opcode::load_u32; break;
+            case 8: op = opcode::load_u64; break;
+            default:
+              throw std::invalid_argument(
+                text + " is an integer type of unsupported size");
+          }
+          break;
+        default:
+          throw std::invalid_argument(
+            text + " is not an integer or floating-point type");
+      }
+      value v = emit(
+        op,
+        (op == opcode::load_f32 || op == opcode::load_f64)
+          ? value_type::floating
+          : value_type::integer);
+      code.back().arg.ptr = field.ptr;
+      return v;
+    }
+
+    value unary(const formula_ast& node) {
+      value a = compile(node.args[0]);
+      if (node.op == "+")
+        return a;
+      if (node.op == "-") {
+        return emit(
+          (a.type == value_type::integer) ? opcode::neg_i : opcode::neg_f,
+          a.type, a.reg, 0, a.constant);
+      }
+      if (node.op == "~") {
+        require_int(a, node.op);
+        return emit(opcode::not_i, value_type::integer, a.reg, 0, a.constant);
+      }
+      // "!"
+      if (a.type == value_type::floating)
+        a = to_bool(a);
+      return emit(opcode::lnot_i, value_type::integer, a.reg, 0, a.constant);
+    }
+
+    value binary(const formula_ast& node) {
+      const string& op = node.op;
+      value a          = compile(node.args[0]);
+      value b          = compile(node.args[1]);
+
+      if (op == "+")
+        return arith(opcode::add_i, opcode::add_f, a, b, false);
+      if (op == "-")
+        return arith(opcode::sub_i, opcode::sub_f, a, b, false);
+      if (op == "*")
+        return arith(opcode::mul_i, opcode::mul_f, a, b, false);
+      if (op == "/")
+        return arith(opcode::div_i, opcode::div_f, a, b, false);
+      if (op == "%")
+        return arith(opcode::mod_i, opcode::mod_f, a, b, false);
+      if (op == "==")
+        return arith(opcode::eq_i, opcode::eq_f, a, b, true);
+      if (op == "!=")
+        return arith(opcode::ne_i, opcode::ne_f, a, b, true);
+      if (op == "<")
+        return arith(opcode::lt_i, opcode::lt_f, a, b, true);
+      if (op == "<=")
+        return arith(opcode::le_i, opcode::le_f, a, b, true);
+      if (op == ">")
+        return arith(opcode::lt_i, opcode::lt_f, b, a, true);
+      if (op == ">=")
+        return arith(opcode::le_i, opcode::le_f, b, a, true);
+      if (op == "&&" || op == "||") {
+        a = to_bool(a);
+        b = to_bool(b);
+        return emit(
+          (op == "&&") ? opcode::and_i : opcode::or_i, value_type::integer,
+          a.reg, b.reg, a.constant && b.constant);
+      }
+
+      require_int(a, op);
+      require_int(b, op);
+      opcode code_op = (op == "&")    ? opcode::and_i
+        : (op == "|")                 ? opcode::or_i
+        : (op == "^")                 ? opcode::xor_i
+        : (op == "<<")                ? opcode::shl_i
+                                      : opcode::shr_i;
+      return emit(
+        code_op, value_type::integer, a.reg, b.reg, a.constant && b.constant);
+    }
+
+    value ternary(const formula_ast& node) {
+      value cond = to_bool(compile(node.args[0]));
+      value a    = compile(node.args[1]);
+      value b    = compile(node.args[2]);
+      bool constant = cond.constant && a.constant && b.constant;
+      value result;
+      if (a.type == value_type::integer && b.type == value_type::integer) {
+        result = emit(opcode::select_i, value_type::integer, a.reg, b.reg, constant);
+      }
+      else {
+        a      = to_float(a);
+        b      = to_float(b);
+        result = emit(opcode::select_f, value_type::floating, a.reg, b.reg, constant);
+      }
+      code.back().arg.reg = cond.reg;
+      return result;
+    }
+
+    value call(const formula_ast& node) {
+      struct intrinsic {
+        const char* name;
+        size_t argc;
+        opcode op_i;
+        opcode op_f;
+        // integer arguments are converted to float first
+        bool float_only;
+      };
+      static const intrinsic table[] = {
+        {"abs", 1, opcode::abs_i, opcode::abs_f, false},
+        {"min", 2, opcode::min_i, opcode::min_f, false},
+        {"max", 2, opcode::max_i, opcode::max_f, false},
+        {"sqrt", 1, opcode::sqrt_f, opcode::sqrt_f, true},
+        {"sin", 1, opcode::sin_f, opcode::sin_f, true},
+        {"cos", 1, opcode::cos_f, opcode::cos_f, true},
+        {"floor", 1, opcode::floor_f, opcode::floor_f, true},
+        {"ceil", 1, opcode::ceil_f, opcode::ceil_f, true},
+        {"round", 1, opcode::round_f, opcode::round_f, true},
+        {"hypot", 2, opcode::hypot_f, opcode::hypot_f, true},
+        {"atan2", 2, opcode::atan2_f, opcode::atan2_f, true},
+        {"pow", 2, opcode::pow_f, opcode::pow_f, true},
+      };
+
+      // casts
+      if (node.op == "int" || node.op == "float") {
+        if (node.args.size() != 1) {
+          throw std::invalid_argument(node.op + "() takes 1 argument");
+        }
+        value a = compile(node.args[0]);
+        return (node.op == "int") ? to_int(a) : to_float(a);
+      }
+
+      for (const intrinsic& fn : table) {
+        if (node.op != fn.name)
+          continue;
+        if (node.args.size() != fn.argc) {
+          stringstream fmt;
+          fmt << fn.name << "() takes " << fn.argc
+              << ((fn.argc == 1) ? " argument" : " arguments");
+          throw std::invalid_argument(fmt.str());
+        }
+        std::vector<value> args;
+        bool all_int  = true;
+        bool constant = true;
+        for (auto& arg : node.args) {
+          args.push_back(compile(arg));
+          all_int  = all_int && args.back().type == value_type::integer;
+          constant = constant && args.back().constant;
+        }
+        if (all_int && !fn.float_only) {
+          return emit(
+            fn.op_i, value_type::integer, args[0].reg,
+            (fn.argc > 1) ? args[1].reg : 0, constant);
+        }
+        for (auto& arg : args)
+          arg = to_float(arg);
+        return emit(
+          fn.op_f, value_type::floating, args[0].reg,
+          (fn.argc > 1) ? args[1].reg : 0, constant);
+      }
+      throw std::invalid_argument("Unknown function " + node.op + "()");
+    }
+
+    value compile(const formula_ast& node) {
+      const size_t start = code.size();
+      const size_t ints = num_ints, floats = num_floats;
+      value v {value_type::integer, 0, false};
+      switch (node.type) {
+        case formula_ast::kind::integer: return const_int(node.ival);
+        case formula_ast::kind::floating: return const_float(node.fval);
+        case formula_ast::kind::path: return load(node.text);
+        case formula_ast::kind::unary: v = unary(node); break;
+        case formula_ast::kind::binary: v = binary(node); break;
+        case formula_ast::kind::ternary: v = ternary(node); break;
+        case formula_ast::kind::call: v = call(node); break;
+      }
+      if (!v.constant)
+        return v;
+
+      // Fold: run the subexpression now and replace it with its result
+      std::vector<int64_t> ri(num_ints);
+      std::vector<double> rf(num_floats);
+      exec(code.data() + start, code.data() + code.size(), ri.data(), rf.data());
+      code.resize(start);
+      num_ints   = ints;
+      num_floats = floats;
+      return (v.type == value_type::integer) ? const_int(ri[v.reg])
+                                             : const_float(rf[v.reg]);
+    }
+  };
+
+  program compile_formula(const formula_ast& ast, const program::resolver& resolve) {
+    program::compiler comp(resolve);
+    program::compiler::value v = comp.compile(ast);
+
+    program result;
+    result.m_code   = std::move(comp.code);
+    result.m_ints   = std::vector<int64_t>(comp.num_ints);
+    result.m_floats = std::vector<double>(comp.num_floats);
+    result.m_type   = v.type;
+    result.m_result = v.reg;
+    return result;
+  }
+}  // namespace pancake::expr
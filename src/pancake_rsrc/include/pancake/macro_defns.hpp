@@ -7,7 +7,7 @@ namespace pancake {
   private:
     nlohmann::json json;
     sm64_macro_defns() {
-      json = nlohmann::json::parse(_pancake_rsrc_sm64_macro_defns_json_begin, _pancake_rsrc_sm64_macro_defns_json_end - 1);  
+      json = nlohmann::json::parse(_pancake_rsrc_sm64_macro_defns_json_begin, _pancake_rsrc_sm64_macro_defns_json_end);
     }
       
   public:
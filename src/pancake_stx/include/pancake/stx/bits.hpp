@@ -0,0 +1,34 @@
+/***************************
+The source code below is licensed under the BSD Zero-Clause License.
+See the README.md in this directory for details.
+***************************/
+
+#ifndef _PANCAKE_STX_BITS_HPP_
+#define _PANCAKE_STX_BITS_HPP_
+
+#include <cstdint>
+
+namespace stx {
+  /**
+  * @brief Counts the set bits of a 64-bit word (C++20's std::popcount).
+  */
+  constexpr unsigned popcount(uint64_t x) {
+#if defined(__GNUC__)
+    return unsigned(__builtin_popcountll(x));
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return unsigned((x * 0x0101010101010101ULL) >> 56);
+#endif
+  }
+
+  /**
+  * @brief Counts the trailing zero bits of a 64-bit word, i.e. the index of
+  * its lowest set bit (C++20's std::countr_zero). Returns 64 for 0.
+  */
+  constexpr unsigned ctz(uint64_t x) {
+    return popcount((x & (~x + 1)) - 1);
+  }
+}
+#endif
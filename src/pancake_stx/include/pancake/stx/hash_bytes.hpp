@@ -0,0 +1,57 @@
+/***************************
+The source code below is licensed under the BSD Zero-Clause License.
+See the README.md in this directory for details.
+***************************/
+
+#ifndef _PANCAKE_STX_HASH_BYTES_HPP_
+#define _PANCAKE_STX_HASH_BYTES_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace stx {
+  /**
+  * @brief Mixes a 64-bit value (the splitmix64 finalizer).
+  */
+  constexpr uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+  }
+
+  /**
+  * @brief Hashes a block of bytes. Not cryptographic, meant for large blocks
+  * of memory: the main loop runs 4 independent lanes of 8-byte words.
+  */
+  inline uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = 0) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint64_t h[4] = {
+      seed ^ 0x9E3779B97F4A7C15ULL, seed ^ 0xC2B2AE3D27D4EB4FULL,
+      seed ^ 0x165667B19E3779F9ULL, seed ^ 0x27D4EB2F165667C5ULL};
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+      for (size_t j = 0; j < 4; j++) {
+        uint64_t w;
+        std::memcpy(&w, p + i + j * 8, 8);
+        h[j] = (h[j] ^ w) * 0x9FB21C651E98DF25ULL;
+        h[j] ^= h[j] >> 29;
+      }
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, p + i, size - i < 8 ? size - i : 8);
+    for (size_t k = i + 8; k < size; k += 8) {
+      uint64_t w = 0;
+      std::memcpy(&w, p + k, size - k < 8 ? size - k : 8);
+      tail = mix64(tail ^ w);
+    }
+    return mix64(
+      h[0] ^ mix64(h[1] + 1) ^ mix64(h[2] + 2) ^ mix64(h[3] + 3) ^
+      mix64(tail ^ size));
+  }
+}
+#endif
@@ -0,0 +1,293 @@
+/***************************
+The source code below is licensed under the BSD Zero-Clause License.
+See the README.md in this directory for details.
+***************************/
+
+#ifndef _PANCAKE_STX_STRIDED_SPAN_HPP_
+#define _PANCAKE_STX_STRIDED_SPAN_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace stx {
+  /**
+  * @brief A view of `size` values of type `T`, each `stride` bytes after the
+  * previous one. Useful for one field of every element of an array of
+  * structs.
+  */
+  template <typename T>
+  class strided_span {
+  public:
+    using element_type = T;
+    using value_type   = std::remove_cv_t<T>;
+    using size_type    = size_t;
+
+  private:
+    using byte_ptr = std::conditional_t<std::is_const_v<T>, const char*, char*>;
+
+    T* m_data;
+    size_t m_size;
+    ptrdiff_t m_stride;
+
+  public:
+    class iterator {
+      friend class strided_span;
+
+      byte_ptr m_ptr;
+      ptrdiff_t m_stride;
+
+      iterator(byte_ptr ptr, ptrdiff_t stride) : m_ptr(ptr), m_stride(stride) {}
+
+    public:
+      using iterator_category = std::random_access_iterator_tag;
+      using value_type        = std::remove_cv_t<T>;
+      using difference_type   = ptrdiff_t;
+      using pointer           = T*;
+      using reference         = T&;
+
+      T& operator*() const { return *reinterpret_cast<T*>(m_ptr); }
+      T* operator->() const { return reinterpret_cast<T*>(m_ptr); }
+      T& operator[](ptrdiff_t n) const {
+        return *reinterpret_cast<T*>(m_ptr + n * m_stride);
+      }
+
+      iterator& operator++() {
+        m_ptr += m_stride;
+        return *this;
+      }
+      iterator operator++(int) {
+        iterator res = *this;
+        m_ptr += m_stride;
+        return res;
+      }
+      iterator& operator--() {
+        m_ptr -= m_stride;
+        return *this;
+      }
+      iterator operator--(int) {
+        iterator res = *this;
+        m_ptr -= m_stride;
+        return res;
+      }
+      iterator& operator+=(ptrdiff_t n) {
+        m_ptr += n * m_stride;
+        return *this;
+      }
+      iterator& operator-=(ptrdiff_t n) {
+        m_ptr -= n * m_stride;
+        return *this;
+      }
+      friend iterator operator+(iterator it, ptrdiff_t n) { return it += n; }
+      friend iterator operator+(ptrdiff_t n, iterator it) { return it += n; }
+      friend iterator operator-(iterator it, ptrdiff_t n) { return it -= n; }
+      friend ptrdiff_t operator-(const iterator& a, const iterator& b) {
+        return (a.m_ptr - b.m_ptr) / a.m_stride;
+      }
+
+      friend bool operator==(const iterator& a, const iterator& b) {
+        return a.m_ptr == b.m_ptr;
+      }
+      friend bool operator!=(const iterator& a, const iterator& b) {
+        return a.m_ptr != b.m_ptr;
+      }
+      friend bool operator<(const iterator& a, const iterator& b) {
+        return (b - a) > 0;
+      }
+      friend bool operator>(const iterator& a, const iterator& b) {
+        return b < a;
+      }
+      friend bool operator<=(const iterator& a, const iterator& b) {
+        return !(b < a);
+      }
+      friend bool operator>=(const iterator& a, const iterator& b) {
+        return !(a < b);
+      }
+    };
+
+    strided_span() : m_data(nullptr), m_size(0), m_stride(sizeof(T)) {}
+    /**
+    * @brief Creates a view.
+    *
+    * @param data the first value
+    * @param size the number of values
+    * @param stride the distance between values, in bytes
+    */
+    strided_span(T* data, size_t size, ptrdiff_t stride = sizeof(T)) :
+      m_data(data), m_size(size), m_stride(stride) {}
+
+    T* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    /**
+    * @brief Returns the distance between values, in bytes.
+    */
+    ptrdiff_t stride() const { return m_stride; }
+    /**
+    * @brief Checks if the values are packed together like an array.
+    */
+    bool contiguous() const { return m_stride == ptrdiff_t(sizeof(T)); }
+
+    T& operator[](size_t i) const {
+      return *reinterpret_cast<T*>(
+        reinterpret_cast<byte_ptr>(m_data) + ptrdiff_t(i) * m_stride);
+    }
+    T& front() const { return (*this)[0]; }
+    T& back() const { return (*this)[m_size - 1]; }
+
+    iterator begin() const {
+      return iterator(reinterpret_cast<byte_ptr>(m_data), m_stride);
+    }
+    iterator end() const { return begin() + ptrdiff_t(m_size); }
+
+    /**
+    * @brief Returns a view of `count` values starting at `offset`.
+    */
+    strided_span subspan(size_t offset, size_t count) const {
+      return strided_span(&(*this)[offset], count, m_stride);
+    }
+  };
+
+  namespace details {
+    template <typename T>
+    using sum_type = std::conditional_t<
+      std::is_floating_point_v<T>, double,
+      std::conditional_t<std::is_signed_v<T>, int64_t, uint64_t>>;
+
+    // Folds a span with 4 independent accumulators, so the loads and
+    // operations of neighbouring elements can overlap. Contiguous spans
+    // take a plain pointer loop the compiler can vectorise.
+    template <typename T, typename A, typename F>
+    A fold4(const strided_span<T>& s, A init, F op) {
+      A a0 = init, a1 = init, a2 = init, a3 = init;
+      const size_t n = s.size();
+      size_t i       = 0;
+      if (s.contiguous()) {
+        const T* p = s.data();
+        for (; i + 4 <= n; i += 4) {
+          a0 = op(a0, p[i]);
+          a1 = op(a1, p[i + 1]);
+          a2 = op(a2, p[i + 2]);
+          a3 = op(a3, p[i + 3]);
+        }
+        for (; i < n; i++)
+          a0 = op(a0, p[i]);
+      }
+      else {
+        for (; i + 4 <= n; i += 4) {
+          a0 = op(a0, s[i]);
+          a1 = op(a1, s[i + 1]);
+          a2 = op(a2, s[i + 2]);
+          a3 = op(a3, s[i + 3]);
+        }
+        for (; i < n; i++)
+          a0 = op(a0, s[i]);
+      }
+      return op(op(a0, a1), op(a2, a3));
+    }
+
+    template <typename T>
+    void check_nonempty(const strided_span<T>& s) {
+      if (s.empty())
+        throw std::out_of_range("Span is empty");
+    }
+  }  // namespace details
+
+  /**
+  * @brief Sums a span, in a double for floating-point values and a 64-bit
+  * integer otherwise.
+  */
+  template <typename T>
+  details::sum_type<std::remove_cv_t<T>> sum(const strided_span<T>& s) {
+    using acc = details::sum_type<std::remove_cv_t<T>>;
+    return details::fold4(s, acc(0), [](acc a, acc b) { return a + b; });
+  }
+
+  /**
+  * @brief Returns the smallest value in a span.
+  * @exception std::out_of_range if the span is empty
+  */
+  template <typename T>
+  std::remove_cv_t<T> min(const strided_span<T>& s) {
+    using value = std::remove_cv_t<T>;
+    details::check_nonempty(s);
+    return details::fold4(
+      s, value(s[0]), [](value a, value b) { return (b < a) ? b : a; });
+  }
+
+  /**
+  * @brief Returns the largest value in a span.
+  * @exception std::out_of_range if the span is empty
+  */
+  template <typename T>
+  std::remove_cv_t<T> max(const strided_span<T>& s) {
+    using value = std::remove_cv_t<T>;
+    details::check_nonempty(s);
+    return details::fold4(
+      s, value(s[0]), [](value a, value b) { return (a < b) ? b : a; });
+  }
+
+  /**
+  * @brief Returns the index of the first smallest value in a span.
+  * @exception std::out_of_range if the span is empty
+  */
+  template <typename T>
+  size_t argmin(const strided_span<T>& s) {
+    details::check_nonempty(s);
+    std::remove_cv_t<T> best = s[0];
+    size_t idx               = 0;
+    for (size_t i = 1; i < s.size(); i++) {
+      if (s[i] < best) {
+        best = s[i];
+        idx  = i;
+      }
+    }
+    return idx;
+  }
+
+  /**
+  * @brief Returns the index of the first largest value in a span.
+  * @exception std::out_of_range if the span is empty
+  */
+  template <typename T>
+  size_t argmax(const strided_span<T>& s) {
+    details::check_nonempty(s);
+    std::remove_cv_t<T> best = s[0];
+    size_t idx               = 0;
+    for (size_t i = 1; i < s.size(); i++) {
+      if (best < s[i]) {
+        best = s[i];
+        idx  = i;
+      }
+    }
+    return idx;
+  }
+
+  /**
+  * @brief Copies a span's values into a contiguous buffer.
+  *
+  * @param s the span
+  * @param out a buffer of at least `s.size()` values
+  * @return one past the last value written
+  */
+  template <typename T, typename U>
+  U* gather(const strided_span<T>& s, U* out) {
+    const size_t n = s.size();
+    for (size_t i = 0; i < n; i++)
+      out[i] = static_cast<U>(s[i]);
+    return out + n;
+  }
+
+  /**
+  * @brief Copies a span's values into a vector, reusing its storage.
+  */
+  template <typename T, typename U>
+  void gather(const strided_span<T>& s, std::vector<U>& out) {
+    out.resize(s.size());
+    gather(s, out.data());
+  }
+}  // namespace stx
+#endif
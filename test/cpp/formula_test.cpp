@@ -0,0 +1,147 @@
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include <pancake/dwarf/type_info.hpp>
+#include <pancake/expr/vm.hpp>
+
+#include "check.hpp"
+
+using namespace pancake;
+using expr::program;
+
+namespace {
+  // Fields the formulas below can read, in place of a game.
+  int32_t action    = 0x0C400201;
+  int16_t yaw       = -16384;
+  uint8_t flags     = 0x05;
+  float speed       = 32.5f;
+  double height     = -2967.5;
+  float vel[3]      = {1.0f, 2.0f, 3.0f};
+
+  program::operand resolve(const std::string& text) {
+    if (text == "action")
+      return {&action, dwarf::get_type_info<int32_t>()};
+    if (text == "yaw")
+      return {&yaw, dwarf::get_type_info<int16_t>()};
+    if (text == "flags")
+      return {&flags, dwarf::get_type_info<uint8_t>()};
+    if (text == "speed")
+      return {&speed, dwarf::get_type_info<float>()};
+    if (text == "height")
+      return {&height, dwarf::get_type_info<double>()};
+    if (text == "vel[0]")
+      return {&vel[0], dwarf::get_type_info<float>()};
+    if (text == "vel[2]")
+      return {&vel[2], dwarf::get_type_info<float>()};
+    throw std::out_of_range("No field " + text);
+  }
+
+  program compile(const std::string& text) {
+    return expr::compile_formula(expr::parse_formula(text), resolve);
+  }
+
+  // Compiles a formula of constants, checking that it folded down to one
+  // instruction, and returns its value.
+  double folded(const std::string& text) {
+    program prog = compile(text);
+    CHECK(prog.code().size() == 1);
+    if (prog.code().size() == 1) {
+      CHECK(
+        prog.code()[0].op == program::opcode::const_i ||
+        prog.code()[0].op == program::opcode::const_f);
+    }
+    return prog.eval();
+  }
+
+  size_t count(const program& prog, program::opcode op) {
+    size_t res = 0;
+    for (auto& in : prog.code())
+      res += (in.op == op);
+    return res;
+  }
+}  // namespace
+
+int main() {
+  // precedence and associativity follow C
+  CHECK(folded("1 + 2 * 3") == 7);
+  CHECK(folded("(1 + 2) * 3") == 9);
+  CHECK(folded("10 - 4 - 3") == 3);
+  CHECK(folded("64 / 4 / 2") == 8);
+  CHECK(folded("2 * 3 % 4") == 2);
+  CHECK(folded("1 << 2 + 1") == 8);
+  CHECK(folded("1 | 2 & 3") == 3);
+  CHECK(folded("1 ^ 3 & 1") == 0);
+  CHECK(folded("6 & 3 == 3") == 0);
+  CHECK(folded("5 > 3 == 1") == 1);
+  CHECK(folded("1 + 2 < 4") == 1);
+  CHECK(folded("1 || 0 && 0") == 1);
+  CHECK(folded("0 ? 1 : 2 ? 3 : 4") == 3);
+  CHECK(folded("1 ? 0 ? 5 : 6 : 7") == 6);
+  CHECK(folded("-2 * -3") == 6);
+  CHECK(folded("!0 + 1") == 2);
+  CHECK(folded("~0 & 0xF") == 15);
+  CHECK(folded("- -1") == 1);
+
+  // integer and floating-point arithmetic
+  CHECK(folded("7 / 2") == 3);
+  CHECK(folded("-7 / 2") == -3);
+  CHECK(folded("-7 % 3") == -1);
+  CHECK(folded("7 / 2.0") == 3.5);
+  CHECK(folded("7 / 0") == 0);
+  CHECK(folded("7 % 0") == 0);
+  CHECK(folded("0b101 + 0x10") == 21);
+  CHECK(folded(".5 + 1e1") == 10.5);
+  CHECK(compile("7 / 2").type() == program::value_type::integer);
+  CHECK(compile("7 / 2.0").type() == program::value_type::floating);
+
+  // functions
+  CHECK(folded("min(3, max(1, 2))") == 2);
+  CHECK(folded("abs(-5) + abs(-0.5)") == 5.5);
+  CHECK(folded("sqrt(16)") == 4);
+  CHECK(folded("hypot(3, 4)") == 5);
+  CHECK(folded("pow(2, 10)") == 1024);
+  CHECK(folded("floor(-1.5) + ceil(1.5) + round(2.5)") == 3);
+  CHECK(folded("int(3.9)") == 3);
+  CHECK(folded("float(1) / 2") == 0.5);
+
+  // macro constants
+  CHECK(folded("ACT_IDLE") == 0x0C400201);
+  CHECK(std::abs(folded("GU_PI * 2") - 6.2831852) < 1e-9);
+
+  // fields are read on every evaluation; constant parts around them fold
+  {
+    program prog = compile("action == ACT_IDLE && speed > 10 * 3");
+    CHECK(prog.test());
+    CHECK(count(prog, program::opcode::mul_i) == 0);
+    CHECK(count(prog, program::opcode::load_s32) == 1);
+    CHECK(count(prog, program::opcode::load_f32) == 1);
+    speed = 29.0f;
+    CHECK(!prog.test());
+    speed = 32.5f;
+  }
+  {
+    program prog = compile("yaw + (1 + 2) * 4");
+    CHECK(prog.eval_int() == -16384 + 12);
+    CHECK(prog.code().size() == 3);
+    yaw = 100;
+    CHECK(prog.eval_int() == 112);
+  }
+  CHECK(compile("flags & 4 ? height : speed").eval() == -2967.5);
+  CHECK(compile("hypot(vel[0], vel[2]) * 2").eval() == 2 * std::hypot(1.0, 3.0));
+  CHECK(compile("flags").type() == program::value_type::integer);
+  CHECK(compile("-flags").eval() == -5);
+
+  // errors
+  CHECK_THROWS(compile("1 & 2.0"), std::invalid_argument);
+  CHECK_THROWS(compile("~speed"), std::invalid_argument);
+  CHECK_THROWS(compile("nope(1)"), std::invalid_argument);
+  CHECK_THROWS(compile("min(1)"), std::invalid_argument);
+  CHECK_THROWS(compile("1 +"), std::invalid_argument);
+  CHECK_THROWS(compile("(1 + 2"), std::invalid_argument);
+  CHECK_THROWS(compile("1 2"), std::invalid_argument);
+  CHECK_THROWS(compile("missing"), std::out_of_range);
+
+  return check_failures != 0;
+}
@@ -0,0 +1,146 @@
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <vector>
+
+#include <pancake/movie.hpp>
+
+#include "check.hpp"
+
+using namespace pancake;
+namespace fs = std::filesystem;
+
+namespace {
+  std::vector<frame> random_frames(std::mt19937& rng, size_t n) {
+    std::vector<frame> res(n);
+    for (auto& f : res) {
+      f.buttons = static_cast<frame::button>(uint16_t(rng()));
+      f.stick_x = int8_t(rng());
+      f.stick_y = int8_t(rng());
+    }
+    return res;
+  }
+
+  bool same_frames(const m64& movie, const std::vector<frame>& frames) {
+    if (movie.size() != frames.size())
+      return false;
+    for (uint32_t i = 0; i < movie.size(); i++) {
+      if (!(movie[i] == frames[i]))
+        return false;
+    }
+    return true;
+  }
+
+  m64::metadata_s sample_metadata() {
+    m64::metadata_s res {};
+    res.version         = 3;
+    res.rerecords       = 12345;
+    res.vis_per_s       = 60;
+    res.num_controllers = 1;
+    res.rom_name        = "SUPER MARIO 64";
+    res.crc             = 0xFF2B5A63;
+    res.authors         = "pancake";
+    res.description     = "m64_writer round trip";
+    return res;
+  }
+}  // namespace
+
+int main() {
+  std::mt19937 rng(20261019);
+  const fs::path dir = fs::temp_directory_path() / "pancake_m64_writer_test";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  const fs::path path = dir / "run.m64";
+  const m64::metadata_s mdata = sample_metadata();
+
+  m64_writer::options opts;
+  opts.flush_interval = 7;
+  opts.sync           = m64_writer::sync_policy::none;
+
+  // frames written through automatic and explicit flushes all come back
+  std::vector<frame> frames = random_frames(rng, 1000);
+  {
+    m64_writer out(path, mdata, opts);
+    CHECK(out.size() == 0);
+    out.append(frames.begin(), frames.begin() + 500);
+    out.flush();
+    out.append(frames.begin() + 500, frames.end());
+    CHECK(out.size() == 1000);
+  }
+  {
+    m64 movie(path);
+    CHECK(same_frames(movie, frames));
+    CHECK(movie.metadata.num_input_frames() == 1000);
+    CHECK(movie.metadata.rerecords == 12345);
+    CHECK(movie.metadata.rom_name == "SUPER MARIO 64");
+    CHECK(movie.metadata.authors == "pancake");
+    CHECK(movie.metadata.description == "m64_writer round trip");
+  }
+
+  // the header is only patched on flush, so a reader sees the frames up to
+  // the last one
+  {
+    m64_writer out(path, mdata, opts);
+    out.append(frames.begin(), frames.begin() + 14);
+    out.push_back(frames[14]);
+    CHECK(m64(path).size() == 14);
+  }
+
+  // reopening appends after the last recorded frame, overwriting any
+  // partial write left behind
+  {
+    m64_writer out(path, mdata, opts);
+    out.append(frames.begin(), frames.end());
+  }
+  {
+    std::ofstream junk(path, std::ios::binary | std::ios::app);
+    junk.write("\x12\x34\x56", 3);
+  }
+  std::vector<frame> more = random_frames(rng, 50);
+  {
+    m64_writer out(path, opts);
+    CHECK(out.size() == 1000);
+    out.append(more.begin(), more.end());
+  }
+  frames.insert(frames.end(), more.begin(), more.end());
+  {
+    m64 movie(path);
+    CHECK(same_frames(movie, frames));
+    CHECK(fs::file_size(path) == 0x400 + 4 * frames.size());
+  }
+
+  // starting from an existing movie, then checkpointing mid-buffer
+  {
+    m64 base(path);
+    const fs::path copy = dir / "copy.m64";
+    const fs::path ckpt = dir / "copy.ckpt.m64";
+    {
+      m64_writer out(copy, base, opts);
+      CHECK(out.size() == base.size());
+      out.push_back(more[0]);
+      out.push_back(more[1]);
+      out.checkpoint(ckpt);
+      CHECK(!fs::exists(ckpt.string() + ".tmp"));
+    }
+    std::vector<frame> expected = frames;
+    expected.push_back(more[0]);
+    expected.push_back(more[1]);
+    CHECK(same_frames(m64(copy), expected));
+    CHECK(same_frames(m64(ckpt), expected));
+  }
+
+  // m64::dump() writes what m64 reads
+  {
+    m64 movie(frames.begin(), frames.end(), mdata);
+    const fs::path dumped = dir / "dumped.m64";
+    movie.dump(dumped);
+    m64 back(dumped);
+    CHECK(same_frames(back, frames));
+    CHECK(back.metadata.crc == mdata.crc);
+    CHECK(!fs::exists(dumped.string() + ".tmp"));
+  }
+
+  fs::remove_all(dir);
+  return check_failures != 0;
+}
@@ -0,0 +1,114 @@
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include <pancake/expr/parse.hpp>
+#include <pancake/stx/strided_span.hpp>
+
+#include "check.hpp"
+
+using namespace pancake;
+using expr::expr_ast;
+
+namespace {
+  // Parses an expression whose only step is a slice.
+  std::optional<expr_ast::slice> slice_of(const std::string& text) {
+    expr_ast ast = expr::parse(text);
+    if (ast.steps.size() != 1 ||
+        !std::holds_alternative<expr_ast::slice>(ast.steps[0]))
+      return std::nullopt;
+    return std::get<expr_ast::slice>(ast.steps[0]);
+  }
+
+  bool is_slice(
+    const std::string& text, size_t begin, std::optional<size_t> end) {
+    auto s = slice_of(text);
+    return s && s->begin == begin && s->end == end;
+  }
+
+  struct object {
+    int32_t active;
+    float pos_y;
+    char pad[24];
+  };
+}  // namespace
+
+int main() {
+  // every form of slice
+  CHECK(is_slice("gObjectPool[*]", 0, std::nullopt));
+  CHECK(is_slice("gObjectPool[:]", 0, std::nullopt));
+  CHECK(is_slice("gObjectPool[2:5]", 2, 5));
+  CHECK(is_slice("gObjectPool[2:]", 2, std::nullopt));
+  CHECK(is_slice("gObjectPool[:5]", 0, 5));
+  CHECK(is_slice("gObjectPool[0x10:0b11000]", 16, 24));
+  CHECK(is_slice("gObjectPool[ACTIVE_FLAG_ACTIVE:4]", 1, 4));
+
+  // a plain index is still a subscript
+  {
+    expr_ast ast = expr::parse("gObjectPool[3]");
+    CHECK(ast.steps.size() == 1);
+    CHECK(std::holds_alternative<expr_ast::subscript>(ast.steps[0]));
+    if (!ast.steps.empty() &&
+        std::holds_alternative<expr_ast::subscript>(ast.steps[0]))
+      CHECK(std::get<expr_ast::subscript>(ast.steps[0]).index == 3);
+  }
+
+  // slices among other steps
+  {
+    expr_ast ast = expr::parse("gMarioStates[0].pos[1:3]");
+    CHECK(ast.global == "gMarioStates");
+    CHECK(ast.steps.size() == 3);
+    if (ast.steps.size() == 3) {
+      CHECK(std::holds_alternative<expr_ast::subscript>(ast.steps[0]));
+      CHECK(std::holds_alternative<expr_ast::dot>(ast.steps[1]));
+      CHECK(std::holds_alternative<expr_ast::slice>(ast.steps[2]));
+    }
+    ast = expr::parse("gObjectPool[*].header.gfx.pos[1]");
+    CHECK(ast.steps.size() == 5);
+    if (ast.steps.size() == 5) {
+      CHECK(std::holds_alternative<expr_ast::slice>(ast.steps[0]));
+      CHECK(std::holds_alternative<expr_ast::subscript>(ast.steps[4]));
+    }
+  }
+
+  // malformed brackets
+  CHECK_THROWS(expr::parse("gObjectPool[]"), std::invalid_argument);
+  CHECK_THROWS(expr::parse("gObjectPool[1"), std::invalid_argument);
+  CHECK_THROWS(expr::parse("gObjectPool[1:2:3]"), std::invalid_argument);
+  CHECK_THROWS(expr::parse("gObjectPool[*:2]"), std::invalid_argument);
+  CHECK_THROWS(expr::parse("gObjectPool[1*]"), std::invalid_argument);
+  CHECK_THROWS(expr::parse("gObjectPool[GU_PI:2]"), std::invalid_argument);
+
+  // a slice of one field across an array of structs
+  {
+    object pool[8] {};
+    for (int i = 0; i < 8; i++) {
+      pool[i].active = i % 2;
+      pool[i].pos_y  = float(i * i) - 10;
+    }
+    stx::strided_span<float> ys(&pool[2].pos_y, 5, sizeof(object));
+    CHECK(!ys.contiguous());
+    CHECK(ys.front() == -6 && ys.back() == 26);
+    CHECK(stx::sum(ys) == -6 - 1 + 6 + 15 + 26);
+    CHECK(stx::min(ys) == -6 && stx::max(ys) == 26);
+    CHECK(stx::argmin(ys) == 0 && stx::argmax(ys) == 4);
+    std::vector<double> out;
+    stx::gather(ys, out);
+    CHECK((out == std::vector<double> {-6, -1, 6, 15, 26}));
+
+    stx::strided_span<int32_t> active(&pool[0].active, 8, sizeof(object));
+    CHECK(stx::sum(active) == 4);
+    CHECK(stx::sum(active.subspan(1, 3)) == 2);
+    ys[0] = 100;
+    CHECK(pool[2].pos_y == 100);
+
+    stx::strided_span<const float> none;
+    CHECK(none.empty());
+    CHECK_THROWS(stx::min(none), std::out_of_range);
+  }
+
+  return check_failures != 0;
+}
@@ -0,0 +1,151 @@
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <pancake/dwarf/type_info.hpp>
+#include <pancake/state_diff.hpp>
+
+#include "check.hpp"
+
+using namespace pancake;
+
+namespace {
+  state_diff sample() {
+    state_diff res;
+    res.paths = {
+      "gMarioStates[0].pos[1]", "gMarioStates[0].action",
+      "gMarioStates[0].faceAngle[1]", "gMarioStates[0]+0x2A", ""};
+
+    float y = -2967.5f;
+    uint32_t y_bits;
+    std::memcpy(&y_bits, &y, 4);
+    res.changes.push_back(field_change {
+      0, 1, 4, 0x3C, dwarf::get_type_info<float>(), 0x44800000, y_bits});
+    res.changes.push_back(field_change {
+      1, 1, 4, 0x0C, dwarf::get_type_info<uint32_t>(), 0x0C400201,
+      0x0300088E});
+    res.changes.push_back(field_change {
+      2, 1, 2, 0x2E, dwarf::get_type_info<int16_t>(), 0x4000, 0xC000});
+    res.changes.push_back(field_change {
+      3, 1, 8, 0x2A, {dwarf::encoding::none, 0}, 0x0123456789ABCDEF,
+      ~uint64_t(0)});
+    res.changes.push_back(field_change {
+      4, 0, 1, 0, dwarf::get_type_info<int8_t>(), 0x7F, 0x80});
+    return res;
+  }
+
+  std::string serialise(const state_diff& diff) {
+    std::ostringstream out(std::ios::binary);
+    diff.write(out);
+    return out.str();
+  }
+
+  state_diff parse(const std::string& data) {
+    std::istringstream in(data, std::ios::binary);
+    return state_diff::read(in);
+  }
+
+  bool same(const field_change& a, const field_change& b) {
+    return a.path == b.path && a.region == b.region && a.size == b.size &&
+      a.offset == b.offset && a.type == b.type && a.before == b.before &&
+      a.after == b.after;
+  }
+
+  // Overwrites a little-endian field in serialised data.
+  void patch(std::string& data, size_t pos, uint64_t value, size_t size) {
+    for (size_t i = 0; i < size; i++)
+      data[pos + i] = char(value >> (8 * i));
+  }
+}  // namespace
+
+int main() {
+  const state_diff diff  = sample();
+  const std::string data = serialise(diff);
+
+  // write() then read() gives back the same diff
+  {
+    state_diff back = parse(data);
+    CHECK(back.paths == diff.paths);
+    CHECK(back.changes.size() == diff.changes.size());
+    for (size_t i = 0; i < back.changes.size() && i < diff.changes.size(); i++)
+      CHECK(same(back.changes[i], diff.changes[i]));
+    CHECK(back.path_of(back.changes[1]) == "gMarioStates[0].action");
+    CHECK(serialise(back) == data);
+  }
+
+  // values decode as their types
+  {
+    auto& c = diff.changes;
+    CHECK(c[0].decode(c[0].before) == 1024.0);
+    CHECK(c[0].decode(c[0].after) == -2967.5);
+    CHECK(c[1].decode(c[1].after) == double(0x0300088E));
+    CHECK(c[2].decode(c[2].after) == -16384.0);
+    CHECK(c[4].decode(c[4].after) == -128.0);
+  }
+
+  // an empty diff
+  {
+    state_diff back = parse(serialise(state_diff {}));
+    CHECK(back.paths.empty() && back.changes.empty());
+  }
+
+  // every truncation is reported, never read past
+  for (size_t len = 0; len < data.size(); len++)
+    CHECK_THROWS(parse(data.substr(0, len)), std::runtime_error);
+
+  // bad headers
+  {
+    std::string bad = data;
+    bad[0]          = 'X';
+    CHECK_THROWS(parse(bad), std::runtime_error);
+    bad = data;
+    patch(bad, 4, 99, 4);
+    CHECK_THROWS(parse(bad), std::runtime_error);
+  }
+
+  // huge counts run into the end of the data instead of allocating
+  {
+    const size_t npaths = 8;
+    std::string bad     = data;
+    patch(bad, npaths, 0xFFFFFFFF, 4);
+    CHECK_THROWS(parse(bad), std::runtime_error);
+
+    bad = data;
+    patch(bad, npaths + 4, 0xFFFFFFFF, 4);
+    CHECK_THROWS(parse(bad), std::runtime_error);
+
+    size_t nchanges = npaths + 4;
+    for (auto& path : diff.paths)
+      nchanges += 4 + path.size();
+    bad = data;
+    patch(bad, nchanges, 0xFFFFFFFF, 4);
+    CHECK_THROWS(parse(bad), std::runtime_error);
+  }
+
+  // malformed changes
+  {
+    auto with = [&](auto edit) {
+      state_diff d = sample();
+      edit(d.changes[0]);
+      return serialise(d);
+    };
+    CHECK_THROWS(
+      parse(with([](field_change& c) { c.path = 5; })), std::runtime_error);
+    CHECK_THROWS(
+      parse(with([](field_change& c) { c.size = 9; })), std::runtime_error);
+    CHECK_THROWS(
+      parse(with([](field_change& c) { c.type.size = 0; })),
+      std::runtime_error);
+    CHECK_THROWS(
+      parse(with([](field_change& c) { c.type.size = 16; })),
+      std::runtime_error);
+    // untyped bytes don't need a size
+    parse(with([](field_change& c) {
+      c.type = {dwarf::encoding::none, 0};
+    }));
+  }
+
+  return check_failures != 0;
+}
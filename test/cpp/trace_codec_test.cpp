@@ -0,0 +1,197 @@
+#include <cstdint>
+#include <initializer_list>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <pancake/dwarf/type_info.hpp>
+#include <pancake/trace.hpp>
+
+#include "check.hpp"
+#include "trace_codec.hpp"
+
+using namespace pancake;
+namespace codec = pancake::trace_codec;
+
+namespace {
+  const dwarf::base_type_info types[] = {
+    dwarf::get_type_info<int8_t>(),   dwarf::get_type_info<uint8_t>(),
+    dwarf::get_type_info<int16_t>(),  dwarf::get_type_info<uint16_t>(),
+    dwarf::get_type_info<int32_t>(),  dwarf::get_type_info<uint32_t>(),
+    dwarf::get_type_info<int64_t>(),  dwarf::get_type_info<uint64_t>(),
+    dwarf::get_type_info<float>(),    dwarf::get_type_info<double>(),
+  };
+
+  // Truncates a word to a type, then widens it back the way the trace
+  // writer does.
+  uint64_t canonical(uint64_t w, dwarf::base_type_info type) {
+    const unsigned shift = unsigned(64 - 8 * type.size);
+    if (shift == 0)
+      return w;
+    if (codec::is_signed(type))
+      return uint64_t(int64_t(w << shift) >> shift);
+    return (w << shift) >> shift;
+  }
+
+  uint64_t mask(unsigned width) {
+    return (width == 64) ? ~uint64_t(0) : (uint64_t(1) << width) - 1;
+  }
+
+  std::vector<uint64_t> round_trip(
+    const std::vector<uint64_t>& words, dwarf::base_type_info type,
+    trace_column_chunk& col) {
+    std::vector<char> buf;
+    col = codec::encode(words, type, buf);
+    CHECK(col.length == buf.size());
+    std::vector<uint64_t> res;
+    codec::decode(col, type, buf.data(), words.size(), res);
+    return res;
+  }
+
+  // Lays out a chunk in a given encoding, whether or not encode() would
+  // have picked it.
+  std::vector<char> encode_as(
+    trace_encoding enc, unsigned width, const std::vector<uint64_t>& words,
+    uint64_t base) {
+    std::vector<char> buf;
+    std::vector<uint64_t> packed;
+    codec::put<uint64_t>(buf, enc == trace_encoding::bitpack ? base : words[0]);
+    for (size_t i = 0; i < words.size(); i++) {
+      switch (enc) {
+        case trace_encoding::bitpack: packed.push_back(words[i] - base); break;
+        case trace_encoding::delta:
+          if (i > 0)
+            packed.push_back(codec::zigzag(words[i] - words[i - 1]));
+          break;
+        case trace_encoding::xor_bits:
+          if (i > 0)
+            packed.push_back(words[i] ^ words[i - 1]);
+          break;
+        default: break;
+      }
+    }
+    codec::pack(packed.data(), packed.size(), width, buf);
+    return buf;
+  }
+}  // namespace
+
+int main() {
+  std::mt19937_64 rng(20261019);
+
+  // pack() and unpack() at every width
+  for (unsigned width = 0; width <= 64; width++) {
+    for (size_t n : {0, 1, 2, 63, 64, 65, 1000}) {
+      std::vector<uint64_t> values(n);
+      for (auto& v : values)
+        v = rng() & mask(width);
+      std::vector<char> buf;
+      codec::pack(values.data(), n, width, buf);
+      CHECK(buf.size() == codec::packed_size(n, width));
+      std::vector<uint64_t> back(n);
+      codec::unpack(buf.data(), buf.size(), n, width, back.data());
+      CHECK(back == values);
+    }
+  }
+
+  // zigzag keeps small negative numbers small
+  for (int64_t x : {int64_t(0), int64_t(-1), int64_t(1), INT64_MIN, INT64_MAX}) {
+    CHECK(codec::unzigzag(codec::zigzag(uint64_t(x))) == uint64_t(x));
+  }
+  CHECK(codec::zigzag(uint64_t(int64_t(-1))) == 1);
+
+  // every encoding at every width, decoded from a hand-made chunk
+  for (auto enc : {trace_encoding::bitpack, trace_encoding::delta,
+                   trace_encoding::xor_bits}) {
+    for (unsigned width = 0; width <= 64; width++) {
+      for (size_t n : {1, 2, 100}) {
+        const uint64_t base = rng();
+        std::vector<uint64_t> words(n);
+        for (size_t i = 0; i < n; i++) {
+          uint64_t r = rng() & mask(width);
+          switch (enc) {
+            case trace_encoding::bitpack: words[i] = base + r; break;
+            case trace_encoding::delta:
+              words[i] = (i == 0) ? base : words[i - 1] + codec::unzigzag(r);
+              break;
+            default: words[i] = (i == 0) ? base : words[i - 1] ^ r; break;
+          }
+        }
+        std::vector<char> buf = encode_as(enc, width, words, base);
+        trace_column_chunk col {0, buf.size(), enc, uint8_t(width), 0, 0};
+        std::vector<uint64_t> back;
+        codec::decode(
+          col, dwarf::get_type_info<uint64_t>(), buf.data(), n, back);
+        CHECK(back == words);
+
+        // one byte short of the packed data is caught
+        if (codec::packed_size(enc == trace_encoding::bitpack ? n : n - 1, width) > 0) {
+          col.length = buf.size() - 1;
+          CHECK_THROWS(
+            codec::decode(
+              col, dwarf::get_type_info<uint64_t>(), buf.data(), n, back),
+            std::runtime_error);
+        }
+      }
+    }
+  }
+
+  // encode() round trips every type, whatever encoding it picks
+  for (auto type : types) {
+    for (size_t n : {1, 2, 64, 1000}) {
+      for (unsigned width : {0u, 1u, 7u, 8u, 13u, 32u, 63u, 64u}) {
+        std::vector<uint64_t> words(n);
+        for (auto& w : words)
+          w = canonical(rng() & mask(width), type);
+        trace_column_chunk col;
+        CHECK(round_trip(words, type, col) == words);
+        CHECK(col.width <= 64);
+      }
+    }
+  }
+
+  // each encoding wins on the data it suits
+  {
+    trace_column_chunk col;
+    auto u32 = dwarf::get_type_info<uint32_t>();
+    auto i32 = dwarf::get_type_info<int32_t>();
+    auto f32 = dwarf::get_type_info<float>();
+
+    std::vector<uint64_t> noise(256);
+    for (auto& w : noise)
+      w = rng() & mask(32);
+    CHECK(round_trip(noise, u32, col) == noise);
+    CHECK(col.encoding == trace_encoding::plain);
+
+    std::vector<uint64_t> flags(256);
+    for (auto& w : flags)
+      w = 0x300000 + (rng() & 7);
+    CHECK(round_trip(flags, u32, col) == flags);
+    CHECK(col.encoding == trace_encoding::bitpack);
+    CHECK(col.width == 3);
+
+    // a counter running downwards, so every delta is negative
+    std::vector<uint64_t> falling(256);
+    for (size_t i = 0; i < falling.size(); i++)
+      falling[i] = canonical(uint64_t(int64_t(1000) - 3 * int64_t(i) * int64_t(i)), i32);
+    CHECK(round_trip(falling, i32, col) == falling);
+    CHECK(col.encoding == trace_encoding::delta);
+    CHECK(col.min < 0 && col.max == 1000);
+
+    std::vector<uint64_t> same(256, 0x42C80000);  // 100.0f
+    for (size_t i = 0; i < same.size(); i += 16)
+      same[i] ^= 1;
+    CHECK(round_trip(same, f32, col) == same);
+    CHECK(col.encoding == trace_encoding::xor_bits);
+  }
+
+  // a single row, and no rows at all
+  for (auto type : types) {
+    trace_column_chunk col;
+    std::vector<uint64_t> one {canonical(~uint64_t(0), type)};
+    CHECK(round_trip(one, type, col) == one);
+    CHECK(round_trip({}, type, col).empty());
+    CHECK(col.length == 0);
+  }
+
+  return check_failures != 0;
+}
@@ -0,0 +1,34 @@
+#if !defined(_PANCAKETEST_CHECK_HPP_)
+#define _PANCAKETEST_CHECK_HPP_
+
+#include <iostream>
+
+// Counts failed checks; tests return it from main() so CTest sees them.
+inline int check_failures = 0;
+
+// Reports a failed condition with its location, and carries on.
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond "\n"; \
+      check_failures++; \
+    } \
+  } while (0)
+
+// Checks that an expression throws `exc`.
+#define CHECK_THROWS(expr, exc) \
+  do { \
+    bool thrown_ = false; \
+    try { \
+      (void) (expr); \
+    } \
+    catch (const exc&) { \
+      thrown_ = true; \
+    } \
+    if (!thrown_) { \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": " #expr " didn't throw " #exc "\n"; \
+      check_failures++; \
+    } \
+  } while (0)
+
+#endif